@@ -0,0 +1,21 @@
+#ifndef _ALLOC_STATS_H_
+#define _ALLOC_STATS_H_
+
+#include <stdint.h>
+
+// Counts C++ heap allocations (global operator new / delete), so we can check
+// that steady-state gameplay does not allocate at all.
+
+typedef struct
+{
+  uint32_t allocations;
+  uint32_t frees;
+  uint32_t allocations_since_baseline;
+} alloc_stats_t;
+
+void getAllocStats(alloc_stats_t *stats);
+
+// Start of a steady-state phase, e.g. a new game; later allocations count against it
+void markAllocBaseline();
+
+#endif // _ALLOC_STATS_H_
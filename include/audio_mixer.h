@@ -0,0 +1,90 @@
+#ifndef _AUDIO_MIXER_H_
+#define _AUDIO_MIXER_H_
+
+#include <stdint.h>
+
+// Software mixer for the sound effects and melodies.
+//
+// Up to AUDIO_VOICES melodies play at once, each from a precomputed
+// single-cycle wavetable stepped by a fixed-point phase accumulator. The
+// mixer fills whole blocks of signed 16-bit mono samples, and
+// audio_output.cpp streams them to the DAC through I2S DMA. The CPU only
+// touches the audio once per block. The host renders the same blocks into
+// WAV files (src/host/render_audio.cpp).
+//
+// audioPlay() may be called from loop() while the output task mixes: new
+// melodies are handed over in a small pending list and picked up at the next
+// block, so mixing itself runs without a lock. Playing a melody that is
+// already playing restarts it in its voice. When every voice is busy, the
+// oldest one is taken over. A block-rate limiter keeps loud overlaps from
+// clipping.
+
+#define AUDIO_SAMPLE_RATE 16000
+#define AUDIO_BLOCK_FRAMES 256 // 16 ms, the mixing granularity
+#define AUDIO_VOICES 4
+#define AUDIO_WAVE_SIZE 256 // Entries per wavetable, indexed by the top 8 bits of the phase
+#define AUDIO_RAMP_SAMPLES 32 // Attack and release, so notes start and stop without a click
+#define AUDIO_UNITY_GAIN 4096  // Limiter gain of 1.0
+
+typedef enum
+{
+  AUDIO_WAVE_SQUARE, // The buzzer of old, tone()
+  AUDIO_WAVE_TRIANGLE,
+  AUDIO_WAVE_SINE,
+  AUDIO_WAVE_SAW,
+  AUDIO_WAVES
+} audio_wave_t;
+
+#define AUDIO_MIXER_STATIC_BYTES (sizeof(int8_t) * AUDIO_WAVES * AUDIO_WAVE_SIZE) // Wavetables, checked in audio_mixer.cpp
+
+typedef struct
+{
+  uint32_t step;          // Phase increment per sample, 2^32 per cycle; 0 for a rest
+  uint16_t on_samples;    // Sounding part of the note
+  uint16_t total_samples; // Including the pause after it
+} audio_note_t;
+
+// Compile-time note: a frequency from pitches.h and a note type (4 = quarter,
+// 8 = eighth, ...) as the old tone() tables had them. The note sounds for
+// 1000 / type ms and is followed by a quarter of that in silence.
+constexpr audio_note_t audioNote(uint32_t freq_hz, uint32_t note_type)
+{
+  return {(uint32_t)(((uint64_t)freq_hz << 32) / AUDIO_SAMPLE_RATE),
+          (uint16_t)(AUDIO_SAMPLE_RATE / note_type),
+          (uint16_t)(AUDIO_SAMPLE_RATE / note_type + AUDIO_SAMPLE_RATE / note_type / 4)};
+}
+
+typedef struct
+{
+  const audio_note_t *notes;
+  uint16_t count;
+  uint8_t wave;   // audio_wave_t
+  uint8_t volume; // 0..255; two voices at 128 fill the range, more go through the limiter
+} audio_melody_t;
+
+typedef struct
+{
+  uint32_t plays;
+  uint32_t restarted; // Melody was already playing, restarted in its voice
+  uint32_t stolen;    // All voices busy, the oldest one was taken over
+  uint32_t limited;   // Blocks the limiter turned down to keep the sum from clipping
+  uint32_t blocks;
+  uint32_t mix_max_us;
+  uint64_t mix_total_us;
+} audio_stats_t;
+
+// Build the wavetables; before the first audioMix()
+void audioMixerBegin();
+
+void audioPlay(const audio_melody_t *melody);
+
+// True while a voice is playing or waiting to start
+bool audioActive();
+
+// Next `frames` samples of the mix
+void audioMix(int16_t *out, int frames);
+
+void getAudioStats(audio_stats_t *stats);
+void resetAudioStats();
+
+#endif // _AUDIO_MIXER_H_
@@ -0,0 +1,24 @@
+#ifndef _AUDIO_OUTPUT_H_
+#define _AUDIO_OUTPUT_H_
+
+#include "audio_mixer.h"
+
+// Streams the mixer to the buzzer through the ESP32 built-in DAC (GPIO25,
+// DAC channel 1) in I2S DMA mode. The DMA engine clocks every sample out on
+// its own; an output task mixes the next block whenever a DMA buffer frees
+// up, and goes back to sleep with I2S stopped once every voice is done, so
+// silence costs neither CPU time nor light sleep.
+
+#define AUDIO_DMA_BUFFERS 4 // Of AUDIO_BLOCK_FRAMES each: 64 ms queued ahead of the DAC
+#define AUDIO_TASK_STACK 3072
+#define AUDIO_TASK_PRIORITY 5 // Above loop(), a late block is an audible gap
+
+// Mixed block and its DAC frames, checked in audio_output.cpp
+#define AUDIO_OUTPUT_STATIC_BYTES (AUDIO_BLOCK_FRAMES * (sizeof(int16_t) + 2 * sizeof(uint16_t)))
+
+void audioOutputBegin();
+
+// Start a melody, mixed with whatever is playing
+void audioOutputPlay(const audio_melody_t *melody);
+
+#endif // _AUDIO_OUTPUT_H_
@@ -0,0 +1,63 @@
+#ifndef _BITBOARD_SOLVER_H_
+#define _BITBOARD_SOLVER_H_
+
+#include <stdint.h>
+
+#include "board_config.h"
+
+// Batched deduction kernel for the host simulator.
+//
+// A board is 128 tiles, one bit each in the row layout of Minesweeper (row x
+// is byte x, column y is bit y), split into a low and a high 64-bit half.
+// SOLVER_LANES boards are processed side by side in GCC vector registers, so
+// every operation below works on all of them at once. Numbers are stored
+// bit-sliced, four planes per board, and added with bitwise full adders.
+//
+// The kernel applies the single-tile rules of every revealed number:
+//   count == flags around it            -> its hidden neighbours are safe
+//   count == flags + hidden around it   -> its hidden neighbours are mines
+
+static_assert(WIDTH == 8 && WIDTH * HEIGHT == 128, "bitboards hold one 8-column, 128-tile board");
+
+#define SOLVER_LANES 8
+
+typedef uint64_t solver_lane_t __attribute__((vector_size(SOLVER_LANES * sizeof(uint64_t))));
+
+typedef struct
+{
+    solver_lane_t lo; // rows 0..7 of every board
+    solver_lane_t hi; // rows 8..15
+} bitboard_t;
+
+typedef struct
+{
+    bitboard_t revealed;
+    bitboard_t flagged;
+    bitboard_t count[4]; // neighbour count of the revealed tiles, one plane per bit
+} solver_batch_t;
+
+typedef struct
+{
+    bitboard_t safe;  // hidden, unflagged tiles proven free
+    bitboard_t mines; // hidden, unflagged tiles proven to be mines
+} solver_result_t;
+
+// Copy one board into `lane`. The rows are the bitsets kept by Minesweeper;
+// counts of hidden tiles are masked out, the solver never sees them.
+void solver_load(solver_batch_t *batch, int lane, const uint8_t *revealed_rows, const uint8_t *flagged_rows,
+                 const uint8_t *neighbour_count);
+
+void solver_deduce(const solver_batch_t *batch, solver_result_t *result);
+
+// Tiles of one board as two row-layout words
+static inline uint64_t solver_lane_lo(const bitboard_t *board, int lane)
+{
+    return board->lo[lane];
+}
+
+static inline uint64_t solver_lane_hi(const bitboard_t *board, int lane)
+{
+    return board->hi[lane];
+}
+
+#endif // _BITBOARD_SOLVER_H_
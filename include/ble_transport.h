@@ -0,0 +1,28 @@
+#ifndef _BLE_TRANSPORT_H_
+#define _BLE_TRANSPORT_H_
+
+#include "board_state.h"
+#include "transport.h"
+
+// BLE GATT server backend: one write/notify characteristic for commands, one
+// read-only characteristic with the board state, every connected phone is a
+// client. Connection ids are the Bluedroid conn_id values.
+
+#define BLE_CONN_ID_BASE 0
+#define BLE_MAX_CONNECTIONS 16
+
+// A snapshot takes several ATT requests to read at the default MTU. Every
+// connection reads from its own copy, taken at the first request of a read,
+// so reads of different sessions can interleave without mixing their bytes.
+typedef struct
+{
+  uint32_t stamp; // of the copy, 0 for none / an empty value
+  uint16_t length;
+  uint8_t data[BOARD_STATE_MAX_SIZE];
+} ble_state_read_t;
+
+#define BLE_STATE_STATIC_BYTES (sizeof(ble_state_read_t) * BLE_MAX_CONNECTIONS) // Checked in ble_transport.cpp
+
+extern const transport_t bleTransport;
+
+#endif // _BLE_TRANSPORT_H_
@@ -0,0 +1,47 @@
+#ifndef _BOARD_BANK_H_
+#define _BOARD_BANK_H_
+
+// Generated by scripts/gen_board_bank.py --boards 32 --mines 12 --seed 1, do not edit.
+// Included by board_pool.cpp only; const, so it stays in flash.
+
+#include <stdint.h>
+
+#define BOARD_BANK_SIZE 32
+#define BOARD_BANK_MINES 12
+
+static const uint8_t boardBank[BOARD_BANK_SIZE][16] = {
+    {0x80, 0x00, 0x01, 0x41, 0x04, 0x00, 0x20, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x08, 0x51},
+    {0xE5, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x04, 0x10, 0x00, 0x02, 0x00, 0x08, 0x40, 0x04, 0x00},
+    {0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x09, 0x00, 0x04, 0x00, 0x01, 0x02, 0x10, 0x21, 0x40},
+    {0x00, 0x00, 0x00, 0x42, 0x00, 0x80, 0x01, 0x00, 0x00, 0x29, 0x20, 0x00, 0x10, 0x14, 0x00, 0x80},
+    {0x00, 0x01, 0x40, 0x08, 0x00, 0x12, 0x00, 0x40, 0x00, 0x00, 0x00, 0xA0, 0x80, 0x04, 0x01, 0x04},
+    {0x88, 0x08, 0x00, 0x00, 0x00, 0x08, 0x08, 0x0C, 0x00, 0x40, 0x00, 0x40, 0x10, 0x00, 0x00, 0x21},
+    {0x02, 0x40, 0x00, 0x00, 0x02, 0x00, 0x10, 0x00, 0x10, 0x00, 0x00, 0x05, 0x84, 0x20, 0x20, 0x08},
+    {0x81, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x04, 0x00, 0x00, 0x10, 0x29, 0x00, 0x06, 0x20, 0x10},
+    {0x18, 0x01, 0xA4, 0x00, 0x00, 0x60, 0x00, 0x80, 0x82, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00},
+    {0x00, 0x00, 0x02, 0x10, 0x00, 0x8D, 0x00, 0x00, 0x32, 0x0C, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00},
+    {0x40, 0x00, 0x00, 0x20, 0x00, 0x00, 0x01, 0x00, 0x04, 0x80, 0x84, 0x00, 0x04, 0x08, 0x10, 0x82},
+    {0x30, 0x02, 0x00, 0x08, 0x20, 0x02, 0x20, 0x02, 0x01, 0x00, 0x00, 0x00, 0x20, 0x40, 0x04, 0x00},
+    {0x80, 0x90, 0x00, 0x00, 0x01, 0x00, 0x40, 0x03, 0x00, 0x10, 0x04, 0x00, 0x20, 0x20, 0x08, 0x00},
+    {0x04, 0x02, 0x0C, 0x00, 0x02, 0x01, 0x80, 0x00, 0x01, 0xD0, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00},
+    {0x00, 0x02, 0x00, 0x06, 0x00, 0x08, 0x1A, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0x40, 0x20, 0x40},
+    {0x10, 0x00, 0x00, 0x00, 0x04, 0x01, 0x08, 0x00, 0x00, 0x09, 0x48, 0x00, 0x48, 0x20, 0x00, 0x80},
+    {0x00, 0x04, 0x21, 0x01, 0x04, 0x08, 0x40, 0x10, 0x10, 0x00, 0x00, 0x01, 0x02, 0x00, 0x00, 0x10},
+    {0x00, 0x00, 0x00, 0x20, 0x00, 0x04, 0x40, 0x10, 0x12, 0x04, 0xE0, 0x40, 0x00, 0x00, 0x00, 0x20},
+    {0x00, 0x04, 0x04, 0x24, 0x25, 0x00, 0x00, 0x00, 0x00, 0x00, 0x84, 0x00, 0x03, 0x01, 0x00, 0x00},
+    {0x08, 0x08, 0x18, 0x28, 0x00, 0x00, 0x00, 0x02, 0x50, 0x08, 0x00, 0x20, 0x00, 0x00, 0x20, 0x00},
+    {0x08, 0x04, 0x80, 0x20, 0x00, 0x07, 0x01, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x08, 0x00},
+    {0x40, 0x04, 0x00, 0x06, 0x00, 0x00, 0x20, 0x00, 0x01, 0x08, 0x03, 0x00, 0x01, 0x80, 0x00, 0x04},
+    {0x04, 0x00, 0x01, 0x10, 0x00, 0x00, 0x80, 0x00, 0x01, 0x08, 0x03, 0x00, 0x50, 0x00, 0x18, 0x00},
+    {0x00, 0x00, 0x50, 0x00, 0x00, 0x40, 0x24, 0x80, 0x84, 0x40, 0x00, 0x18, 0x00, 0x00, 0x00, 0x01},
+    {0x00, 0x04, 0x80, 0x00, 0x00, 0x80, 0x00, 0x44, 0x00, 0x60, 0x4A, 0x00, 0x08, 0x00, 0x04, 0x00},
+    {0x24, 0x00, 0x8C, 0x02, 0x00, 0x00, 0x00, 0x41, 0x10, 0x04, 0x20, 0x00, 0x40, 0x00, 0x00, 0x00},
+    {0x00, 0x00, 0x08, 0x02, 0xD0, 0x30, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x08, 0x00, 0x00, 0x00, 0x41},
+    {0x00, 0x01, 0x00, 0x08, 0x11, 0x21, 0x10, 0x00, 0x00, 0x58, 0x01, 0x00, 0x00, 0x40, 0x00, 0x00},
+    {0x04, 0x10, 0x01, 0x00, 0x00, 0x08, 0x00, 0x80, 0x01, 0x00, 0x40, 0x00, 0x20, 0x40, 0x15, 0x00},
+    {0x50, 0x80, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x44, 0x00, 0x00, 0x04, 0x60, 0x04, 0x00, 0x10},
+    {0x02, 0x00, 0x40, 0x00, 0x00, 0x30, 0x00, 0x2A, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x01, 0x50},
+    {0x00, 0x10, 0x04, 0x00, 0x00, 0x01, 0x10, 0x03, 0x40, 0x80, 0x40, 0x40, 0x00, 0x02, 0x00, 0x04},
+};
+
+#endif // _BOARD_BANK_H_
@@ -0,0 +1,20 @@
+#ifndef _BOARD_CONFIG_H_
+#define _BOARD_CONFIG_H_
+
+// Board geometry shared by the game engine and the services built on top of it
+
+#define WIDTH 8
+#define HEIGHT 16
+
+// Overridable from the build flags, e.g. to sweep the mine density in the simulator
+#ifndef NUM_BOMBS
+#define NUM_BOMBS (WIDTH * HEIGHT / 10)
+#endif
+
+// The engine's data layout: a row is one byte of every tile bitset, tile
+// positions and the reveal queue indices are uint8_t
+static_assert(WIDTH == 8, "a board row must be one byte of the tile bitsets");
+static_assert(WIDTH * HEIGHT <= 255, "board too large for uint8_t tile positions");
+static_assert(NUM_BOMBS + 9 < WIDTH * HEIGHT, "the first shot needs room to move up to 9 mines away");
+
+#endif // _BOARD_CONFIG_H_
@@ -0,0 +1,49 @@
+#ifndef _BOARD_POOL_H_
+#define _BOARD_POOL_H_
+
+#include <stdint.h>
+
+#include "board_config.h"
+
+// Ready-made mine layouts, so a reset swaps a prepared board in instead of
+// generating one inside loop().
+//
+// A producer task at idle priority keeps up to BOARD_POOL_SIZE layouts in
+// the pool. It only runs when loop() and the BLE stack have nothing to do,
+// and sleeps until a board is taken. When the pool is empty (several resets in
+// a row), a layout comes from the flash bank in board_bank.h instead. It is
+// flipped at random so the bank does not repeat as often. Either way a reset
+// takes constant time, however slow the generator gets.
+
+#define BOARD_POOL_SIZE 4
+#define BOARD_POOL_STACK 2048
+
+typedef struct
+{
+  uint8_t mines[(WIDTH * HEIGHT + 7) / 8]; // Row bitset, as Minesweeper::reset(const uint8_t *) takes it
+} board_layout_t;
+
+#define BOARD_POOL_STATIC_BYTES (sizeof(board_layout_t) * BOARD_POOL_SIZE) // The pool, checked in board_pool.cpp
+
+typedef struct
+{
+  uint32_t generated;  // Layouts made by the producer
+  uint32_t from_pool;  // Resets served from the pool
+  uint32_t from_bank;  // ... from the flash bank, the pool was empty
+  uint32_t missed;     // ... by neither, the caller generated in place
+  uint32_t generate_max_us;
+  uint32_t ready;      // Layouts in the pool right now
+} board_pool_stats_t;
+
+#ifdef ESP_PLATFORM
+// Start the producer. Until then boardPoolTake() always misses, as it does on
+// the host, where the tools want a freshly generated board every game.
+void boardPoolBegin();
+#endif
+
+// A layout for the next game; false if none is ready and the caller must generate one
+bool boardPoolTake(board_layout_t *layout);
+
+void getBoardPoolStats(board_pool_stats_t *stats);
+
+#endif // _BOARD_POOL_H_
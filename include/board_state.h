@@ -0,0 +1,73 @@
+#ifndef _BOARD_STATE_H_
+#define _BOARD_STATE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "session.h"
+
+// Compact snapshot of a session's board, served by the read-only state
+// characteristic so that a client that connects or comes back can draw the
+// game without replaying it.
+//
+// Every session keeps its last encoding with the game's state_version(). A
+// read re-encodes only if the game changed since, so any number of reads
+// between two moves costs a version compare and no encoding. Reads come from
+// one task (the BLE stack, or the socket thread on the host).
+//
+// Layout, BOARD_STATE_HEADER bytes then three row bitsets and the counts:
+//   0      BOARD_STATE_FORMAT
+//   1..4   state version, little endian; equal versions mean equal boards
+//   5      BOARD_STATE_* status bits
+//   6      player on turn (in real time: the one who acted last)
+//   7..8   cursor of player 0, player 1 (row * WIDTH + column)
+//   9      number of revealed tiles
+//   then   revealed tiles, flags of player 0, flags of player 1:
+//          HEIGHT bytes each, byte = row, bit = column
+//   then   one nibble per revealed tile in tile order, low nibble first:
+//          its neighbouring mine count, BOARD_STATE_MINE for a revealed mine
+// Counts of hidden tiles are never sent.
+
+#define BOARD_STATE_FORMAT 1
+#define BOARD_STATE_HEADER 10
+#define BOARD_STATE_MAX_SIZE (BOARD_STATE_HEADER + 3 * HEIGHT + (WIDTH * HEIGHT + 1) / 2)
+
+#define BOARD_STATE_LOST 1
+#define BOARD_STATE_WON 2
+#define BOARD_STATE_REALTIME 4
+#define BOARD_STATE_MINE 0x0F
+
+typedef struct
+{
+  uint32_t reads;
+  uint32_t encodes;   // Reads that found the game changed
+  uint32_t retries;   // Encodings redone because loop() moved the game meanwhile
+  uint32_t unserved;  // Reads answered empty, no whole copy made yet
+  uint32_t encode_max_us;
+} board_state_stats_t;
+
+// Last encoding of a session, one per session
+typedef struct
+{
+  bool valid;
+  uint32_t version; // state_version() the encoding was made from
+  uint32_t stamp;
+  uint8_t length;
+  uint8_t data[BOARD_STATE_MAX_SIZE];
+} board_state_cache_t;
+
+#define BOARD_STATE_STATIC_BYTES (sizeof(board_state_cache_t) * MAX_SESSIONS) // Checked in board_state.cpp
+
+// Points `data` at the snapshot of `session` and returns its length. `stamp`
+// differs from the one of any earlier read whenever the bytes differ, so a
+// transport can skip copying a value it already holds. Returns 0 (an empty
+// value) if loop() kept the game moving through every copy of the first read.
+size_t boardStateRead(session_t *session, const uint8_t **data, uint32_t *stamp);
+
+// Uncached encoding into `out` (BOARD_STATE_MAX_SIZE bytes). Taken while loop()
+// plays, it is whole only if the game's read_retry() of the version in it is false.
+size_t boardStateEncode(session_t *session, uint8_t *out);
+
+void getBoardStateStats(board_state_stats_t *stats);
+
+#endif // _BOARD_STATE_H_
@@ -0,0 +1,64 @@
+#ifndef _CLOCK_SERVICE_H_
+#define _CLOCK_SERVICE_H_
+
+#include <stdint.h>
+
+#include "esp_timer.h"
+
+// Monotonic time for the firmware, in microseconds.
+//
+// On the device clockNow() is esp_timer_get_time(): no interrupt of its own,
+// microsecond resolution, safe to call from ISRs. Host builds can switch to
+// a virtual clock that only moves when told to, so timing-dependent logic
+// runs faster than real time and deterministically.
+//
+// Deadlines are one-shot timers that loop() polls: armed for a delay, they
+// expire once. The earliest armed deadline bounds how long loop() may sleep.
+// Deadlines belong to loop(), they are not safe to use from other tasks.
+
+#define CLOCK_MAX_DEADLINES 8
+
+typedef struct
+{
+  int64_t at; // clockNow() time it expires
+  bool armed;
+} clock_deadline_t;
+
+#ifdef ESP_PLATFORM
+static inline int64_t clockNow()
+{
+  return esp_timer_get_time();
+}
+#else
+extern bool clockVirtual;
+extern int64_t clockVirtualNow;
+
+static inline int64_t clockNow()
+{
+  return clockVirtual ? clockVirtualNow : esp_timer_get_time();
+}
+
+// Host only: run off a virtual clock starting at `start_us`, or back to real time
+void clockUseVirtual(bool enabled, int64_t start_us);
+void clockAdvance(int64_t us);
+
+// Jump to the earliest armed deadline; false if none is armed
+bool clockAdvanceToNextDeadline();
+#endif
+
+// Arm (or re-arm) `deadline` to expire `delay_us` from now
+void deadlineArm(clock_deadline_t *deadline, int64_t delay_us);
+void deadlineCancel(clock_deadline_t *deadline);
+
+// True once, the first time it is checked at or after its expiry; disarms it
+bool deadlineExpired(clock_deadline_t *deadline);
+
+static inline bool deadlineArmed(const clock_deadline_t *deadline)
+{
+  return deadline->armed;
+}
+
+// Microseconds until the earliest armed deadline: 0 if one is already due, -1 if none is armed
+int64_t clockNextDeadlineIn(int64_t now);
+
+#endif // _CLOCK_SERVICE_H_
@@ -0,0 +1,16 @@
+#ifndef _DIAGNOSTICS_H_
+#define _DIAGNOSTICS_H_
+
+// Line-based diagnostics console on the serial port. Subsystems register
+// their commands once; diagnosticsPoll() runs them from the main loop.
+
+#define MAX_DIAGNOSTICS_COMMANDS 16
+
+typedef void (*diagnostics_handler_t)(const char *args);
+
+void diagnosticsRegister(const char *name, const char *help, diagnostics_handler_t handler);
+
+// Read whatever arrived on Serial and run complete lines, never blocks
+void diagnosticsPoll();
+
+#endif // _DIAGNOSTICS_H_
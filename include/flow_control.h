@@ -0,0 +1,40 @@
+#ifndef _FLOW_CONTROL_H_
+#define _FLOW_CONTROL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "message_queue.h"
+#include "players.h"
+
+// Credit-based flow control between the clients and the message queue.
+//
+// Every seated connection owns CREDIT_WINDOW queue slots, its lane in the
+// message queue. A command takes a credit when it is queued and gives it back
+// when loop() dequeues it, so a lane never overflows. Commands sent out of
+// turn would only be thrown away by the dispatcher, they are rejected here
+// instead, without taking a credit or a slot (renames are always accepted).
+// Notifications sent back to the client:
+//   <command>               the command was queued (the usual echo)
+//   +<credits>,<depth>      <credits> more commands may be sent
+//   !<cmd>,<retry_ms>,<depth> the command was rejected, retry after <retry_ms>
+//   ~<cmd>                  the command was rejected, it is not your turn
+
+#define CREDIT_WINDOW MESSAGE_LANE_DEPTH
+#define FLOW_SERVICE_TIME_MS 10 // Retry hint per waiting command, one loop() iteration
+
+// Sends a notification to one connection
+typedef void (*flow_notify_t)(uint16_t conn_id, const uint8_t *data, size_t length);
+
+// Hand a newly seated connection its full window
+void flowControlConnected(uint16_t conn_id, flow_notify_t notify);
+
+// Queue a command if its sender has a credit left: echo on success, NACK with a retry hint otherwise.
+// An empty write is NACKed without spending a credit, so every queued message has a command byte.
+bool flowControlSubmit(uint16_t conn_id, const uint8_t mac_addr[6], const uint8_t *data, size_t length,
+                       flow_notify_t notify);
+
+// Give back the credit of a dequeued command, granting credits in batches of half a window
+void flowControlComplete(uint16_t conn_id, flow_notify_t notify);
+
+#endif // _FLOW_CONTROL_H_
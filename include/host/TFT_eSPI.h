@@ -0,0 +1,86 @@
+#ifndef _HOST_TFT_ESPI_H_
+#define _HOST_TFT_ESPI_H_
+
+// Host stand-in for the TFT_eSPI driver, used by the native build.
+// Nothing is displayed; the number of pixels touched is counted instead so
+// drawing code can be exercised and measured off-device.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+#define TFT_BLACK 0x0000
+#define TFT_NAVY 0x000F
+#define TFT_DARKGREY 0x7BEF
+#define TFT_BLUE 0x001F
+#define TFT_GREEN 0x07E0
+#define TFT_CYAN 0x07FF
+#define TFT_RED 0xF800
+#define TFT_MAGENTA 0xF81F
+#define TFT_YELLOW 0xFFE0
+#define TFT_WHITE 0xFFFF
+#define TFT_ORANGE 0xFDA0
+#define TFT_LIGHTGREY 0xD69A
+
+class TFT_eSPI
+{
+public:
+    TFT_eSPI(int16_t w = 135, int16_t h = 240) : _width(w), _height(h) {}
+
+    void init() {}
+    void setRotation(uint8_t) {}
+    int16_t width() { return _width; }
+    int16_t height() { return _height; }
+
+    void fillScreen(uint32_t) { pixels_drawn += (uint32_t)_width * _height; }
+    void fillRect(int32_t, int32_t, int32_t w, int32_t h, uint32_t) { pixels_drawn += w * h; }
+    void drawRect(int32_t, int32_t, int32_t w, int32_t h, uint32_t) { pixels_drawn += 2 * (w + h); }
+    void drawPixel(int32_t, int32_t, uint32_t) { pixels_drawn++; }
+    int16_t drawString(const char *text, int32_t, int32_t, uint8_t) { return _text_pixels(text); }
+
+    void setTextColor(uint16_t) {}
+    void setTextColor(uint16_t, uint16_t) {}
+    void setTextSize(uint8_t size) { _text_size = size; }
+    void setCursor(int16_t, int16_t) {}
+
+    size_t print(const char *text) { return _text_pixels(text); }
+    size_t print(int value)
+    {
+        char text[12];
+        snprintf(text, sizeof(text), "%d", value);
+        return print(text);
+    }
+    size_t printf(const char *format, ...)
+    {
+        char text[64];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(text, sizeof(text), format, args);
+        va_end(args);
+        return print(text);
+    }
+
+    uint16_t color565(uint8_t r, uint8_t g, uint8_t b)
+    {
+        return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+    }
+
+    uint32_t pixels_drawn = 0; // host only: pixels written since the last reset
+
+private:
+    size_t _text_pixels(const char *text)
+    {
+        size_t length = 0;
+        while (text[length])
+            length++;
+        // 6x8 glyph cell, scaled by the text size
+        pixels_drawn += length * 48 * _text_size * _text_size;
+        return length;
+    }
+
+    int16_t _width;
+    int16_t _height;
+    uint8_t _text_size = 1;
+};
+
+#endif // _HOST_TFT_ESPI_H_
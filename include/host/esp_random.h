@@ -0,0 +1,40 @@
+#ifndef _HOST_ESP_RANDOM_H_
+#define _HOST_ESP_RANDOM_H_
+
+// Host stand-in for the ESP-IDF random number API, used by the native build.
+// A seedable xorshift generator keeps host runs reproducible; the state is per
+// thread so that parallel tools stay reproducible too.
+
+#include <stdint.h>
+#include <stddef.h>
+
+inline uint32_t &host_random_state()
+{
+    static thread_local uint32_t state = 0x12345678;
+    return state;
+}
+
+inline void host_seed_random(uint32_t seed)
+{
+    host_random_state() = seed ? seed : 0x12345678;
+}
+
+inline uint32_t esp_random()
+{
+    uint32_t &x = host_random_state();
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+inline void esp_fill_random(void *buf, size_t len)
+{
+    uint8_t *bytes = (uint8_t *)buf;
+    for (size_t i = 0; i < len; i++)
+    {
+        bytes[i] = esp_random() & 0xFF;
+    }
+}
+
+#endif // _HOST_ESP_RANDOM_H_
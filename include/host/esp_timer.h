@@ -0,0 +1,15 @@
+#ifndef _HOST_ESP_TIMER_H_
+#define _HOST_ESP_TIMER_H_
+
+// Host stand-in for esp_timer_get_time(): microseconds since the first call
+
+#include <stdint.h>
+#include <chrono>
+
+inline int64_t esp_timer_get_time()
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+#endif // _HOST_ESP_TIMER_H_
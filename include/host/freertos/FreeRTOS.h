@@ -0,0 +1,33 @@
+#ifndef _HOST_FREERTOS_H_
+#define _HOST_FREERTOS_H_
+
+// Host stand-in for the FreeRTOS critical-section API, used by the native build.
+// A spinlock gives the same mutual exclusion as portMUX between host threads.
+
+#include <atomic>
+
+typedef struct
+{
+    std::atomic_flag locked;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {ATOMIC_FLAG_INIT}
+
+inline void host_port_enter_critical(portMUX_TYPE *mux)
+{
+    while (mux->locked.test_and_set(std::memory_order_acquire))
+    {
+    }
+}
+
+inline void host_port_exit_critical(portMUX_TYPE *mux)
+{
+    mux->locked.clear(std::memory_order_release);
+}
+
+#define portENTER_CRITICAL(mux) host_port_enter_critical(mux)
+#define portEXIT_CRITICAL(mux) host_port_exit_critical(mux)
+#define portENTER_CRITICAL_ISR(mux) host_port_enter_critical(mux)
+#define portEXIT_CRITICAL_ISR(mux) host_port_exit_critical(mux)
+
+#endif // _HOST_FREERTOS_H_
@@ -0,0 +1,17 @@
+#ifndef _HOT_PATH_H_
+#define _HOT_PATH_H_
+
+// HOT_PATH places a function in IRAM in the performance profile
+// (env:az-delivery-devkit-v4-perf), so the input dispatch, reveal and
+// tile-blit kernels do not stall on flash-cache misses while the BLE stack
+// competes for the cache. IRAM is scarce: keep the list short and measured
+// (scripts/perf_report.py). Elsewhere it expands to nothing.
+
+#if defined(PERF_PROFILE) && defined(ESP_PLATFORM)
+#include "esp_attr.h"
+#define HOT_PATH IRAM_ATTR
+#else
+#define HOT_PATH
+#endif
+
+#endif // _HOT_PATH_H_
@@ -0,0 +1,65 @@
+#ifndef _INPUT_EVENTS_H_
+#define _INPUT_EVENTS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "message_queue.h"
+
+// Single timestamped stream of everything loop() reacts to: debounced button
+// presses from the GPIO ISRs and markers for commands queued by the BLE task.
+// Command bytes stay in the message queue; a marker only keeps their order
+// relative to the buttons. Events come out in the order they happened.
+
+#define INPUT_MAX_BUTTONS 4
+#define INPUT_BUTTON_EVENTS 8 // Presses that can be pending on top of a full message queue
+#define INPUT_EVENT_CAPACITY (MAX_MESSAGES + INPUT_BUTTON_EVENTS)
+
+#define INPUT_DEBOUNCE_US 50000 // Quiet time after the last edge before a button can fire again
+
+typedef enum
+{
+  INPUT_EVENT_BUTTON,
+  INPUT_EVENT_COMMAND, // The next message of the message queue
+} input_event_type_t;
+
+typedef struct
+{
+  uint8_t type;
+  uint8_t button;      // INPUT_EVENT_BUTTON
+  uint16_t conn_id;    // INPUT_EVENT_COMMAND
+  int64_t timestamp;   // esp_timer time (us) of the edge / of the write
+} input_event_t;
+
+#define INPUT_STATIC_BYTES (sizeof(input_event_t) * INPUT_EVENT_CAPACITY) // The ring, checked in input_events.cpp
+
+typedef struct
+{
+  uint32_t presses;
+  uint32_t bounces;  // Edges swallowed by the debounce state machines
+  uint32_t filtered; // Presses dropped while their button was disabled
+  uint32_t overflows;
+} input_stats_t;
+
+// From the GPIO ISR of `button`, on every falling edge
+void inputButtonEdge(uint8_t button, int64_t now);
+
+// After a command made it into the message queue; false if its marker did not
+// fit. The command is still served, once no event is left ahead of it.
+bool inputCommandQueued(uint16_t conn_id, int64_t now);
+
+// Next event, oldest first. Presses of disabled buttons are filtered out here.
+bool inputNextEvent(input_event_t *event);
+
+// Before serving one more queued command in the same loop() iteration: takes
+// its marker and returns true if the next event is a command marker, or if no
+// event is left at all (a marker that did not fit). False if a button press
+// comes first, which loop() handles before any later command.
+bool inputTakeCommand();
+
+// Enable or disable buttons by bit mask; presses from while they were off never come out
+void inputSetButtonsEnabled(uint32_t mask, bool enabled);
+
+void getInputStats(input_stats_t *stats);
+
+#endif // _INPUT_EVENTS_H_
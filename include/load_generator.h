@@ -0,0 +1,70 @@
+#ifndef _LOAD_GENERATOR_H_
+#define _LOAD_GENERATOR_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "message_queue.h"
+
+// Transport-independent load generator for the input path.
+//
+// Simulated clients connect, send commands and disconnect through the same
+// entry points the BLE callbacks use, so the queue and the dispatcher see the
+// traffic a crowd of phones would produce. The caller drives it with
+// loadgenStep() from whatever thread plays the BLE stack.
+
+#define LOADGEN_MAX_CLIENTS 16
+#define LOADGEN_CONN_ID_BASE 16 // Simulated connection ids, above any real BLE conn_id
+#define LOADGEN_TASK_STACK 4096
+
+typedef struct
+{
+  uint32_t clients;             // simulated clients, at most LOADGEN_MAX_CLIENTS
+  uint32_t rate_hz;             // steady command rate of a client holding the turn
+  uint32_t out_of_turn_rate_hz; // command rate of every other client (spam)
+  uint32_t burst_size;          // commands sent back-to-back on every burst ...
+  uint32_t burst_period_ms;     // ... this often, per client (0 = no bursts)
+  uint32_t churn_period_ms;     // each client drops and reconnects this often (0 = never)
+  uint32_t duration_ms;
+  bool flow_control;            // clients honour credits and NACK retry hints
+} loadgen_config_t;
+
+// Entry points of the connection layer under test
+typedef struct
+{
+  void (*on_connect)(const uint8_t mac_addr[6], uint16_t conn_id);
+  void (*on_disconnect)(const uint8_t mac_addr[6], uint16_t conn_id);
+  bool (*on_write)(uint16_t conn_id, const uint8_t mac_addr[6], const uint8_t *data, size_t length); // false = dropped
+  bool (*has_turn)(uint16_t conn_id);                                                                // its move now
+} loadgen_hooks_t;
+
+typedef struct
+{
+  uint32_t elapsed_ms;
+  uint32_t offered;
+  uint32_t dropped;
+  uint32_t nacked;   // rejected with a retry hint (part of dropped)
+  uint32_t turn_rejected; // rejected as out of turn (part of dropped)
+  uint32_t deferred; // held back by the client for lack of credits
+  uint32_t out_of_turn;
+  uint32_t connects;
+  uint32_t disconnects;
+  message_queue_stats_t queue;
+} loadgen_report_t;
+
+#define LOADGEN_DEFAULT_CONFIG {4, 20, 50, 5, 1000, 3000, 5000, true}
+
+void loadgenBegin(const loadgen_config_t *config, const loadgen_hooks_t *hooks, int64_t now_us);
+
+// Issue every event due at `now_us`; false once the configured duration is over
+bool loadgenStep(int64_t now_us);
+
+// Notification from the server to a simulated connection (echo, credit grant or NACK)
+void loadgenOnNotify(uint16_t conn_id, const uint8_t *data, size_t length);
+
+// Disconnect every simulated client and collect the results
+void loadgenEnd(loadgen_report_t *report, int64_t now_us);
+
+size_t loadgenFormatReport(const loadgen_report_t *report, char *buffer, size_t size);
+
+#endif // _LOAD_GENERATOR_H_
@@ -0,0 +1,13 @@
+#ifndef _MELODIES_H_
+#define _MELODIES_H_
+
+#include "audio_mixer.h"
+
+// The game's tunes as compiled note tables (src/melodies.cpp), in flash
+
+extern const audio_melody_t melodyWin;
+extern const audio_melody_t melodyGameOver;
+extern const audio_melody_t melodySimpleMove;
+extern const audio_melody_t melodyPlaceBomb;
+
+#endif // _MELODIES_H_
@@ -0,0 +1,36 @@
+#ifndef _MEMORY_BUDGET_H_
+#define _MEMORY_BUDGET_H_
+
+#include <stdint.h>
+
+// RAM budget of the firmware, checked when it is built.
+//
+// Every table that grows with the board size, the number of sessions or the
+// number of players is sized at compile time, so a configuration that does not
+// fit must fail the build rather than overflow a stack at run time. The static
+// tables are summed against MEMORY_STATIC_BUDGET in memory_report.cpp; local
+// arrays whose size follows the configuration are checked where they are
+// declared, against a share of the stack of the task that runs them.
+//
+// "memory" on the serial console prints the same figures with what the heap
+// and the task stacks actually reached; scripts/memory_report.py lists the
+// static RAM of every object file and the deepest stack frames of a build.
+
+// DRAM the game's own tables may take; the BLE stack and the Arduino core
+// need most of the rest
+#define MEMORY_STATIC_BUDGET (48 * 1024)
+
+#ifdef CONFIG_ARDUINO_LOOP_STACK_SIZE
+#define MEMORY_LOOP_STACK CONFIG_ARDUINO_LOOP_STACK_SIZE
+#else
+#define MEMORY_LOOP_STACK 8192 // Arduino-ESP32 default
+#endif
+
+// Largest single local array allowed in a task's call tree, as a share of its stack
+#define MEMORY_FRAME_SHARE 8
+#define MEMORY_LOOP_FRAME_BUDGET (MEMORY_LOOP_STACK / MEMORY_FRAME_SHARE)
+
+// A task whose stack high-water leaves less than this is flagged by the report
+#define MEMORY_STACK_MARGIN 512
+
+#endif // _MEMORY_BUDGET_H_
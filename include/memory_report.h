@@ -0,0 +1,43 @@
+#ifndef _MEMORY_REPORT_H_
+#define _MEMORY_REPORT_H_
+
+#include <stdint.h>
+
+#include "memory_budget.h"
+
+// Runtime side of the memory budget (memory_budget.h): the static tables of
+// each subsystem as configured, what the heap and the task stacks have
+// reached since boot, and the largest block the heap could still hand out.
+
+typedef struct
+{
+  const char *name;
+  uint32_t bytes;
+} memory_region_t;
+
+typedef struct
+{
+  uint32_t total;
+  uint32_t free;
+  uint32_t min_free;      // Low-water mark of free, total - min_free is the high-water of use
+  uint32_t largest_block; // Largest single allocation that would succeed now
+} memory_heap_t;
+
+typedef struct
+{
+  const char *task;
+  uint32_t stack_bytes;
+  uint32_t free_min;  // Stack high-water, as the bytes never touched
+  bool running;       // false if the task does not exist (yet)
+} memory_stack_t;
+
+#define MEMORY_MAX_STACKS 8
+
+// Static tables per subsystem; returns how many were filled
+int getStaticMemory(const memory_region_t **regions);
+uint32_t getStaticMemoryTotal();
+
+void getHeapReport(memory_heap_t *heap);
+int getStackReport(memory_stack_t *stacks, int max_stacks);
+
+#endif // _MEMORY_REPORT_H_
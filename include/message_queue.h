@@ -0,0 +1,80 @@
+#ifndef _MESSAGE_QUEUE_H_
+#define _MESSAGE_QUEUE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Queue for handling messages received from the BLE callbacks in the main loop.
+//
+// Every connection with commands waiting gets its own lane, a FIFO sized for
+// its credit window (flow_control.h), so one client can never take the slots
+// of another. The consumer serves the lanes of the players whose turn it is
+// first, and among those the oldest command first: every message is stamped
+// with its arrival sequence, so two players racing for the same tile are
+// served in the order their commands came in, whichever lane they sit in.
+#ifndef MESSAGE_LANES
+#define MESSAGE_LANES 8 // One per seat of every session, checked in flow_control.cpp
+#endif
+#define MESSAGE_LANE_DEPTH 4
+#define MAX_MESSAGES (MESSAGE_LANES * MESSAGE_LANE_DEPTH)
+#define DISPATCH_BATCH MESSAGE_LANES // Messages loop() takes per iteration, a lane's worth each
+#define MAX_MESSAGE_LENGTH 20
+
+typedef struct
+{
+  uint8_t handle[6]; // Mac address of the device who sent the msg
+  uint16_t conn_id;  // Connection it came from, routes it to its session
+  uint16_t length;
+  uint8_t data[MAX_MESSAGE_LENGTH];
+  int64_t enqueued_at; // esp_timer time (us) when the message entered the queue
+  uint32_t sequence;   // Arrival order over all lanes
+} message_t;
+
+typedef struct
+{
+  message_t slots[MESSAGE_LANE_DEPTH];
+  uint8_t head;
+  uint8_t count;
+  uint16_t conn_id; // Owner, while count > 0
+} message_lane_t;
+
+// Only message_queue.cpp touches the lanes, the declaration is here for the memory report
+extern message_lane_t messageLanes[MESSAGE_LANES];
+
+// Queueing latency histogram: 8 exact buckets below 8 us, then 4 sub-buckets
+// per power of two, up to ~4 s
+#define LATENCY_BUCKETS 96
+
+typedef struct
+{
+  uint32_t enqueued;
+  uint32_t dropped; // Lane full, or no lane left
+  uint32_t dequeued;
+  uint32_t max_depth;
+  int64_t latency_max_us;
+  uint32_t latency_hist[LATENCY_BUCKETS];
+} message_queue_stats_t;
+
+// Copies the received bytes straight into the next free slot (the only copy on the receive path)
+bool addMessageToQueue(uint16_t conn_id, const uint8_t mac_addr[6], const uint8_t *data, size_t length);
+
+// Zero-copy consumer side for loop(): the slot stays valid, and is not reused by the
+// producer, until it is released. Single consumer only.
+message_t *peekMessageFromQueue();
+void releaseMessageFromQueue();
+
+// Lanes of connections for which this returns true are served first. It is
+// called by the consumer without any queue lock held.
+typedef bool (*message_priority_t)(uint16_t conn_id);
+void setMessageQueuePriority(message_priority_t priority);
+
+uint32_t getMessageQueueDepth();
+uint32_t getMessageLaneDepth(uint16_t conn_id); // Commands of this connection waiting
+
+void getMessageQueueStats(message_queue_stats_t *stats); // consistent snapshot
+void resetMessageQueueStats();
+
+// Upper bound (us) of the latency below which `per_mille` of the dequeued messages fall
+int64_t messageQueueLatencyPercentile(const message_queue_stats_t *stats, uint32_t per_mille);
+
+#endif // _MESSAGE_QUEUE_H_
@@ -0,0 +1,69 @@
+#ifndef _MINE_HINTS_H_
+#define _MINE_HINTS_H_
+
+#include <stdint.h>
+
+#include "board_config.h"
+
+#define HINT_UNKNOWN 0xFF // Tile is not on the frontier (or is revealed / flagged)
+
+// Mine probabilities for the hidden frontier tiles, one view per player since
+// each player has their own flags.
+//
+// Every revealed number is a constraint: (count - flags around it) mines are
+// spread over its hidden, unflagged neighbours. A frontier tile takes the
+// most pessimistic estimate of the constraints touching it, 0 or 100 when one
+// of them is certain. A tile changing state only affects the constraints in
+// its 3x3 and, through them, the tiles in its 5x5, so updates stay local.
+//
+// Changes are collected with mark_changed() and applied by flush(), which
+// recomputes the revealed tiles around them and the hidden, unflagged tiles
+// next to those, each exactly once. A cascade therefore never costs more than
+// a full rebuild, and a change with no revealed tile around it costs nothing.
+class MineHints
+{
+private:
+    uint8_t constraint[2][WIDTH * HEIGHT];  // percentage for revealed tiles, HINT_UNKNOWN otherwise
+    uint8_t probability[2][WIDTH * HEIGHT]; // percentage for frontier tiles, HINT_UNKNOWN otherwise
+    uint8_t changed[2][HEIGHT];             // tiles changed since the last flush, one row per byte
+
+    void _update_constraint(uint8_t player, uint8_t position, const uint8_t *revealed,
+                            const uint8_t *flagged, const uint8_t *neighbour_count);
+    void _update_probability(uint8_t player, uint8_t position, const uint8_t *revealed,
+                             const uint8_t *flagged);
+
+public:
+    MineHints();
+    void reset();
+
+    inline void mark_changed(uint8_t player, uint8_t position)
+    {
+        changed[player][position / WIDTH] |= 1 << (position % WIDTH);
+    }
+
+    inline bool pending(uint8_t player) const
+    {
+        for (int x = 0; x < HEIGHT; x++)
+        {
+            if (changed[player][x] != 0)
+                return true;
+        }
+        return false;
+    }
+
+    // Refresh everything the tiles marked since the last flush can affect, for one player.
+    // `revealed` and `flagged` are the row bitsets used by Minesweeper.
+    void flush(uint8_t player, const uint8_t *revealed, const uint8_t *flagged,
+               const uint8_t *neighbour_count);
+
+    // Recompute the whole board for one player (reference for the incremental path)
+    void rebuild(uint8_t player, const uint8_t *revealed, const uint8_t *flagged,
+                 const uint8_t *neighbour_count);
+
+    inline uint8_t get_probability(uint8_t player, uint8_t position) const
+    {
+        return probability[player][position];
+    }
+};
+
+#endif // _MINE_HINTS_H_
@@ -4,57 +4,126 @@
 #include "esp_random.h"
 
 #include "bt_commands.h"
+#include "board_config.h"
+#include "mine_hints.h"
 
 #include <TFT_eSPI.h>
 
-#define WIDTH 8
-#define HEIGHT 16
-
-#define NUM_BOMBS (WIDTH * HEIGHT / 10)
+// When set, mines under and around the first shot are moved elsewhere on the
+// board, so the first reveal can never end the game
+#ifndef SAFE_FIRST_CLICK
+#define SAFE_FIRST_CLICK 1
+#endif
 
 class Minesweeper
 {
 private:
-    uint8_t bombs[NUM_BOMBS];
+    uint8_t bomb_mask[(WIDTH * HEIGHT + 7) / 8];        // one bit per tile, same layout as flag_is_revealed
+    uint8_t neighbour_count[WIDTH * HEIGHT];             // cached number of neighbouring bombs for every tile
     uint8_t flag_is_revealed[(WIDTH * HEIGHT + 7) / 8]; // common for both players
     uint8_t player_position[2];
     uint8_t marked_as_bomb[2][(WIDTH * HEIGHT + 7) / 8]; // For marking positions as bombs
 
-    int player_turn; // 0 or 1, which player is currently playing
+    int player_turn; // 0 or 1, which player is currently playing (in real time: the one acting)
+    bool realtime;   // Every player moves at once: all cursors and flags are on screen
     bool is_lost;
+    bool first_shot_done; // mines may still be relocated until the first shot
+    MineHints hints;      // flushed for the acting player on every reveal / flag change, for the other one on use
+
+    // Revealed tiles the screen has not shown yet, row layout. Drawing only:
+    // the reveal itself is always complete, see animate_cascades().
+    uint8_t cascade_held[HEIGHT];
+    bool animate;
+
+    uint32_t version;                      // seqlock, see state_version()
+    uint8_t changing;                      // depth of the open ChangeScopes
+    uint8_t redraw[HEIGHT];                // tiles that changed since the last draw, row layout
+    uint8_t shown_hint[WIDTH * HEIGHT];    // hint each tile was last drawn with
     void _reveal_until_neighbouring_bomb(uint8_t position);
+    void _release_held();
+    inline void _mark_redraw(uint8_t position)
+    {
+        redraw[get_x_pos(position)] |= 1 << get_y_pos(position);
+    }
 
-public:
-    Minesweeper();
-    static inline uint8_t get_x_pos(uint8_t position);
-    static inline uint8_t get_y_pos(uint8_t position);
-    uint8_t is_bomb(uint8_t position)
+    // Write side of the version seqlock: every public call that changes what
+    // state_version() covers runs in one. A shot inside a move nests, only
+    // the outermost scope moves the version.
+    class ChangeScope
     {
+    public:
+        explicit ChangeScope(Minesweeper &game) : game(game)
+        {
+            if (game.changing++ == 0)
+            {
+                __atomic_store_n(&game.version, game.version + 1, __ATOMIC_RELAXED); // Odd: a copy from now on is torn
+                __atomic_thread_fence(__ATOMIC_RELEASE);                              // ... and seen odd before any write
+            }
+        }
+        ~ChangeScope()
         {
-            for (int i = 0; i < NUM_BOMBS; i++)
+            if (--game.changing == 0)
             {
-                if (bombs[i] == position)
-                {
-                    return 1;
-                }
+                __atomic_store_n(&game.version, game.version + 1, __ATOMIC_RELEASE); // Even, after every write
             }
-            return 0;
         }
+
+    private:
+        Minesweeper &game;
+    };
+    void _draw_tile(TFT_eSPI &tft, uint8_t position, bool show_hints);
+    int _cursor_at(uint8_t position); // Player whose cursor is drawn on the tile, -1 for none
+    bool _flag_shown(uint8_t position);
+    uint8_t _hint_shown(uint8_t position);
+
+    void _place_bomb(uint8_t position);
+    void _remove_bomb(uint8_t position);
+    void _make_first_shot_safe(uint8_t position);
+    void _flush_hints();
+    void _flush_hints_of(int player);
+
+public:
+    Minesweeper();
+    void reset(); // New board in place, no temporary object
+    void reset(const uint8_t *mine_rows); // Same, with a prepared layout (board_pool.h)
+
+    // NUM_BOMBS random mines as a row bitset, the layout reset() starts from
+    static void generate_mines(uint8_t *mine_rows);
+    static inline uint8_t get_x_pos(uint8_t position)
+    {
+        return position >> 3;
+    }
+    static inline uint8_t get_y_pos(uint8_t position)
+    {
+        return position & 0x07;
+    }
+    uint8_t is_bomb(uint8_t position)
+    {
+        return (bomb_mask[get_x_pos(position)] >> get_y_pos(position)) & 1;
     }
     void move_player(command_t command);
+    void jump_player(uint8_t position); // Absolute move, ignored if off the board
     uint8_t get_player_position()
     {
         return player_position[player_turn];
     }
-    inline bool is_revealed(uint8_t position);
+    inline bool is_revealed(uint8_t position)
+    {
+        return (flag_is_revealed[get_x_pos(position)] & (1 << get_y_pos(position))) != 0;
+    }
     inline void set_revealed(uint8_t position);
 
     bool is_marked_as_bomb(uint8_t position);
-    void set_marked_as_bomb(uint8_t position);
+    bool set_marked_as_bomb(uint8_t position); // Toggles the flag; false for a revealed tile, nothing changes
 
     void builtin_button_pressed();
 
     bool shoot();
+
+    // Reveal every hidden, unflagged neighbour of a revealed number whose flags
+    // around it already match it. False if the number is not satisfied (nothing
+    // changes); a wrong flag loses the game like a shot would.
+    bool chord(uint8_t position);
     uint8_t how_many_neighbouring_bombs(uint8_t position);
 
     inline bool is_game_over()
@@ -62,13 +131,108 @@ public:
         return is_lost;
     }
 
-    void draw_map(TFT_eSPI &tft);
+    // Mine probability (percent) of a hidden frontier tile for the current player,
+    // HINT_UNKNOWN for any other tile
+    inline uint8_t get_hint(uint8_t position)
+    {
+        _flush_hints_of(player_turn); // Changes by the other player are applied on first use
+        return hints.get_probability(player_turn, position);
+    }
+
+    void rebuild_hints(); // full-board recompute, the incremental updates must match it
+
+    // Raw state for tools that work on whole boards (host simulator)
+    inline const uint8_t *get_revealed_rows() const
+    {
+        return flag_is_revealed;
+    }
+    inline const uint8_t *get_marked_rows() const
+    {
+        return marked_as_bomb[player_turn];
+    }
+    inline const uint8_t *get_neighbour_counts() const
+    {
+        return neighbour_count;
+    }
+    inline const uint8_t *get_flag_rows(int player) const
+    {
+        return marked_as_bomb[player];
+    }
+    inline int get_player_turn() const
+    {
+        return player_turn;
+    }
+    inline uint8_t get_position_of(int player) const
+    {
+        return player_position[player];
+    }
+
+    // Seqlock over everything above, the cursors, the turn, the mode and the
+    // outcome: odd while loop() is changing them, moved on by every change and
+    // never back, reset() included. Another task copies the state after
+    // reading state_version() and copies again while read_retry() of that
+    // value is true (board_state.cpp).
+    inline uint32_t state_version() const
+    {
+        return __atomic_load_n(&version, __ATOMIC_ACQUIRE);
+    }
+    inline bool read_retry(uint32_t started) const
+    {
+        __atomic_thread_fence(__ATOMIC_ACQUIRE); // The copy is complete before the version is read again
+        return (started & 1) != 0 || __atomic_load_n(&version, __ATOMIC_RELAXED) != started;
+    }
+
+    // Draw reveal cascades one BFS ring per step_cascade() call instead of all
+    // at once. Only the drawing is spread: the board, the hints, won() and the
+    // snapshot have the whole reveal as soon as the shot or chord returns.
+    // draw_map() shows the held rings at once. Off by default.
+    void animate_cascades(bool enabled);
+    bool step_cascade(); // True while rings are left to draw
+    inline bool cascade_pending() const
+    {
+        for (int row = 0; row < HEIGHT; row++)
+        {
+            if (cascade_held[row] != 0)
+                return true;
+        }
+        return false;
+    }
+
+    void draw_map(TFT_eSPI &tft, bool show_hints = false);
+    void draw_changes(TFT_eSPI &tft, bool show_hints = false); // Only tiles changed since the last draw
+    inline void invalidate_map()
+    {
+        for (int row = 0; row < HEIGHT; row++)
+        {
+            redraw[row] = 0xFF;
+        }
+    }
 
     bool won();
 
+    // Whose cursor and flags the next commands use. In turn-based play the
+    // screen shows only that player's, so a change redraws the board.
     inline void set_player_turn(int turn)
     {
-        player_turn = turn;
+        if (turn != player_turn)
+        {
+            ChangeScope change(*this);
+            player_turn = turn;
+            if (!realtime)
+            {
+                invalidate_map(); // Cursor and flags on screen are the ones of the player on turn
+            }
+        }
+    }
+
+    // Real-time play: the session switches the acting player on every
+    // command, the screen shows every cursor and every flag, and the hint
+    // overlay follows the first player. A mine is found once either player
+    // flags it. Kept across reset(), off by default.
+    void set_realtime(bool enabled);
+    inline bool is_realtime() const
+    {
+        return realtime;
     }
 
     bool displayed_final = false;
@@ -0,0 +1,40 @@
+#ifndef _PLAYER_CACHE_H_
+#define _PLAYER_CACHE_H_
+
+#include <stdint.h>
+
+#include "players.h"
+
+// Bounded MAC -> player identity cache, persisted in NVS on the device.
+//
+// A device that renamed itself gets its name back as soon as it is seated
+// again, even after its held seat expired or the board rebooted. When the
+// cache is full the least recently seen entry is replaced. Lookups and stores
+// only touch RAM; playerCacheCommit() writes the flash, from loop(), and only
+// when something changed. Host builds keep the cache in RAM.
+
+#define PLAYER_CACHE_ENTRIES 8
+#define PLAYER_CACHE_NAMESPACE "players"
+
+typedef struct
+{
+  uint8_t mac[6];
+  char name[PLAYER_NAME_LENGTH];
+  uint32_t last_seen; // cacheClock value of the last lookup or store, 0 = free entry
+} player_cache_entry_t;
+
+#define PLAYER_CACHE_STATIC_BYTES (sizeof(player_cache_entry_t) * PLAYER_CACHE_ENTRIES) // Checked in player_cache.cpp
+
+// Load the persisted entries; call once before the transports start
+void playerCacheBegin();
+
+// Copy the cached name of this device into `name`; false if it is unknown
+bool playerCacheLookup(const uint8_t mac_addr[6], char name[PLAYER_NAME_LENGTH]);
+
+// Remember the name of this device
+void playerCacheStore(const uint8_t mac_addr[6], const char *name);
+
+// Write pending changes to flash; false if nothing was pending
+bool playerCacheCommit();
+
+#endif // _PLAYER_CACHE_H_
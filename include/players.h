@@ -0,0 +1,45 @@
+#ifndef _PLAYERS_H_
+#define _PLAYERS_H_
+
+#include <stdint.h>
+
+#define MAX_PLAYERS 2
+#define PLAYER_NAME_LENGTH 10
+#define PLAYER_AWAY 0xFFFF // conn_id of a dropped player whose seat is still held
+
+struct device_connected_t
+{
+  uint8_t remote_bda[6]; // Remote Bluetooth device address
+  char name[PLAYER_NAME_LENGTH];
+  uint16_t conn_id;     // Connection the notifications for this device go to
+  uint8_t credits;      // Commands it may still queue (flow_control.h)
+  uint8_t credits_owed; // Credits returned by loop() but not granted yet
+  int64_t away_since;   // Time the link dropped, while conn_id is PLAYER_AWAY
+  uint32_t out_of_turn; // Commands rejected at enqueue, not this player's turn
+  uint32_t dropped;     // Commands rejected for lack of credit or lane space
+};
+
+inline bool playerAway(const device_connected_t *device)
+{
+  return device->conn_id == PLAYER_AWAY;
+}
+
+// The players seated at one game, in turn order
+struct player_table_t
+{
+  device_connected_t devices[MAX_PLAYERS]; // Structure to hold connected device information
+  uint32_t size;
+};
+
+// Index of the device with this address / connection, -1 if it is not seated here
+int findDevice(const player_table_t *table, const uint8_t mac_addr[6]);
+int findConnection(const player_table_t *table, uint16_t conn_id);
+
+// Seat a newly connected device; false if it was already known or the table is full
+bool addDevice(player_table_t *table, const uint8_t mac_addr[6], uint16_t conn_id);
+
+// Remove a disconnected device, shifting the later ones down; false if it was unknown
+bool removeDevice(player_table_t *table, uint16_t conn_id);
+void removeSeat(player_table_t *table, int seat);
+
+#endif // _PLAYERS_H_
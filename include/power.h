@@ -0,0 +1,60 @@
+#ifndef _POWER_H_
+#define _POWER_H_
+
+#include <stdint.h>
+
+// Activity-driven power management. The CPU is held at full clock only while
+// loop() has work (a command, a frame, a tune); in between it waits for a
+// wake-up and lets the PM driver scale down and enter automatic light sleep.
+//
+// Wake sources (BLE writes, button ISRs) call powerWake() so loop() resumes
+// at once instead of at the end of its poll period. The delay between the
+// wake-up and loop() running again is measured against POWER_WAKE_BUDGET_US.
+//
+// Frequency scaling and light sleep need CONFIG_PM_ENABLE (and tickless idle)
+// in the SDK. The prebuilt sdkconfig of the Arduino framework has neither, so
+// in this build only the wake-ups and the residency accounting are active and
+// the "power" command reports PM off. A framework = arduino, espidf build with
+// CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE turns the rest on.
+
+#define POWER_MANAGEMENT 1
+
+#define POWER_MAX_FREQ_MHZ 240
+#define POWER_MIN_FREQ_MHZ 80 // Keeps APB at 80 MHz for the timer, SPI and LEDC dividers
+
+#define POWER_IDLE_POLL_MS 100    // Longest sleep when no deadline is armed
+#define POWER_WAKE_BUDGET_US 5000 // Wake-up to loop() running again
+#define POWER_BUTTON_POLL_MS 30   // Longest sleep while the button interrupts are masked for light sleep
+
+typedef struct
+{
+  uint64_t active_us;
+  uint64_t idle_us;
+  uint32_t wakeups;
+  uint32_t wake_latency_max_us;
+  uint64_t wake_latency_total_us;
+  uint32_t over_budget;
+  uint32_t button_wakeups; // Light sleep left for a button press
+  bool light_sleep; // false when the SDK has no tickless idle, frequency scaling only
+  bool enabled;
+} power_stats_t;
+
+// Configure frequency scaling / light sleep and take the active lock for setup()
+void powerBegin(const uint8_t *wakeup_pins, int pin_count);
+
+// Called from loop(): drop to idle until woken or timeout_ms passes, then go active
+// again. Returns the wake-up pins (bit = index in powerBegin()'s list) pressed
+// meanwhile, whose ISR was masked then; loop() feeds them to the input stream.
+uint32_t powerIdle(uint32_t timeout_ms);
+
+// Keep light sleep out while a peripheral (the buzzer) is running on its own clock
+void powerHoldAwake(bool hold);
+
+// Wake loop() from a task or from an ISR
+void powerWake();
+void powerWakeFromISR();
+
+void getPowerStats(power_stats_t *stats);
+void resetPowerStats();
+
+#endif // _POWER_H_
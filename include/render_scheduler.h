@@ -0,0 +1,41 @@
+#ifndef _RENDER_SCHEDULER_H_
+#define _RENDER_SCHEDULER_H_
+
+#include <stdint.h>
+
+// Frame pacing for the display. State changes only mark parts of the screen
+// dirty; loop() renders at most one frame per RENDER_FRAME_US, so a burst of
+// commands collapses into a single redraw. Each frame is timed against its
+// budget, the share of the frame period the renderer may take.
+
+#define RENDER_TARGET_FPS 30
+#define RENDER_FRAME_US (1000000 / RENDER_TARGET_FPS)
+#define RENDER_BUDGET_US (RENDER_FRAME_US / 2) // Leave the rest of the frame to input and audio
+
+// Dirty flags
+#define RENDER_SCREEN 0x01 // Labels of the current screen (ui_widgets.h), repainted only where changed
+#define RENDER_MAP 0x02    // The board, when the game screen is shown
+
+typedef struct
+{
+  uint32_t frames;
+  uint32_t requests;  // renderRequest() calls
+  uint32_t coalesced; // Requests that were folded into a frame already pending
+  uint32_t over_budget;
+  uint32_t cost_max_us;
+  uint64_t cost_total_us;
+} render_stats_t;
+
+void renderRequest(uint32_t flags);
+
+// Microseconds until the pending frame is due: 0 when due now, -1 when nothing is dirty
+int64_t renderDueIn(int64_t now);
+
+// Take the dirty flags of the frame that starts now, and report its end
+uint32_t renderBegin(int64_t now);
+void renderEnd(int64_t now);
+
+void getRenderStats(render_stats_t *stats);
+void resetRenderStats();
+
+#endif // _RENDER_SCHEDULER_H_
@@ -0,0 +1,141 @@
+#ifndef _SESSION_H_
+#define _SESSION_H_
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "minesweeper.h"
+#include "message_queue.h"
+#include "players.h"
+#include "flow_control.h"
+
+// Fixed pool of game sessions sharing one host. Every session has its own
+// board, players and turn, or plays in real time: then every player moves,
+// flags and shoots at once with their own cursor and flags, and commands take
+// effect in the order they arrived (message_queue.h). Connections are routed to their session through a
+// table indexed by connection id, so finding the session of a command is O(1).
+
+// Both can be raised from the build flags, e.g. for the host socket server
+#ifndef MAX_SESSIONS
+#define MAX_SESSIONS 4
+#endif
+#ifndef MAX_CONNECTIONS
+#define MAX_CONNECTIONS 32 // Routing table size: BLE conn ids, then the simulated ones
+#endif
+
+#define SESSION_FINISHED_HOLD_US 10000000 // A finished game off screen is restarted after 10 s
+#define SESSION_GRACE_US 30000000         // A dropped player's seat is held this long for a reconnect
+
+static_assert(MAX_SESSIONS <= 32, "expireAwaySeats() reports sessions in a 32-bit mask");
+static_assert(MAX_PLAYERS <= 2, "Minesweeper keeps a cursor and a flag layer for two players only");
+
+struct session_t
+{
+  Minesweeper game;
+  player_table_t players;
+  int player_turn;     // Index in players of whoever plays now; in real time, of whoever acted last
+  bool realtime;       // Everyone plays at once, toggled with the 'M' command
+  bool show_hints;     // Mine probability overlay, toggled with the 'H' command
+  int64_t finished_at; // esp_timer time the game ended, 0 while it is running
+};
+
+extern session_t sessions[MAX_SESSIONS];
+
+// The player tables and the connection routes belong to loop(), the only task
+// that removes a seat or moves seats around (expireAwaySeats()). The transport
+// tasks (BLE stack, load generator) may only seat a connection, hold a seat or
+// hand it back (joinSession(), leaveSession()) and look at the tables, all
+// under sessionMux; loop() takes it for its own changes and reads without it.
+extern portMUX_TYPE sessionMux;
+
+#define SESSION_ROUTES_STATIC_BYTES (sizeof(int8_t) * MAX_CONNECTIONS) // Routing table, checked in session.cpp
+
+// What a dispatched command changed, for the caller to redraw / play sounds
+enum session_effect_t
+{
+  EFFECT_NONE = 0,
+  EFFECT_MOVED = 1,   // cursor moved
+  EFFECT_SHOT = 2,    // tile revealed, turn passed on
+  EFFECT_RENAMED = 4, // player name changed
+  EFFECT_HINTS = 8,   // hint overlay toggled
+  EFFECT_IGNORED = 16, // not from the player whose turn it is
+  EFFECT_FLAGGED = 32, // flag toggled remotely
+  EFFECT_MODE = 64     // switched between turns and real time
+};
+
+typedef struct
+{
+  uint32_t held;     // Drops that kept their seat
+  uint32_t restored; // Reconnects within the grace period
+  uint32_t expired;  // Seats given up after the grace period
+  uint32_t named;    // New seats that got their name back from the player cache
+  int64_t outage_total_us;
+  int64_t outage_max_us;
+  uint32_t playable_total_us; // Reconnect event to the first credits granted
+  uint32_t playable_max_us;
+} reconnect_stats_t;
+
+inline int sessionIndex(const session_t *session)
+{
+  return session - sessions;
+}
+
+inline device_connected_t *currentPlayer(session_t *session)
+{
+  return session->players.size ? &session->players.devices[session->player_turn] : NULL;
+}
+
+// O(1) routing, NULL if the connection is not seated. Outside loop(), under
+// sessionMux, and the device only for as long as it is held.
+session_t *sessionOfConnection(uint16_t conn_id);
+device_connected_t *deviceOfConnection(uint16_t conn_id);
+
+// True if this connection holds the turn of its session (message queue
+// priority); in a real-time session every seated connection does. Takes
+// sessionMux, any task.
+bool sessionHasTurn(uint16_t conn_id);
+
+// Seat a new connection. A device coming back within the grace period gets
+// its held seat, with turn, name and cursor as it left them (`restored` is
+// set); otherwise it is paired with a waiting player first and takes its name
+// from the player cache. NULL if every session is full.
+session_t *joinSession(const uint8_t mac_addr[6], uint16_t conn_id, bool *restored = NULL);
+
+// Hold the seat of a dropped connection for SESSION_GRACE_US; returns its session, NULL if it had none
+session_t *leaveSession(uint16_t conn_id);
+
+// Give up the seats held longer than the grace period, which resets the turn of
+// their session. Returns a mask of the sessions that lost a player.
+uint32_t expireAwaySeats(int64_t now_us);
+
+// Time from a reconnect event until the restored player could play again
+void sessionReconnectPlayable(uint32_t elapsed_us);
+
+void getReconnectStats(reconnect_stats_t *stats);
+
+// Start a new game in place, keeping the players
+void resetSession(session_t *session);
+
+// Switch between turn-based and real-time play; the board is kept
+void setSessionRealtime(session_t *session, bool realtime);
+
+// Apply one command of a seated connection; returns session_effect_t flags.
+// Turn-based, only the player on turn is served; in real time every seated
+// player is, each with their own cursor and flags, and no turn passes on.
+//   L R U D          move the cursor one cell
+//   S                reveal under the cursor, turn passes on
+//   J<row>,<col>     jump the cursor to a cell (row 0-15, col 0-7)
+//   F[<row>,<col>]   flag / unflag a cell (default: the cursor), the cursor stays
+//   C[<row>,<col>]   chord a satisfied number (default: under the cursor), the
+//                    cursor stays and the turn passes on; a no-op otherwise
+//   N<name>          rename, H toggles the hint overlay and replies H<percent>
+//   M                toggle real-time play, every seated player is notified M0 / M1
+uint32_t sessionDispatch(session_t *session, const message_t *message, flow_notify_t notify);
+
+// Apply only a rename ('N'), the one command accepted while the menu is shown
+uint32_t sessionRename(session_t *session, const message_t *message);
+
+// Restart finished games that nobody is looking at, except `on_screen`
+void reapFinishedSessions(const session_t *on_screen, int64_t now_us);
+
+#endif // _SESSION_H_
@@ -0,0 +1,31 @@
+#ifndef _SOCKET_TRANSPORT_H_
+#define _SOCKET_TRANSPORT_H_
+
+#include "session.h"
+#include "transport.h"
+
+// Host-only backend: a local stream socket server standing in for the BLE
+// stack. Every accepted socket is one client, every newline-terminated line it
+// sends is one characteristic write, and every notification comes back as one
+// line. A line "?" reads the board state characteristic instead, answered with
+// "=" and the snapshot in hex (board_state.h). Address: "unix:<path>" or
+// "tcp:<port>" (bound to 127.0.0.1).
+
+#define SOCKET_CONN_ID_BASE 0
+#define SOCKET_MAX_CONNECTIONS MAX_CONNECTIONS
+#define SOCKET_DEFAULT_ADDRESS "unix:/tmp/bluebomb.sock"
+
+typedef struct
+{
+  uint32_t accepted;
+  uint32_t rejected; // No free connection id
+  uint32_t lines;
+  uint32_t notifications;
+  uint32_t notify_dropped; // Client not reading, its socket buffer was full
+} socket_transport_stats_t;
+
+extern const transport_t socketTransport;
+
+void getSocketTransportStats(socket_transport_stats_t *stats);
+
+#endif // _SOCKET_TRANSPORT_H_
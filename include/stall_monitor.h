@@ -0,0 +1,51 @@
+#ifndef _STALL_MONITOR_H_
+#define _STALL_MONITOR_H_
+
+#include <stdint.h>
+
+// Watchdog-style stall monitor for loop() and the other polling tasks.
+//
+// A monitored task marks the start of each iteration with stallHeartbeat()
+// and names what it is doing with stallSection(). Time spent in the NULL
+// section (waiting on purpose, e.g. powerIdle()) does not count, so a gap is
+// the busy time of one iteration. The longest gaps are kept together with
+// the section that was running: the one the watchdog caught still running
+// past STALL_THRESHOLD_US, otherwise the longest section of that iteration.
+
+#define STALL_MAX_TASKS 4
+#define STALL_RECORDS 8          // Longest gaps kept
+#define STALL_THRESHOLD_US 50000 // Busy this long without a heartbeat counts as a stall
+
+typedef struct
+{
+  const char *task;
+  const char *section;
+  uint32_t gap_us;
+  int64_t at_us; // esp_timer time the iteration ended
+} stall_record_t;
+
+#define STALL_STATIC_BYTES (sizeof(stall_record_t) * STALL_RECORDS) // Kept records, checked in stall_monitor.cpp
+
+typedef struct
+{
+  uint32_t iterations;
+  uint32_t stalls; // Iterations over STALL_THRESHOLD_US
+  uint32_t longest_gap_us;
+} stall_task_stats_t;
+
+// Returns the slot of the calling task, -1 if the table is full
+int stallRegister(const char *task);
+
+void stallHeartbeat(int slot);
+void stallSection(int slot, const char *section);
+
+// Watchdog pass, from a one-shot timer armed for STALL_THRESHOLD_US while a
+// task is busy (a periodic one would keep waking the CPU from light sleep)
+void stallCheck();
+
+// Longest first; returns how many records were filled
+int getStallRecords(stall_record_t *records, int max_records);
+bool getStallTaskStats(int slot, const char **task, stall_task_stats_t *stats);
+void resetStallRecords();
+
+#endif // _STALL_MONITOR_H_
@@ -0,0 +1,108 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+
+// Span tracing, to see where the time of one particular move went.
+//
+// traceBegin()/traceEnd() record a timestamped event with a static name ID
+// into a fixed ring buffer; nothing is formatted or allocated until the
+// buffer is dumped, so a span costs two short critical sections. The ring
+// keeps the last TRACE_RECORDS events and overwrites the oldest.
+//
+// The device dumps the ring over serial ("trace dump"), and
+// scripts/trace_to_chrome.py turns that into Chrome / Perfetto trace JSON.
+// Host builds write the same JSON directly with traceWriteChrome().
+//
+// Each event carries the core it ran on (the thread, on the host), so BLE
+// callbacks and loop() show up as separate tracks.
+
+#ifndef TRACE_RECORDS
+#define TRACE_RECORDS 512 // 8 bytes each
+#endif
+
+typedef enum
+{
+  TRACE_BLE_CONNECT,
+  TRACE_BLE_DISCONNECT,
+  TRACE_BLE_WRITE,
+  TRACE_QUEUE_ADD,
+  TRACE_QUEUE_PEEK,
+  TRACE_QUEUE_RELEASE,
+  TRACE_DISPATCH,
+  TRACE_MOVE,
+  TRACE_SHOOT,
+  TRACE_CHORD,
+  TRACE_REVEAL,
+  TRACE_HINTS,
+  TRACE_RENDER,
+  TRACE_DRAW_MAP,
+  TRACE_DRAW_CHANGES,
+  TRACE_AUDIO,
+  TRACE_NAMES
+} trace_name_t;
+
+typedef struct
+{
+  uint32_t at_us; // Low bits of esp_timer time, unwrapped when dumped
+  uint8_t name;   // trace_name_t
+  uint8_t phase;  // 'B' or 'E'
+  uint8_t tid;    // Core on the device, thread on the host
+  uint8_t reserved;
+} trace_record_t;
+
+#define TRACE_STATIC_BYTES (sizeof(trace_record_t) * TRACE_RECORDS) // The ring, checked in trace.cpp
+
+typedef struct
+{
+  uint32_t recorded;
+  uint32_t overwritten;
+} trace_stats_t;
+
+// Devices trace from boot; host builds only once a tool enables it
+void traceEnable(bool enabled);
+bool traceEnabled();
+
+void traceBegin(trace_name_t name);
+void traceEnd(trace_name_t name);
+
+const char *traceName(trace_name_t name);
+
+// One span for the rest of the enclosing scope, for functions with several returns
+class TraceScope
+{
+public:
+  explicit TraceScope(trace_name_t name) : name(name)
+  {
+    traceBegin(name);
+  }
+  ~TraceScope()
+  {
+    traceEnd(name);
+  }
+
+private:
+  trace_name_t name;
+};
+
+// Print the ring oldest first, one line per event, between "trace begin" and
+// "trace end" marker lines. A full ring is seconds of serial output, so the
+// dump is spread over loop() passes: traceDumpBegin() pauses tracing and
+// every traceDumpStep() emits at most max_lines, tracing resumes after the
+// last one. traceEnable() during a dump takes effect when it ends.
+#define TRACE_DUMP_LINE_MAX 48 // Longest line, with the line break the caller adds
+
+typedef void (*trace_line_t)(const char *line);
+void traceDumpBegin();
+bool traceDumpStep(trace_line_t emit, int max_lines); // True while lines are left
+bool traceDumping();
+
+void getTraceStats(trace_stats_t *stats);
+void resetTrace();
+
+#ifndef ESP_PLATFORM
+// Host only: the ring as Chrome trace JSON; false if the file cannot be written
+bool traceWriteChrome(const char *path);
+#endif
+
+#endif // _TRACE_H_
@@ -0,0 +1,51 @@
+#ifndef _TRANSPORT_H_
+#define _TRANSPORT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Transport interface between the client connections and the connection
+// layer (session seating, flow control, the message queue).
+//
+// A backend (BLE on the device, local sockets on the host) reports connects,
+// disconnects, writes and board state reads through transport_events_t, from
+// its own task or thread, and delivers notifications back to one connection.
+// Each backend owns a range of connection ids, which is how a notification
+// finds its way back to the right backend.
+
+#define MAX_TRANSPORTS 4
+
+typedef struct
+{
+  void (*on_connect)(const uint8_t mac_addr[6], uint16_t conn_id);
+  void (*on_disconnect)(const uint8_t mac_addr[6], uint16_t conn_id);
+  bool (*on_write)(uint16_t conn_id, const uint8_t mac_addr[6], const uint8_t *data, size_t length); // false = dropped
+  // Read of the board state (board_state.h): points `data` at the snapshot of
+  // the reader's session and returns its length, 0 if it is not seated.
+  // `stamp` changes whenever the bytes do. NULL if reads are not served.
+  size_t (*on_read)(uint16_t conn_id, const uint8_t **data, uint32_t *stamp);
+} transport_events_t;
+
+typedef struct
+{
+  const char *name;
+  // Start accepting clients; `address` is backend specific (BLE device name, socket path, ...)
+  bool (*begin)(const char *address, const transport_events_t *events);
+  void (*notify)(uint16_t conn_id, const uint8_t *data, size_t length);
+  void (*end)(); // May be NULL
+} transport_t;
+
+// Give `transport` the connection ids [first_conn_id, first_conn_id + count)
+bool transportRegister(const transport_t *transport, uint16_t first_conn_id, uint16_t count);
+
+// Start every registered backend that has a begin()
+bool transportBeginAll(const char *address, const transport_events_t *events);
+void transportEndAll();
+
+// Route a notification to the backend owning `conn_id`
+void transportNotify(uint16_t conn_id, const uint8_t *data, size_t length);
+
+// Backend owning `conn_id`, NULL if none
+const transport_t *transportOfConnection(uint16_t conn_id);
+
+#endif // _TRANSPORT_H_
@@ -0,0 +1,68 @@
+#ifndef _UI_WIDGETS_H_
+#define _UI_WIDGETS_H_
+
+#include <stdint.h>
+
+#include <TFT_eSPI.h>
+
+// Retained-mode widgets on top of TFT_eSPI.
+//
+// A label keeps the text it should show and the text it last put on screen,
+// with its bounds. uiRender() repaints only the labels whose text or colour
+// changed, over exactly the cells that differ in length, so renaming a player
+// costs one line of glyphs instead of a full screen. A screen groups labels
+// over one background colour; the screen is cleared only when it is entered.
+
+#define UI_LABEL_TEXT 40 // With the terminator; main.cpp checks its longest rows against it
+#define UI_GLYPH_WIDTH 6  // Built-in GLCD font cell, scaled by the text size
+#define UI_GLYPH_HEIGHT 8
+
+typedef struct
+{
+  int16_t x, y;
+  uint8_t size;
+  uint16_t fg, bg;
+  char text[UI_LABEL_TEXT];  // What the label should show
+  char drawn[UI_LABEL_TEXT]; // What is on screen
+  uint16_t drawn_fg;
+  int16_t drawn_width;       // Pixels covered by `drawn`
+  bool valid;                // The screen shows `text` in `fg`
+} ui_label_t;
+
+typedef struct
+{
+  uint16_t bg;
+  ui_label_t *const *labels;
+  int count;
+} ui_screen_t;
+
+typedef struct
+{
+  uint32_t screens;        // Full clears
+  uint32_t labels_drawn;
+  uint32_t labels_skipped; // Unchanged, nothing drawn
+  uint32_t pixels;         // Pixels written by labels and clears
+} ui_stats_t;
+
+void uiLabelInit(ui_label_t *label, int16_t x, int16_t y, uint8_t size, uint16_t fg, uint16_t bg);
+
+// Set the content; no-op (and no repaint) if it is the same as before
+void uiLabelPrintf(ui_label_t *label, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void uiLabelSetColor(ui_label_t *label, uint16_t fg);
+
+// Make `screen` the one shown; it is cleared and fully repainted if it was not already
+void uiScreenShow(ui_screen_t *screen);
+
+// Force a full repaint of the current screen at the next uiRender() (someone drew over it)
+void uiScreenInvalidate();
+
+ui_screen_t *uiCurrentScreen();
+
+// Repaint what changed on the current screen. True if it was cleared first, so
+// whatever the caller draws outside the widgets has to be drawn again.
+bool uiRender(TFT_eSPI &tft);
+
+void getUiStats(ui_stats_t *stats);
+void resetUiStats();
+
+#endif // _UI_WIDGETS_H_
@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+"""Generate include/board_bank.h, the flash-resident bank of mine layouts.
+
+The board pool falls back on this bank when the background producer has not
+caught up, so a reset never has to generate a board in loop(). Each layout
+is the row bitset of Minesweeper (row x is byte x, column y is bit y).
+
+    python scripts/gen_board_bank.py [--boards N] [--mines M] [--seed S]
+
+Rerun it after changing the board size or the mine count; board_pool.cpp
+only uses the bank when its mine count matches NUM_BOMBS.
+"""
+
+import argparse
+import os
+import random
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+WIDTH, HEIGHT = 8, 16
+
+
+def layout(rng, mines):
+    rows = [0] * HEIGHT
+    for tile in rng.sample(range(WIDTH * HEIGHT), mines):
+        rows[tile // WIDTH] |= 1 << (tile % WIDTH)
+    return rows
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--boards", type=int, default=32)
+    parser.add_argument("--mines", type=int, default=WIDTH * HEIGHT // 10, help="NUM_BOMBS of the firmware")
+    parser.add_argument("--seed", type=int, default=1, help="same seed, same header")
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    lines = [
+        "#ifndef _BOARD_BANK_H_",
+        "#define _BOARD_BANK_H_",
+        "",
+        "// Generated by scripts/gen_board_bank.py --boards %d --mines %d --seed %d, do not edit."
+        % (args.boards, args.mines, args.seed),
+        "// Included by board_pool.cpp only; const, so it stays in flash.",
+        "",
+        "#include <stdint.h>",
+        "",
+        "#define BOARD_BANK_SIZE %d" % args.boards,
+        "#define BOARD_BANK_MINES %d" % args.mines,
+        "",
+        "static const uint8_t boardBank[BOARD_BANK_SIZE][%d] = {" % HEIGHT,
+    ]
+    for _ in range(args.boards):
+        rows = layout(rng, args.mines)
+        lines.append("    {%s}," % ", ".join("0x%02X" % row for row in rows))
+    lines += ["};", "", "#endif // _BOARD_BANK_H_", ""]
+
+    path = os.path.join(ROOT, "include", "board_bank.h")
+    with open(path, "w") as out:
+        out.write("\n".join(lines))
+    print("%d boards -> %s" % (args.boards, path))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,7 @@
+# Link-time optimisation for the performance profiles: build_flags only reach
+# the compiler, the LTO code generation at link time needs -flto and the
+# optimisation level as well.
+Import("env")
+
+optimisation = [flag for flag in env.get("CCFLAGS", []) if str(flag).startswith("-O")]
+env.Append(LINKFLAGS=["-flto"] + optimisation[-1:])
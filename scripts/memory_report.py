@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+"""Build-time memory report: static RAM per source file and the deepest stack frames.
+
+Builds a firmware environment with -fstack-usage, then reads the ELF symbols
+(.bss and .data) grouped by the source file that defines them, and the
+per-function stack usage the compiler wrote next to each object. Prints a
+markdown report; the runtime side is the "memory" console command.
+
+    python scripts/memory_report.py [--env ENV] [--top N]
+    python scripts/memory_report.py --elf program --su-dir build/ --nm nm   # any existing build
+
+The budgets themselves are enforced by static_asserts (include/memory_budget.h),
+this report is for finding where the bytes went.
+"""
+
+import argparse
+import collections
+import glob
+import os
+import re
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+FIRMWARE = "az-delivery-devkit-v4"
+
+STATIC_TYPES = set("bBdD")  # nm: .bss and .data symbols, RAM that is taken at boot
+
+
+def pio(*args, env=None):
+    result = subprocess.run(["pio"] + list(args), cwd=ROOT, capture_output=True, text=True, env=env)
+    if result.returncode != 0:
+        sys.stderr.write(result.stdout + result.stderr)
+        raise SystemExit("pio %s failed" % " ".join(args))
+    return result.stdout
+
+
+def nm_tool():
+    packages = os.path.expanduser("~/.platformio/packages")
+    tools = glob.glob(os.path.join(packages, "toolchain-xtensa-esp32*", "bin", "xtensa-esp32-elf-nm"))
+    if not tools:
+        raise SystemExit("xtensa-esp32-elf-nm not found, build the firmware once with pio first")
+    return tools[0]
+
+
+def build(env_name):
+    env = dict(os.environ)
+    env["PLATFORMIO_BUILD_FLAGS"] = (env.get("PLATFORMIO_BUILD_FLAGS", "") + " -fstack-usage").strip()
+    pio("run", "-e", env_name, env=env)
+    build_dir = os.path.join(ROOT, ".pio", "build", env_name)
+    return os.path.join(build_dir, "firmware.elf"), os.path.join(build_dir, "src")
+
+
+def owner(location):
+    # "path/to/file.cpp:123" -> the project file, or the framework it came from
+    path = location.rsplit(":", 1)[0]
+    if not path:
+        return "(no debug info)"
+    relative = os.path.relpath(path, ROOT) if os.path.isabs(path) else path
+    if relative.startswith("src" + os.sep) or relative.startswith("include" + os.sep):
+        return relative
+    return "(framework) " + os.path.basename(path)
+
+
+def static_ram(elf, nm):
+    output = subprocess.run([nm, "-S", "-l", "--defined-only", elf], capture_output=True, text=True, check=True).stdout
+    files = collections.Counter()
+    largest = {}
+    for line in output.splitlines():
+        fields = line.split("\t")
+        parts = fields[0].split()
+        if len(parts) != 4 or parts[2] not in STATIC_TYPES:
+            continue
+        size, name = int(parts[1], 16), parts[3]
+        where = owner(fields[1]) if len(fields) > 1 else "(no debug info)"
+        files[where] += size
+        if size > largest.get(where, (0, ""))[0]:
+            largest[where] = (size, name)
+    return files, largest
+
+
+STACK_LINE = re.compile(r"^(.+?):(\d+):(\d+):(.+)\t(\d+)\t(\S+)")
+
+
+def stack_frames(su_dir):
+    frames = []
+    for path in glob.glob(os.path.join(su_dir, "**", "*.su"), recursive=True):
+        with open(path) as su:
+            for line in su:
+                match = STACK_LINE.match(line.rstrip("\n"))
+                if match:
+                    source = os.path.basename(match.group(1))
+                    frames.append((int(match.group(5)), source, match.group(4), match.group(6)))
+    return sorted(frames, reverse=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--env", default=FIRMWARE, help="PlatformIO environment to build")
+    parser.add_argument("--elf", help="use this ELF instead of building")
+    parser.add_argument("--su-dir", help="directory with the .su files of --elf")
+    parser.add_argument("--nm", help="nm of the ELF's toolchain (default: the ESP32 one)")
+    parser.add_argument("--top", type=int, default=15, help="rows per table")
+    args = parser.parse_args()
+
+    if args.elf:
+        elf, su_dir = args.elf, args.su_dir
+    else:
+        elf, su_dir = build(args.env)
+    nm = args.nm or nm_tool()
+
+    files, largest = static_ram(elf, nm)
+    print("### Static RAM by source file (%d bytes)\n" % sum(files.values()))
+    print("| file | bytes | largest symbol |")
+    print("|---|---:|---|")
+    for where, size in files.most_common(args.top):
+        print("| %s | %d | %s (%d) |" % (where, size, largest[where][1], largest[where][0]))
+    print()
+
+    if su_dir:
+        frames = stack_frames(su_dir)
+        print("### Deepest stack frames\n")
+        print("| bytes | file | function | kind |")
+        print("|---:|---|---|---|")
+        for size, source, function, kind in frames[: args.top]:
+            print("| %d | %s | %s | %s |" % (size, source, function, kind))
+        dynamic = [f for f in frames if f[3].startswith("dynamic")]
+        if dynamic:
+            print("\n%d functions with dynamic stack use: %s" % (len(dynamic), ", ".join(f[2] for f in dynamic[:8])))
+        print()
+
+
+if __name__ == "__main__":
+    main()
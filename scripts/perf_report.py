@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""Compare the performance profile with the default build.
+
+Builds both firmware environments and reports code size, IRAM and DRAM use
+from the ELF sections, then runs the host benchmark in both profiles and
+reports its timings. Prints a markdown table.
+
+    python scripts/perf_report.py [--games N] [--skip-firmware] [--skip-bench]
+"""
+
+import argparse
+import glob
+import os
+import re
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+FIRMWARE = ("az-delivery-devkit-v4", "az-delivery-devkit-v4-perf")
+BENCH = ("native_bench", "native_bench_perf")
+
+# ELF section -> report row
+SECTIONS = {
+    "code (flash)": (".flash.text",),
+    "rodata (flash)": (".flash.rodata",),
+    "IRAM": (".iram0.vectors", ".iram0.text"),
+    "DRAM": (".dram0.data", ".dram0.bss"),
+}
+
+BENCH_ROWS = ("shoot + hints (avg)", "shoot + hints (max)", "full rebuild (avg)")
+
+
+def pio(*args):
+    result = subprocess.run(["pio"] + list(args), cwd=ROOT, capture_output=True, text=True)
+    if result.returncode != 0:
+        sys.stderr.write(result.stdout + result.stderr)
+        raise SystemExit("pio %s failed" % " ".join(args))
+    return result.stdout
+
+
+def size_tool():
+    packages = os.path.expanduser("~/.platformio/packages")
+    tools = glob.glob(os.path.join(packages, "toolchain-xtensa-esp32*", "bin", "xtensa-esp32-elf-size"))
+    if not tools:
+        raise SystemExit("xtensa-esp32-elf-size not found, build the firmware once with pio first")
+    return tools[0]
+
+
+def firmware_sizes(env):
+    pio("run", "-e", env)
+    elf = os.path.join(ROOT, ".pio", "build", env, "firmware.elf")
+    output = subprocess.run([size_tool(), "-A", elf], capture_output=True, text=True, check=True).stdout
+    sections = {}
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0].startswith(".") and fields[1].isdigit():
+            sections[fields[0]] = int(fields[1])
+    return {row: sum(sections.get(name, 0) for name in names) for row, names in SECTIONS.items()}
+
+
+def bench_timings(env, games):
+    # Build with pio, run the program directly to pass the game count
+    pio("run", "-e", env)
+    program = os.path.join(ROOT, ".pio", "build", env, "program")
+    output = subprocess.run([program, str(games)], capture_output=True, text=True, check=True).stdout
+    timings = {}
+    for line in output.splitlines():
+        match = re.match(r"(.+?):\s+([\d.]+) us", line)
+        if match and match.group(1) in BENCH_ROWS:
+            timings[match.group(1)] = float(match.group(2))
+    return timings
+
+
+def delta(base, perf):
+    if not base:
+        return "-"
+    return "%+.1f%%" % ((perf - base) * 100.0 / base)
+
+
+def table(title, unit, rows, base, perf, fmt):
+    print("### %s\n" % title)
+    print("| %s | default | perf | change |" % unit)
+    print("|---|---:|---:|---:|")
+    for row in rows:
+        b, p = base.get(row, 0), perf.get(row, 0)
+        print("| %s | %s | %s | %s |" % (row, fmt % b, fmt % p, delta(b, p)))
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--games", type=int, default=20000, help="games played by the benchmark")
+    parser.add_argument("--skip-firmware", action="store_true", help="no ESP32 toolchain available")
+    parser.add_argument("--skip-bench", action="store_true")
+    args = parser.parse_args()
+
+    if not args.skip_firmware:
+        base, perf = (firmware_sizes(env) for env in FIRMWARE)
+        table("Firmware size", "bytes", SECTIONS, base, perf, "%d")
+
+    if not args.skip_bench:
+        base, perf = (bench_timings(env, args.games) for env in BENCH)
+        table("Host benchmark (%d games)" % args.games, "us", BENCH_ROWS, base, perf, "%.2f")
+
+
+if __name__ == "__main__":
+    main()
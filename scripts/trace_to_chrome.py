@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+"""Convert a serial "trace dump" into Chrome / Perfetto trace JSON.
+
+Reads a serial log (a file, or stdin), takes the last block between the
+"trace begin" and "trace end" lines printed by the firmware, and writes JSON
+that chrome://tracing and ui.perfetto.dev open directly. Other log lines
+around the block are ignored.
+
+    pio device monitor | tee serial.log     # then type: trace dump
+    python scripts/trace_to_chrome.py serial.log -o trace.json
+
+Begin/end pairs become complete events, the same way the host builds write
+them (traceWriteChrome() in src/trace.cpp).
+"""
+
+import argparse
+import json
+import re
+import sys
+
+RECORD = re.compile(r"^(\d+) ([BE]) (\d+) (\w+)$")
+
+
+def last_dump(lines):
+    block, current = None, None
+    for line in lines:
+        line = line.strip()
+        if line.startswith("trace begin"):
+            current = []
+        elif line == "trace end" and current is not None:
+            block, current = current, None
+        elif current is not None:
+            match = RECORD.match(line)
+            if match:
+                current.append((int(match.group(1)), match.group(2), int(match.group(3)), match.group(4)))
+    if block is None:
+        raise SystemExit("no complete trace dump found (looking for 'trace begin' ... 'trace end')")
+    return block
+
+
+def chrome_events(records, thread_names):
+    events, open_spans = [], {}
+    for at, phase, tid, name in records:
+        stack = open_spans.setdefault(tid, [])
+        if phase == "B":
+            stack.append((name, at))
+            continue
+        # Unwind to the matching begin; it may have been overwritten in the ring
+        for level in range(len(stack) - 1, -1, -1):
+            if stack[level][0] == name:
+                start = stack[level][1]
+                del stack[level:]
+                events.append({"name": name, "ph": "X", "pid": 1, "tid": tid, "ts": start, "dur": at - start})
+                break
+    for tid in sorted(open_spans):
+        events.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": tid,
+                       "args": {"name": thread_names % tid}})
+    return events
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", nargs="?", help="serial log, stdin if omitted")
+    parser.add_argument("-o", "--output", help="JSON file, stdout if omitted")
+    parser.add_argument("--thread-names", default="core %d", help="track name format, %%d is the tid")
+    args = parser.parse_args()
+
+    if args.log:
+        with open(args.log, errors="replace") as log:
+            records = last_dump(log)
+    else:
+        records = last_dump(sys.stdin)
+
+    trace = {"displayTimeUnit": "ms", "traceEvents": chrome_events(records, args.thread_names)}
+    if args.output:
+        with open(args.output, "w") as out:
+            json.dump(trace, out, indent=1)
+        sys.stderr.write("%d events -> %s\n" % (len(trace["traceEvents"]), args.output))
+    else:
+        json.dump(trace, sys.stdout, indent=1)
+
+
+if __name__ == "__main__":
+    main()
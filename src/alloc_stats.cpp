@@ -0,0 +1,79 @@
+#include "alloc_stats.h"
+
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+static std::atomic<uint32_t> allocations(0);
+static std::atomic<uint32_t> frees(0);
+static std::atomic<uint32_t> baseline(0);
+
+static void *counted_alloc(size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return malloc(size ? size : 1);
+}
+
+static void counted_free(void *ptr)
+{
+  if (ptr)
+  {
+    frees.fetch_add(1, std::memory_order_relaxed);
+    free(ptr);
+  }
+}
+
+void *operator new(size_t size)
+{
+  void *ptr = counted_alloc(size);
+  if (!ptr)
+    abort(); // Out of memory, same outcome as the default handler without exceptions
+  return ptr;
+}
+
+void *operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  return counted_alloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+  return counted_alloc(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+  counted_free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+  counted_free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+  counted_free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+  counted_free(ptr);
+}
+
+void getAllocStats(alloc_stats_t *stats)
+{
+  stats->allocations = allocations.load(std::memory_order_relaxed);
+  stats->frees = frees.load(std::memory_order_relaxed);
+  stats->allocations_since_baseline = stats->allocations - baseline.load(std::memory_order_relaxed);
+}
+
+void markAllocBaseline()
+{
+  baseline.store(allocations.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
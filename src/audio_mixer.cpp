@@ -0,0 +1,213 @@
+#include "audio_mixer.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+typedef struct
+{
+  const audio_melody_t *melody; // NULL when free
+  uint16_t note;
+  uint32_t position; // Sample within the note
+  uint32_t phase;
+  uint32_t started;  // Play sequence number, the lowest is the oldest
+} audio_voice_t;
+
+static int8_t wavetables[AUDIO_WAVES][AUDIO_WAVE_SIZE];
+static_assert(sizeof(wavetables) == AUDIO_MIXER_STATIC_BYTES, "memory_report.cpp counts the wavetables by AUDIO_MIXER_STATIC_BYTES");
+
+// Owned by the mixer, only audioMix() touches them
+static audio_voice_t voices[AUDIO_VOICES];
+
+// Handed over from audioPlay()
+static const audio_melody_t *pending[AUDIO_VOICES];
+static int pendingCount = 0;
+static uint32_t playSequence = 0;
+static volatile int busyVoices = 0;
+static int32_t limiterGain = AUDIO_UNITY_GAIN;
+static audio_stats_t audioStats;
+portMUX_TYPE audioMux = portMUX_INITIALIZER_UNLOCKED;
+
+void audioMixerBegin()
+{
+  for (int i = 0; i < AUDIO_WAVE_SIZE; i++)
+  {
+    wavetables[AUDIO_WAVE_SQUARE][i] = i < AUDIO_WAVE_SIZE / 2 ? 127 : -127;
+    int rise = i < AUDIO_WAVE_SIZE / 2 ? i : AUDIO_WAVE_SIZE - i; // 0..128..0
+    wavetables[AUDIO_WAVE_TRIANGLE][i] = rise * 254 / (AUDIO_WAVE_SIZE / 2) - 127;
+    wavetables[AUDIO_WAVE_SINE][i] = (int8_t)lroundf(127.0f * sinf(2.0f * (float)M_PI * i / AUDIO_WAVE_SIZE));
+    wavetables[AUDIO_WAVE_SAW][i] = i * 254 / (AUDIO_WAVE_SIZE - 1) - 127;
+  }
+}
+
+void audioPlay(const audio_melody_t *melody)
+{
+  portENTER_CRITICAL(&audioMux);
+  if (pendingCount == AUDIO_VOICES)
+  {
+    // More starts than voices within one block, the oldest start loses
+    memmove(&pending[0], &pending[1], sizeof(pending[0]) * (AUDIO_VOICES - 1));
+    pendingCount--;
+  }
+  pending[pendingCount++] = melody;
+  audioStats.plays++;
+  portEXIT_CRITICAL(&audioMux);
+}
+
+bool audioActive()
+{
+  portENTER_CRITICAL(&audioMux);
+  bool active = pendingCount > 0 || busyVoices > 0;
+  portEXIT_CRITICAL(&audioMux);
+  return active;
+}
+
+static void start_voice(const audio_melody_t *melody)
+{
+  audio_voice_t *voice = NULL;
+  for (int i = 0; i < AUDIO_VOICES && voice == NULL; i++)
+  {
+    if (voices[i].melody == melody)
+    {
+      voice = &voices[i];
+      audioStats.restarted++;
+    }
+  }
+  for (int i = 0; i < AUDIO_VOICES && voice == NULL; i++)
+  {
+    if (voices[i].melody == NULL)
+      voice = &voices[i];
+  }
+  if (voice == NULL)
+  {
+    voice = &voices[0];
+    for (int i = 1; i < AUDIO_VOICES; i++)
+    {
+      if (voices[i].started < voice->started)
+        voice = &voices[i];
+    }
+    audioStats.stolen++;
+  }
+  *voice = {melody, 0, 0, 0, playSequence++};
+}
+
+// Add one voice into the block; false once its melody is over
+static bool mix_voice(audio_voice_t *voice, int32_t *mix, int frames)
+{
+  const audio_melody_t *melody = voice->melody;
+  const int8_t *wave = wavetables[melody->wave];
+  int frame = 0;
+  while (frame < frames)
+  {
+    if (voice->note == melody->count)
+      return false;
+    const audio_note_t *note = &melody->notes[voice->note];
+
+    // Run to the end of the note or of the block, whichever comes first
+    int run = note->total_samples - voice->position;
+    if (run > frames - frame)
+      run = frames - frame;
+    for (int i = 0; i < run; i++, frame++)
+    {
+      uint32_t at = voice->position + i;
+      if (note->step == 0 || at >= note->on_samples)
+        continue;
+      // Linear ramps at both ends of the sounding part
+      uint32_t edge = at < note->on_samples - at ? at : note->on_samples - at;
+      int32_t level = edge < AUDIO_RAMP_SAMPLES ? melody->volume * edge / AUDIO_RAMP_SAMPLES : melody->volume;
+      mix[frame] += wave[voice->phase >> 24] * level;
+      voice->phase += note->step;
+    }
+    voice->position += run;
+    if (voice->position == note->total_samples)
+    {
+      voice->note++;
+      voice->position = 0;
+      voice->phase = 0;
+    }
+  }
+  return voice->note < melody->count;
+}
+
+void audioMix(int16_t *out, int frames)
+{
+  int64_t started = esp_timer_get_time();
+
+  const audio_melody_t *starting[AUDIO_VOICES];
+  portENTER_CRITICAL(&audioMux);
+  int count = pendingCount;
+  memcpy(starting, pending, sizeof(pending[0]) * count);
+  pendingCount = 0;
+  portEXIT_CRITICAL(&audioMux);
+  for (int i = 0; i < count; i++)
+    start_voice(starting[i]);
+
+  int32_t mix[AUDIO_BLOCK_FRAMES];
+  int busy = 0;
+  for (int done = 0; done < frames; done += AUDIO_BLOCK_FRAMES)
+  {
+    int block = frames - done < AUDIO_BLOCK_FRAMES ? frames - done : AUDIO_BLOCK_FRAMES;
+    memset(mix, 0, sizeof(mix[0]) * block);
+    busy = 0;
+    for (int v = 0; v < AUDIO_VOICES; v++)
+    {
+      if (voices[v].melody == NULL)
+        continue;
+      if (mix_voice(&voices[v], mix, block))
+        busy++;
+      else
+        voices[v].melody = NULL;
+    }
+
+    // Limiter: a block that would clip is turned down at once, then the gain
+    // recovers over a few blocks instead of jumping back
+    int32_t peak = 0;
+    for (int i = 0; i < block; i++)
+    {
+      int32_t level = mix[i] < 0 ? -mix[i] : mix[i];
+      if (level > peak)
+        peak = level;
+    }
+    int32_t target = limiterGain + AUDIO_UNITY_GAIN / 8;
+    if (target > AUDIO_UNITY_GAIN)
+      target = AUDIO_UNITY_GAIN;
+    if (peak > 0 && (int64_t)peak * target / AUDIO_UNITY_GAIN > INT16_MAX)
+    {
+      target = (int64_t)INT16_MAX * AUDIO_UNITY_GAIN / peak;
+      audioStats.limited++;
+    }
+    for (int i = 0; i < block; i++)
+    {
+      // Down takes effect on the first sample, wherever the peak sits; up is ramped
+      int32_t gain = target < limiterGain ? target : limiterGain + (target - limiterGain) * (i + 1) / block;
+      int32_t sample = (int64_t)mix[i] * gain / AUDIO_UNITY_GAIN;
+      out[done + i] = sample > INT16_MAX ? INT16_MAX : sample < INT16_MIN ? INT16_MIN : sample;
+    }
+    limiterGain = target;
+  }
+
+  uint32_t spent = esp_timer_get_time() - started;
+  portENTER_CRITICAL(&audioMux);
+  busyVoices = busy;
+  audioStats.blocks++;
+  audioStats.mix_total_us += spent;
+  if (spent > audioStats.mix_max_us)
+    audioStats.mix_max_us = spent;
+  portEXIT_CRITICAL(&audioMux);
+}
+
+void getAudioStats(audio_stats_t *stats)
+{
+  portENTER_CRITICAL(&audioMux);
+  *stats = audioStats;
+  portEXIT_CRITICAL(&audioMux);
+}
+
+void resetAudioStats()
+{
+  portENTER_CRITICAL(&audioMux);
+  memset(&audioStats, 0, sizeof(audioStats));
+  portEXIT_CRITICAL(&audioMux);
+}
@@ -0,0 +1,83 @@
+#include "audio_output.h"
+
+#include "freertos/FreeRTOS.h"
+#include "driver/i2s.h"
+#include "memory_budget.h"
+#include "trace.h"
+
+#define AUDIO_I2S_PORT I2S_NUM_0 // The only port wired to the built-in DAC
+
+static TaskHandle_t outputTask = NULL;
+
+// audioMix() sums a block in 32 bits on this task's stack; the output buffers are static
+static_assert(AUDIO_BLOCK_FRAMES * sizeof(int32_t) <= AUDIO_TASK_STACK / 2,
+              "AUDIO_BLOCK_FRAMES too large for the mix buffer on the audio task's stack");
+
+// The built-in DAC takes the top byte of each 16-bit slot, unsigned, and
+// I2S sends both channels; channel 1 (GPIO25) is the right one
+static void to_dac_frames(const int16_t *mix, uint16_t *frames, int count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    uint16_t sample = (uint16_t)(mix[i] + 32768);
+    frames[2 * i] = sample;
+    frames[2 * i + 1] = sample;
+  }
+}
+
+static void output_task(void *parameter)
+{
+  static int16_t mix[AUDIO_BLOCK_FRAMES];
+  static uint16_t frames[AUDIO_BLOCK_FRAMES * 2];
+  static_assert(sizeof(mix) + sizeof(frames) == AUDIO_OUTPUT_STATIC_BYTES,
+                "memory_report.cpp counts the output buffers by AUDIO_OUTPUT_STATIC_BYTES");
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // Until something plays
+    i2s_start(AUDIO_I2S_PORT);
+    while (audioActive())
+    {
+      traceBegin(TRACE_AUDIO);
+      audioMix(mix, AUDIO_BLOCK_FRAMES);
+      to_dac_frames(mix, frames, AUDIO_BLOCK_FRAMES);
+      traceEnd(TRACE_AUDIO);
+      size_t written;
+      // Blocks until the DMA engine frees a buffer, the pacing of this loop
+      i2s_write(AUDIO_I2S_PORT, frames, sizeof(frames), &written, portMAX_DELAY);
+    }
+    // Let the queued blocks drain before stopping the clock
+    vTaskDelay(pdMS_TO_TICKS(AUDIO_DMA_BUFFERS * AUDIO_BLOCK_FRAMES * 1000 / AUDIO_SAMPLE_RATE + 1));
+    i2s_zero_dma_buffer(AUDIO_I2S_PORT);
+    i2s_stop(AUDIO_I2S_PORT);
+  }
+}
+
+void audioOutputBegin()
+{
+  audioMixerBegin();
+
+  i2s_config_t config = {};
+  config.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX | I2S_MODE_DAC_BUILT_IN);
+  config.sample_rate = AUDIO_SAMPLE_RATE;
+  config.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+  config.channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT;
+  config.communication_format = I2S_COMM_FORMAT_STAND_MSB;
+  config.intr_alloc_flags = 0;
+  config.dma_buf_count = AUDIO_DMA_BUFFERS;
+  config.dma_buf_len = AUDIO_BLOCK_FRAMES;
+  config.use_apll = false;
+  config.tx_desc_auto_clear = true; // An underrun plays silence, not the last buffer again
+  i2s_driver_install(AUDIO_I2S_PORT, &config, 0, NULL);
+  i2s_set_pin(AUDIO_I2S_PORT, NULL); // NULL routes the output to the internal DAC
+  i2s_set_dac_mode(I2S_DAC_CHANNEL_RIGHT_EN);
+  i2s_zero_dma_buffer(AUDIO_I2S_PORT);
+  i2s_stop(AUDIO_I2S_PORT);
+
+  xTaskCreate(output_task, "audio", AUDIO_TASK_STACK, NULL, AUDIO_TASK_PRIORITY, &outputTask);
+}
+
+void audioOutputPlay(const audio_melody_t *melody)
+{
+  audioPlay(melody);
+  xTaskNotifyGive(outputTask);
+}
@@ -0,0 +1,251 @@
+#include "ble_transport.h"
+
+#include <Arduino.h>
+
+#include <BLEDevice.h>
+#include <BLEServer.h>
+#include <BLE2902.h>
+
+#include "trace.h"
+
+// Check if Bluetooth Serial is properly supported
+#if !defined(CONFIG_BT_ENABLED) || !defined(CONFIG_BLUEDROID_ENABLED)
+#error Bluetooth is not enabled! Please run `make menuconfig` and enable Bluetooth Classic.
+#endif
+
+#define SERVICE_UUID "4fafc201-1fb5-459e-8fcc-c5c9c331914b"
+#define CHARACTERISTIC_UUID "beb5483e-36e1-4688-b7f5-ea07361b26a8"
+#define STATE_CHARACTERISTIC_UUID "beb5483f-36e1-4688-b7f5-ea07361b26a8" // Read-only board snapshot
+#define BLE_ADD_CHAR_TIMEOUT_MS 500
+
+static BLEServer *pServer = NULL;
+static BLECharacteristic *pCharacteristic = NULL;
+
+static uint16_t stateHandle = 0; // Attribute of the state characteristic, once the stack added it
+static ble_state_read_t stateReads[BLE_MAX_CONNECTIONS];
+static_assert(sizeof(stateReads) == BLE_STATE_STATIC_BYTES, "memory_report.cpp counts the copies by BLE_STATE_STATIC_BYTES");
+static_assert(BOARD_STATE_MAX_SIZE <= ESP_GATT_MAX_ATTR_LEN, "The snapshot must fit in one attribute");
+
+static const transport_events_t *bleEvents = NULL;
+
+#ifndef BLE_LOG_WRITES
+#define BLE_LOG_WRITES 0 // Echo every write to Serial; at 9600 baud that costs the BLE task tens of ms per packet
+#endif
+
+static void log_write(esp_ble_gatts_cb_param_t *param, const uint8_t *value, size_t length)
+{
+#if BLE_LOG_WRITES
+  Serial.print("Received Value: ");
+  Serial.write(value, length);
+  Serial.printf(" From MAC: %02X:%02X:%02X:%02X:%02X:%02X\n",
+                param->write.bda[0], param->write.bda[1],
+                param->write.bda[2], param->write.bda[3],
+                param->write.bda[4], param->write.bda[5]);
+#else
+  (void)param;
+  (void)value;
+  (void)length;
+#endif
+}
+
+class MyServerCallbacks : public BLEServerCallbacks
+{
+  void onConnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param)
+  {
+    TraceScope span(TRACE_BLE_CONNECT);
+    BLEDevice::startAdvertising();
+    // Get mac address of the connected device
+    esp_bd_addr_t *addr = (esp_bd_addr_t *)param->connect.remote_bda;
+    char mac[18];
+    snprintf(mac, sizeof(mac), "%02X:%02X:%02X:%02X:%02X:%02X",
+             (*addr)[0], (*addr)[1], (*addr)[2],
+             (*addr)[3], (*addr)[4], (*addr)[5]);
+    Serial.print("Connected to device with MAC: ");
+    Serial.println(mac);
+
+    bleEvents->on_connect(*addr, param->connect.conn_id);
+  };
+
+  void onDisconnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param)
+  {
+    TraceScope span(TRACE_BLE_DISCONNECT);
+    Serial.print("Device disconnected: ");
+    esp_bd_addr_t *addr = (esp_bd_addr_t *)param->connect.remote_bda;
+    char mac[18];
+    snprintf(mac, sizeof(mac), "%02X:%02X:%02X:%02X:%02X:%02X",
+             (*addr)[0], (*addr)[1], (*addr)[2],
+             (*addr)[3], (*addr)[4], (*addr)[5]);
+    Serial.println(mac);
+
+    bleEvents->on_disconnect(*addr, param->disconnect.conn_id);
+  }
+
+  void onWrite(BLECharacteristic *pCharacteristic, esp_ble_gatts_cb_param_t *param)
+  {
+    TraceScope span(TRACE_BLE_WRITE);
+    // Read the written bytes in place, getValue() would copy them into a new std::string
+    uint8_t *value = pCharacteristic->getData();
+    size_t length = pCharacteristic->getLength();
+    if (length > 0)
+    {
+      log_write(param, value, length);
+      // Queue it and send back the received value (or a NACK)
+      bleEvents->on_write(param->write.conn_id, param->write.bda, value, length);
+    }
+  }
+};
+
+class MyCallbacks : public BLECharacteristicCallbacks
+{
+  void onWrite(BLECharacteristic *pCharacteristic, esp_ble_gatts_cb_param_t *param)
+  {
+    TraceScope span(TRACE_BLE_WRITE);
+    // Read the written bytes in place, getValue() would copy them into a new std::string
+    uint8_t *value = pCharacteristic->getData();
+    size_t length = pCharacteristic->getLength();
+    if (length > 0)
+    {
+      log_write(param, value, length);
+      // Queue it and send back the received value (or a NACK)
+      bleEvents->on_write(param->write.conn_id, param->write.bda, value, length);
+    }
+  }
+};
+
+// The library answers long reads of its characteristics from one value and
+// one read offset shared by every client, so the state characteristic is an
+// attribute of its own, answered here from the reader's copy. Only the first
+// request of a read (offset 0) takes a new copy, and only if the stamp says
+// the snapshot changed since this connection's last one.
+static void answer_state_read(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
+{
+  uint16_t conn_id = param->read.conn_id;
+  esp_gatt_rsp_t response;
+  memset(&response, 0, sizeof(response));
+  response.attr_value.handle = param->read.handle;
+  response.attr_value.offset = param->read.offset;
+  esp_gatt_status_t status = ESP_GATT_OK;
+
+  if (conn_id >= BLE_CONN_ID_BASE + BLE_MAX_CONNECTIONS)
+  {
+    status = ESP_GATT_INSUF_RESOURCE;
+  }
+  else
+  {
+    ble_state_read_t *copy = &stateReads[conn_id - BLE_CONN_ID_BASE];
+    if (!param->read.is_long)
+    {
+      const uint8_t *data = NULL;
+      uint32_t stamp = 0;
+      size_t length = bleEvents->on_read != NULL ? bleEvents->on_read(conn_id, &data, &stamp) : 0;
+      if (length == 0)
+      {
+        copy->stamp = 0; // Not seated, an empty value
+        copy->length = 0;
+      }
+      else if (stamp != copy->stamp)
+      {
+        memcpy(copy->data, data, length);
+        copy->length = length;
+        copy->stamp = stamp;
+      }
+    }
+
+    if (param->read.offset > copy->length)
+    {
+      status = ESP_GATT_INVALID_OFFSET;
+    }
+    else
+    {
+      uint16_t mtu = pServer->getPeerMTU(conn_id);
+      uint16_t room = mtu > ESP_GATT_DEF_BLE_MTU_SIZE ? mtu - 1 : ESP_GATT_DEF_BLE_MTU_SIZE - 1;
+      uint16_t chunk = copy->length - param->read.offset;
+      response.attr_value.len = chunk < room ? chunk : room;
+      memcpy(response.attr_value.value, &copy->data[param->read.offset], response.attr_value.len);
+    }
+  }
+
+  if (param->read.need_rsp)
+    esp_ble_gatts_send_response(gatts_if, conn_id, param->read.trans_id, status, &response);
+}
+
+// Sees every GATT server event after the library did; only the state attribute is handled here
+static void state_gatts_event(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
+{
+  if (event == ESP_GATTS_ADD_CHAR_EVT && param->add_char.status == ESP_GATT_OK &&
+      BLEUUID(param->add_char.char_uuid).equals(BLEUUID(STATE_CHARACTERISTIC_UUID)))
+  {
+    stateHandle = param->add_char.attr_handle;
+  }
+  else if (event == ESP_GATTS_READ_EVT && stateHandle != 0 && param->read.handle == stateHandle)
+  {
+    answer_state_read(gatts_if, param);
+  }
+}
+
+// Notify a single connection instead of every subscriber of the characteristic
+static void ble_notify(uint16_t conn_id, const uint8_t *data, size_t length)
+{
+  esp_ble_gatts_send_indicate(pServer->getGattsIf(), conn_id, pCharacteristic->getHandle(),
+                              length, (uint8_t *)data, false);
+}
+
+static bool ble_begin(const char *device_name, const transport_events_t *events)
+{
+  bleEvents = events;
+
+  // Create the BLE Device
+  BLEDevice::init(device_name);
+
+  // Create the BLE Server
+  pServer = BLEDevice::createServer();
+  // Callbacks and descriptor live as long as the server, no need for the heap
+  static MyServerCallbacks serverCallbacks;
+  static MyCallbacks characteristicCallbacks;
+  static BLE2902 clientConfiguration;
+  pServer->setCallbacks(&serverCallbacks);
+
+  // Create the BLE Service
+  BLEService *pService = pServer->createService(SERVICE_UUID);
+
+  // Create a BLE Characteristic
+  pCharacteristic = pService->createCharacteristic(
+      CHARACTERISTIC_UUID,
+      BLECharacteristic::PROPERTY_READ |
+          BLECharacteristic::PROPERTY_WRITE |
+          BLECharacteristic::PROPERTY_NOTIFY |
+          BLECharacteristic::PROPERTY_INDICATE);
+
+  // https://www.bluetooth.com/specifications/gatt/viewer?attributeXmlFile=org.bluetooth.descriptor.gatt.client_characteristic_configuration.xml
+  // Create a BLE Descriptor
+  pCharacteristic->addDescriptor(&clientConfiguration);
+
+  // Add the callback for characteristic writes
+  pCharacteristic->setCallbacks(&characteristicCallbacks);
+
+  // Board snapshot for clients that connect mid-game, see board_state.h. Added
+  // straight to the stack, answered by the app, before the library creates its
+  // own characteristics at start(); the library only logs it as unknown.
+  BLEDevice::setCustomGattsHandler(state_gatts_event);
+  esp_attr_control_t control = {ESP_GATT_RSP_BY_APP};
+  BLEUUID stateUuid(STATE_CHARACTERISTIC_UUID);
+  esp_ble_gatts_add_char(pService->getHandle(), stateUuid.getNative(), ESP_GATT_PERM_READ,
+                         ESP_GATT_CHAR_PROP_BIT_READ, NULL, &control);
+  for (int waited = 0; stateHandle == 0 && waited < BLE_ADD_CHAR_TIMEOUT_MS; waited++)
+  {
+    delay(1); // The add event comes back through the BTC task
+  }
+
+  // Start the service
+  pService->start();
+
+  // Start advertising
+  BLEAdvertising *pAdvertising = BLEDevice::getAdvertising();
+  pAdvertising->addServiceUUID(SERVICE_UUID);
+  pAdvertising->setScanResponse(true);
+  pAdvertising->setMinPreferred(0x0); // set value to 0x00 to not advertise this parameter
+  BLEDevice::startAdvertising();
+  return true;
+}
+
+const transport_t bleTransport = {"ble", ble_begin, ble_notify, NULL};
@@ -0,0 +1,131 @@
+#include "board_pool.h"
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "board_bank.h"
+#include "minesweeper.h"
+
+#if BOARD_BANK_MINES == NUM_BOMBS && BOARD_BANK_SIZE > 0
+#define BOARD_BANK_USABLE 1 // Regenerate the bank after changing NUM_BOMBS
+#else
+#define BOARD_BANK_USABLE 0
+#endif
+
+static board_layout_t pool[BOARD_POOL_SIZE];
+static int poolCount = 0;
+static bool poolStarted = false;
+static board_pool_stats_t poolStats;
+static_assert(sizeof(pool) == BOARD_POOL_STATIC_BYTES, "memory_report.cpp counts the pool by BOARD_POOL_STATIC_BYTES");
+portMUX_TYPE boardPoolMux = portMUX_INITIALIZER_UNLOCKED;
+
+#ifdef ESP_PLATFORM
+static TaskHandle_t producerHandle = NULL;
+
+static void producer_task(void *parameter)
+{
+  for (;;)
+  {
+    // A notification may arrive mid-refill, so room is checked before every layout, not after
+    while (true)
+    {
+      portENTER_CRITICAL(&boardPoolMux);
+      bool room = poolCount < BOARD_POOL_SIZE;
+      portEXIT_CRITICAL(&boardPoolMux);
+      if (!room)
+        break;
+
+      board_layout_t layout;
+      int64_t started = esp_timer_get_time();
+      Minesweeper::generate_mines(layout.mines);
+      uint32_t spent = esp_timer_get_time() - started;
+
+      // Only this task adds layouts, so the room seen above is still there
+      portENTER_CRITICAL(&boardPoolMux);
+      if (poolCount < BOARD_POOL_SIZE)
+        pool[poolCount++] = layout;
+      poolStats.generated++;
+      if (spent > poolStats.generate_max_us)
+        poolStats.generate_max_us = spent;
+      portEXIT_CRITICAL(&boardPoolMux);
+    }
+
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // Until boardPoolTake() makes room
+  }
+}
+
+void boardPoolBegin()
+{
+  if (poolStarted)
+    return;
+  poolStarted = true;
+  xTaskCreate(producer_task, "boards", BOARD_POOL_STACK, NULL, tskIDLE_PRIORITY, &producerHandle);
+}
+#endif
+
+#if BOARD_BANK_USABLE
+// Flips keep the mine count and the shape of the board, so every bank entry gives four layouts
+static void take_from_bank(board_layout_t *layout)
+{
+  uint32_t pick = esp_random();
+  const uint8_t *rows = boardBank[(pick >> 2) % BOARD_BANK_SIZE];
+  for (int row = 0; row < HEIGHT; row++)
+  {
+    uint8_t bits = rows[(pick & 1) ? HEIGHT - 1 - row : row];
+    if (pick & 2)
+    {
+      // Mirror the columns of an 8-wide row
+      bits = (bits & 0xF0) >> 4 | (bits & 0x0F) << 4;
+      bits = (bits & 0xCC) >> 2 | (bits & 0x33) << 2;
+      bits = (bits & 0xAA) >> 1 | (bits & 0x55) << 1;
+    }
+    layout->mines[row] = bits;
+  }
+}
+#endif
+
+bool boardPoolTake(board_layout_t *layout)
+{
+  portENTER_CRITICAL(&boardPoolMux);
+  bool ready = poolCount > 0;
+  if (ready)
+  {
+    *layout = pool[--poolCount];
+    poolStats.from_pool++;
+  }
+  portEXIT_CRITICAL(&boardPoolMux);
+
+  if (ready)
+  {
+#ifdef ESP_PLATFORM
+    xTaskNotifyGive(producerHandle);
+#endif
+    return true;
+  }
+
+#if BOARD_BANK_USABLE
+  if (poolStarted)
+  {
+    take_from_bank(layout);
+    portENTER_CRITICAL(&boardPoolMux);
+    poolStats.from_bank++;
+    portEXIT_CRITICAL(&boardPoolMux);
+    return true;
+  }
+#endif
+
+  portENTER_CRITICAL(&boardPoolMux);
+  poolStats.missed++;
+  portEXIT_CRITICAL(&boardPoolMux);
+  return false;
+}
+
+void getBoardPoolStats(board_pool_stats_t *stats)
+{
+  portENTER_CRITICAL(&boardPoolMux);
+  *stats = poolStats;
+  stats->ready = poolCount;
+  portEXIT_CRITICAL(&boardPoolMux);
+}
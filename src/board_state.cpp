@@ -0,0 +1,111 @@
+#include "board_state.h"
+
+#include <string.h>
+
+#include "esp_timer.h"
+
+#define BOARD_STATE_ATTEMPTS 3 // Copies tried while loop() keeps moving the game
+
+static_assert(BOARD_STATE_MAX_SIZE <= 255, "board_state_cache_t keeps the length in a byte");
+
+static board_state_cache_t stateCache[MAX_SESSIONS];
+static_assert(sizeof(stateCache) == BOARD_STATE_STATIC_BYTES, "memory_report.cpp counts the cache by BOARD_STATE_STATIC_BYTES");
+static board_state_stats_t stateStats;
+
+static uint32_t encoded_version(const uint8_t *data)
+{
+  return data[1] | data[2] << 8 | data[3] << 16 | (uint32_t)data[4] << 24;
+}
+
+size_t boardStateEncode(session_t *session, uint8_t *out)
+{
+  Minesweeper &game = session->game;
+  uint32_t version = game.state_version();
+  const uint8_t *counts = game.get_neighbour_counts();
+
+  out[0] = BOARD_STATE_FORMAT;
+  out[1] = version;
+  out[2] = version >> 8;
+  out[3] = version >> 16;
+  out[4] = version >> 24;
+  out[5] = (game.is_game_over() ? BOARD_STATE_LOST : 0) | (game.won() ? BOARD_STATE_WON : 0) |
+           (game.is_realtime() ? BOARD_STATE_REALTIME : 0);
+  out[6] = game.get_player_turn();
+  out[7] = game.get_position_of(0);
+  out[8] = game.get_position_of(1);
+  memcpy(&out[BOARD_STATE_HEADER], game.get_revealed_rows(), HEIGHT);
+  memcpy(&out[BOARD_STATE_HEADER + HEIGHT], game.get_flag_rows(0), HEIGHT);
+  memcpy(&out[BOARD_STATE_HEADER + 2 * HEIGHT], game.get_flag_rows(1), HEIGHT);
+
+  // Counts of the revealed tiles only, two per byte. They follow the rows
+  // copied above, so the count byte and the nibbles always match the bitset.
+  const uint8_t *revealed = &out[BOARD_STATE_HEADER];
+  uint8_t *nibbles = &out[BOARD_STATE_HEADER + 3 * HEIGHT];
+  int shown = 0;
+  for (int row = 0; row < HEIGHT; row++)
+  {
+    for (uint8_t bits = revealed[row]; bits != 0; bits &= bits - 1)
+    {
+      uint8_t position = row * WIDTH + __builtin_ctz(bits);
+      uint8_t value = game.is_bomb(position) ? BOARD_STATE_MINE : counts[position];
+      if (shown % 2 == 0)
+        nibbles[shown / 2] = value;
+      else
+        nibbles[shown / 2] |= value << 4;
+      shown++;
+    }
+  }
+  out[9] = shown;
+  return BOARD_STATE_HEADER + 3 * HEIGHT + (shown + 1) / 2;
+}
+
+size_t boardStateRead(session_t *session, const uint8_t **data, uint32_t *stamp)
+{
+  board_state_cache_t *cache = &stateCache[sessionIndex(session)];
+  stateStats.reads++;
+
+  // Odd while loop() is changing the game, so never equal to a cached version then
+  if (!cache->valid || cache->version != session->game.state_version())
+  {
+    int64_t started = esp_timer_get_time();
+    uint8_t copy[BOARD_STATE_MAX_SIZE];
+    size_t length = 0;
+    bool consistent = false;
+    for (int attempt = 0; attempt < BOARD_STATE_ATTEMPTS && !consistent; attempt++)
+    {
+      // The version is taken first inside the encoding, the seqlock says whether the copy is whole
+      length = boardStateEncode(session, copy);
+      consistent = !session->game.read_retry(encoded_version(copy));
+      if (!consistent)
+        stateStats.retries++;
+    }
+    // A torn copy is never published. Still moving after every attempt: keep
+    // serving the last whole copy, or nothing before the first one; the next
+    // read tries again.
+    if (consistent)
+    {
+      memcpy(cache->data, copy, length);
+      cache->length = length;
+      cache->version = encoded_version(copy);
+      cache->valid = true;
+      cache->stamp = ++stateStats.encodes;
+    }
+    uint32_t spent = esp_timer_get_time() - started;
+    if (spent > stateStats.encode_max_us)
+      stateStats.encode_max_us = spent;
+    if (!cache->valid)
+    {
+      stateStats.unserved++;
+      return 0;
+    }
+  }
+
+  *data = cache->data;
+  *stamp = cache->stamp;
+  return cache->length;
+}
+
+void getBoardStateStats(board_state_stats_t *stats)
+{
+  *stats = stateStats;
+}
@@ -0,0 +1,85 @@
+#include "clock_service.h"
+
+#include <stddef.h>
+
+// Armed deadlines, for clockNextDeadlineIn()
+static clock_deadline_t *armedDeadlines[CLOCK_MAX_DEADLINES];
+static int armedCount = 0;
+
+#ifndef ESP_PLATFORM
+bool clockVirtual = false;
+int64_t clockVirtualNow = 0;
+
+void clockUseVirtual(bool enabled, int64_t start_us)
+{
+  clockVirtualNow = start_us;
+  clockVirtual = enabled;
+}
+
+void clockAdvance(int64_t us)
+{
+  clockVirtualNow += us;
+}
+
+bool clockAdvanceToNextDeadline()
+{
+  int64_t in = clockNextDeadlineIn(clockVirtualNow);
+  if (in < 0)
+    return false;
+  clockVirtualNow += in;
+  return true;
+}
+#endif
+
+static void forget(clock_deadline_t *deadline)
+{
+  for (int i = 0; i < armedCount; i++)
+  {
+    if (armedDeadlines[i] == deadline)
+    {
+      armedDeadlines[i] = armedDeadlines[--armedCount];
+      return;
+    }
+  }
+}
+
+void deadlineArm(clock_deadline_t *deadline, int64_t delay_us)
+{
+  if (!deadline->armed)
+  {
+    if (armedCount == CLOCK_MAX_DEADLINES)
+      return; // Stays disarmed, the caller sees it never expire
+    armedDeadlines[armedCount++] = deadline;
+  }
+  deadline->at = clockNow() + delay_us;
+  deadline->armed = true;
+}
+
+void deadlineCancel(clock_deadline_t *deadline)
+{
+  if (!deadline->armed)
+    return;
+  deadline->armed = false;
+  forget(deadline);
+}
+
+bool deadlineExpired(clock_deadline_t *deadline)
+{
+  if (!deadline->armed || clockNow() < deadline->at)
+    return false;
+  deadlineCancel(deadline);
+  return true;
+}
+
+int64_t clockNextDeadlineIn(int64_t now)
+{
+  if (armedCount == 0)
+    return -1;
+  int64_t earliest = armedDeadlines[0]->at;
+  for (int i = 1; i < armedCount; i++)
+  {
+    if (armedDeadlines[i]->at < earliest)
+      earliest = armedDeadlines[i]->at;
+  }
+  return earliest > now ? earliest - now : 0;
+}
@@ -0,0 +1,77 @@
+#include "diagnostics.h"
+
+#include <Arduino.h>
+
+typedef struct
+{
+  const char *name;
+  const char *help;
+  diagnostics_handler_t handler;
+} diagnostics_command_t;
+
+static diagnostics_command_t commands[MAX_DIAGNOSTICS_COMMANDS];
+static int commands_size = 0;
+
+static char line[64];
+static size_t line_length = 0;
+
+void diagnosticsRegister(const char *name, const char *help, diagnostics_handler_t handler)
+{
+  if (commands_size >= MAX_DIAGNOSTICS_COMMANDS)
+  {
+    Serial.printf("Diagnostics table is full, cannot add %s\n", name);
+    return;
+  }
+  commands[commands_size].name = name;
+  commands[commands_size].help = help;
+  commands[commands_size].handler = handler;
+  commands_size++;
+}
+
+static void run_line()
+{
+  // Split "name args..."
+  char *args = line;
+  while (*args && *args != ' ')
+    args++;
+  if (*args)
+    *args++ = '\0';
+
+  if (strcmp(line, "help") == 0)
+  {
+    for (int i = 0; i < commands_size; i++)
+      Serial.printf("%-10s %s\n", commands[i].name, commands[i].help);
+    return;
+  }
+
+  for (int i = 0; i < commands_size; i++)
+  {
+    if (strcmp(line, commands[i].name) == 0)
+    {
+      commands[i].handler(args);
+      return;
+    }
+  }
+  Serial.printf("Unknown diagnostics command: %s (try help)\n", line);
+}
+
+void diagnosticsPoll()
+{
+  while (Serial.available() > 0)
+  {
+    int c = Serial.read();
+    if (c == '\r' || c == '\n')
+    {
+      if (line_length > 0)
+      {
+        line[line_length] = '\0';
+        run_line();
+        line_length = 0;
+      }
+    }
+    else if (line_length < sizeof(line) - 1)
+    {
+      line[line_length++] = (char)c;
+    }
+  }
+}
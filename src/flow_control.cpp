@@ -0,0 +1,119 @@
+#include "flow_control.h"
+
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "session.h"
+
+static_assert(MAX_PLAYERS * MAX_SESSIONS <= MESSAGE_LANES, "Every seat needs a lane in the message queue");
+
+// Credits are taken in the BLE task and given back in loop(). They live in the
+// player tables, so they are counted under sessionMux, the lock every seat
+// change takes: a device found under it stays in place until it is released.
+
+static void send_grant(uint16_t conn_id, uint8_t credits, flow_notify_t notify)
+{
+  char text[16];
+  int length = snprintf(text, sizeof(text), "+%u,%u", credits, (unsigned)getMessageQueueDepth());
+  notify(conn_id, (const uint8_t *)text, length);
+}
+
+void flowControlConnected(uint16_t conn_id, flow_notify_t notify)
+{
+  portENTER_CRITICAL(&sessionMux);
+  device_connected_t *device = deviceOfConnection(conn_id);
+  if (device != NULL)
+  {
+    device->credits = CREDIT_WINDOW;
+    device->credits_owed = 0;
+  }
+  portEXIT_CRITICAL(&sessionMux);
+
+  if (device != NULL)
+    send_grant(conn_id, CREDIT_WINDOW, notify);
+}
+
+bool flowControlSubmit(uint16_t conn_id, const uint8_t mac_addr[6], const uint8_t *data, size_t length,
+                       flow_notify_t notify)
+{
+  bool accepted = false;
+  bool out_of_turn = length > 0 && data[0] != 'N' && !sessionHasTurn(conn_id);
+
+  // loop() may shift the device table between two critical sections, so the
+  // device is looked up again in each one instead of keeping its pointer
+  portENTER_CRITICAL(&sessionMux);
+  device_connected_t *device = deviceOfConnection(conn_id);
+  bool known = device != NULL;
+  if (known && out_of_turn)
+  {
+    device->out_of_turn++;
+  }
+  else if (known && length > 0 && device->credits > 0) // An empty write has no command to queue
+  {
+    device->credits--;
+    accepted = true;
+  }
+  portEXIT_CRITICAL(&sessionMux);
+
+  if (known && out_of_turn)
+  {
+    char text[4] = {'~', (char)data[0], '\0'};
+    notify(conn_id, (const uint8_t *)text, 2);
+    return false;
+  }
+
+  // No lane left (stale commands of dropped links hold them): keep the window intact
+  bool returned = accepted && !addMessageToQueue(conn_id, mac_addr, data, length);
+  if (returned)
+    accepted = false;
+
+  if (accepted)
+  {
+    notify(conn_id, data, length); // Send back the received value
+    return true;
+  }
+
+  if (known)
+  {
+    portENTER_CRITICAL(&sessionMux);
+    device = deviceOfConnection(conn_id);
+    if (device != NULL)
+    {
+      if (returned)
+        device->credits++;
+      device->dropped++;
+    }
+    portEXIT_CRITICAL(&sessionMux);
+  }
+  uint32_t depth = getMessageQueueDepth();
+  char text[24];
+  int text_length = snprintf(text, sizeof(text), "!%c,%u,%u", length > 0 ? data[0] : '?',
+                             (unsigned)((depth + 1) * FLOW_SERVICE_TIME_MS), (unsigned)depth);
+  notify(conn_id, (const uint8_t *)text, text_length);
+  return false;
+}
+
+void flowControlComplete(uint16_t conn_id, flow_notify_t notify)
+{
+  uint8_t grant = 0;
+
+  portENTER_CRITICAL(&sessionMux);
+  device_connected_t *device = deviceOfConnection(conn_id);
+  if (device != NULL)
+  {
+    device->credits_owed++;
+    // Batch the grants, but never leave a stalled client waiting
+    if (device->credits_owed >= CREDIT_WINDOW / 2 || device->credits == 0)
+    {
+      grant = device->credits_owed;
+      device->credits += grant;
+      device->credits_owed = 0;
+    }
+  }
+  portEXIT_CRITICAL(&sessionMux);
+
+  if (grant > 0)
+  {
+    send_grant(conn_id, grant, notify);
+  }
+}
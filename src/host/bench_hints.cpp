@@ -0,0 +1,96 @@
+// Host benchmark for the incremental hint engine.
+//
+// Plays random games (shooting and flagging) and times every shoot(), which
+// now carries the hint updates, against a full-board rebuild of the hints.
+// It also checks that the incremental result always matches the rebuild.
+//
+//   pio run -e native_bench -t exec
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+#include "minesweeper.h"
+
+#define GAMES 20000
+
+using bench_clock = std::chrono::steady_clock;
+
+static inline uint64_t elapsed_ns(bench_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    int games = argc > 1 ? atoi(argv[1]) : GAMES;
+    host_seed_random(1);
+
+    uint64_t shots = 0, shoot_total_ns = 0, shoot_max_ns = 0;
+    uint64_t rebuilds = 0, rebuild_total_ns = 0;
+    uint64_t mismatches = 0;
+
+    for (int g = 0; g < games; g++)
+    {
+        Minesweeper game;
+        while (!game.is_game_over() && !game.won())
+        {
+            // Walk to a random hidden tile
+            uint8_t target = esp_random() % (WIDTH * HEIGHT);
+            if (game.is_revealed(target))
+                continue;
+            while (game.get_player_position() != target)
+            {
+                uint8_t current = game.get_player_position();
+                if (Minesweeper::get_x_pos(current) < Minesweeper::get_x_pos(target))
+                    game.move_player(CMD_DOWN);
+                else if (Minesweeper::get_x_pos(current) > Minesweeper::get_x_pos(target))
+                    game.move_player(CMD_UP);
+                else if (Minesweeper::get_y_pos(current) < Minesweeper::get_y_pos(target))
+                    game.move_player(CMD_RIGHT);
+                else
+                    game.move_player(CMD_LEFT);
+            }
+
+            if ((esp_random() & 3) == 0)
+            {
+                game.builtin_button_pressed(); // Flag instead, exercising the flag path of the hints
+                continue;
+            }
+
+            bench_clock::time_point start = bench_clock::now();
+            game.shoot();
+            uint64_t ns = elapsed_ns(start);
+            shots++;
+            shoot_total_ns += ns;
+            if (ns > shoot_max_ns)
+                shoot_max_ns = ns;
+
+            uint8_t incremental[WIDTH * HEIGHT];
+            for (int i = 0; i < WIDTH * HEIGHT; i++)
+                incremental[i] = game.get_hint(i);
+
+            start = bench_clock::now();
+            game.rebuild_hints();
+            rebuild_total_ns += elapsed_ns(start);
+            rebuilds++;
+
+            for (int i = 0; i < WIDTH * HEIGHT; i++)
+            {
+                if (incremental[i] != game.get_hint(i))
+                    mismatches++;
+            }
+
+            if (game.won() || (esp_random() & 7) == 0)
+                break; // Random games rarely finish, cut some short to vary the board state
+        }
+    }
+
+    printf("games:                 %d\n", games);
+    printf("shots:                 %llu\n", (unsigned long long)shots);
+    printf("shoot + hints (avg):   %.2f us\n", shoot_total_ns / 1000.0 / shots);
+    printf("shoot + hints (max):   %.2f us\n", shoot_max_ns / 1000.0);
+    printf("full rebuild (avg):    %.2f us\n", rebuild_total_ns / 1000.0 / rebuilds);
+    printf("hint mismatches:       %llu\n", (unsigned long long)mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
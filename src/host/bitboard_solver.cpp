@@ -0,0 +1,155 @@
+#include "bitboard_solver.h"
+
+#include <string.h>
+
+#define COLUMN_0 0x0101010101010101ULL
+#define COLUMN_7 0x8080808080808080ULL
+
+// Row of 8 bytes -> byte whose bit j is bit `plane` of byte j (no two partial
+// products share a bit, so the multiply is a pure gather)
+static inline uint8_t gather_plane(uint64_t bytes, int plane)
+{
+    return (uint8_t)((((bytes >> plane) & COLUMN_0) * 0x0102040810204080ULL) >> 56);
+}
+
+void solver_load(solver_batch_t *batch, int lane, const uint8_t *revealed_rows, const uint8_t *flagged_rows,
+                 const uint8_t *neighbour_count)
+{
+    uint64_t revealed[2], flagged[2], planes[4][2] = {};
+    memcpy(revealed, revealed_rows, sizeof(revealed));
+    memcpy(flagged, flagged_rows, sizeof(flagged));
+
+    for (int row = 0; row < HEIGHT; row++)
+    {
+        uint64_t counts;
+        memcpy(&counts, neighbour_count + row * WIDTH, sizeof(counts));
+        uint8_t visible = revealed_rows[row];
+        for (int plane = 0; plane < 4; plane++)
+        {
+            planes[plane][row / 8] |= (uint64_t)(gather_plane(counts, plane) & visible) << (row % 8 * 8);
+        }
+    }
+
+    batch->revealed.lo[lane] = revealed[0];
+    batch->revealed.hi[lane] = revealed[1];
+    batch->flagged.lo[lane] = flagged[0];
+    batch->flagged.hi[lane] = flagged[1];
+    for (int plane = 0; plane < 4; plane++)
+    {
+        batch->count[plane].lo[lane] = planes[plane][0];
+        batch->count[plane].hi[lane] = planes[plane][1];
+    }
+}
+
+// Every helper below runs on all lanes at once
+
+static inline bitboard_t bb_and(bitboard_t a, bitboard_t b)
+{
+    return {a.lo & b.lo, a.hi & b.hi};
+}
+
+static inline bitboard_t bb_or(bitboard_t a, bitboard_t b)
+{
+    return {a.lo | b.lo, a.hi | b.hi};
+}
+
+static inline bitboard_t bb_xor(bitboard_t a, bitboard_t b)
+{
+    return {a.lo ^ b.lo, a.hi ^ b.hi};
+}
+
+static inline bitboard_t bb_not(bitboard_t a)
+{
+    return {~a.lo, ~a.hi};
+}
+
+// Each tile takes the value of its neighbour in one direction; nothing wraps
+static inline bitboard_t from_left(bitboard_t a)
+{
+    return {(a.lo << 1) & ~COLUMN_0, (a.hi << 1) & ~COLUMN_0};
+}
+
+static inline bitboard_t from_right(bitboard_t a)
+{
+    return {(a.lo >> 1) & ~COLUMN_7, (a.hi >> 1) & ~COLUMN_7};
+}
+
+static inline bitboard_t from_above(bitboard_t a)
+{
+    return {a.lo << 8, (a.hi << 8) | (a.lo >> 56)};
+}
+
+static inline bitboard_t from_below(bitboard_t a)
+{
+    return {(a.lo >> 8) | (a.hi << 56), a.hi >> 8};
+}
+
+// Bit-sliced counter: planes[] += bit, per tile
+static inline void count_add(bitboard_t planes[4], bitboard_t bit)
+{
+    for (int k = 0; k < 4; k++)
+    {
+        bitboard_t carry = bb_and(planes[k], bit);
+        planes[k] = bb_xor(planes[k], bit);
+        bit = carry;
+    }
+}
+
+// Number of neighbours set in `mask`, per tile (0..8)
+static inline void count_neighbours(bitboard_t mask, bitboard_t planes[4])
+{
+    bitboard_t zero = {};
+    for (int k = 0; k < 4; k++)
+        planes[k] = zero;
+
+    bitboard_t above = from_above(mask);
+    bitboard_t below = from_below(mask);
+    count_add(planes, above);
+    count_add(planes, below);
+    count_add(planes, from_left(mask));
+    count_add(planes, from_right(mask));
+    count_add(planes, from_left(above));
+    count_add(planes, from_right(above));
+    count_add(planes, from_left(below));
+    count_add(planes, from_right(below));
+}
+
+static inline bitboard_t dilate(bitboard_t mask)
+{
+    bitboard_t rows = bb_or(mask, bb_or(from_above(mask), from_below(mask)));
+    return bb_or(rows, bb_or(from_left(rows), from_right(rows)));
+}
+
+static inline bitboard_t equal(const bitboard_t a[4], const bitboard_t b[4])
+{
+    bitboard_t diff = {};
+    for (int k = 0; k < 4; k++)
+        diff = bb_or(diff, bb_xor(a[k], b[k]));
+    return bb_not(diff);
+}
+
+void solver_deduce(const solver_batch_t *batch, solver_result_t *result)
+{
+    bitboard_t hidden = bb_not(bb_or(batch->revealed, batch->flagged));
+
+    bitboard_t flags[4], unknown[4];
+    count_neighbours(batch->flagged, flags);
+    count_neighbours(hidden, unknown);
+
+    // flags + unknown, with a ripple-carry adder over the planes
+    bitboard_t total[4], carry = {};
+    bitboard_t any_unknown = {};
+    for (int k = 0; k < 4; k++)
+    {
+        total[k] = bb_xor(bb_xor(flags[k], unknown[k]), carry);
+        carry = bb_or(bb_and(flags[k], unknown[k]), bb_and(carry, bb_xor(flags[k], unknown[k])));
+        any_unknown = bb_or(any_unknown, unknown[k]);
+    }
+
+    // Numbers that are satisfied, and numbers that need every hidden neighbour
+    bitboard_t satisfied = bb_and(batch->revealed, equal(batch->count, flags));
+    bitboard_t saturated = bb_and(bb_and(batch->revealed, any_unknown), equal(batch->count, total));
+
+    result->safe = bb_and(dilate(satisfied), hidden);
+    result->mines = bb_and(dilate(saturated), hidden);
+}
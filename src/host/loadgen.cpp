@@ -0,0 +1,161 @@
+// Host run of the load generator against the real message queue, flow
+// control, session routing and command dispatch.
+//
+// The main thread plays loop(): up to DISPATCH_BATCH messages per iteration,
+// then the 10 ms delay of the firmware. A second thread plays the BLE stack
+// and drives the simulated clients.
+//
+//   pio run -e native_loadgen -t exec
+//   .pio/build/native_loadgen/program [clients] [rate_hz] [spam_hz] [burst] [burst_ms] [churn_ms] [duration_ms] [loop_ms] [flow_control] [virtual] [realtime]
+//
+// With flow_control=0 the clients ignore their credits, so the server has to NACK them.
+// With virtual=1 both sides run in one thread on the virtual clock, stepping the
+// clients every 100 us of simulated time: a long run finishes in a fraction of it.
+// With realtime=1 every session plays in real time, so every client sends at
+// the full rate and nobody is rejected out of turn.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "alloc_stats.h"
+#include "clock_service.h"
+#include "flow_control.h"
+#include "load_generator.h"
+#include "message_queue.h"
+#include "session.h"
+
+static std::mutex sessionsMutex; // the firmware relies on the BLE task and loop() not racing here
+
+static void host_connect(const uint8_t mac_addr[6], uint16_t conn_id)
+{
+  std::lock_guard<std::mutex> lock(sessionsMutex);
+  if (joinSession(mac_addr, conn_id) != NULL)
+    flowControlConnected(conn_id, loadgenOnNotify);
+}
+
+static void host_disconnect(const uint8_t mac_addr[6], uint16_t conn_id)
+{
+  (void)mac_addr; // Seats are found by connection
+  std::lock_guard<std::mutex> lock(sessionsMutex);
+  leaveSession(conn_id); // Same as the firmware: the seat is held for a reconnect
+}
+
+static bool host_write(uint16_t conn_id, const uint8_t mac_addr[6], const uint8_t *data, size_t length)
+{
+  std::lock_guard<std::mutex> lock(sessionsMutex);
+  return flowControlSubmit(conn_id, mac_addr, data, length, loadgenOnNotify);
+}
+
+static bool host_has_turn(uint16_t conn_id)
+{
+  std::lock_guard<std::mutex> lock(sessionsMutex);
+  return sessionHasTurn(conn_id);
+}
+
+// One iteration of loop(): whatever is waiting, up to DISPATCH_BATCH messages
+static void dispatch_batch(uint32_t *ignored)
+{
+  {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    expireAwaySeats(clockNow());
+  }
+  message_t *message;
+  for (int dispatched = 0; dispatched < DISPATCH_BATCH && (message = peekMessageFromQueue()) != NULL; dispatched++)
+  {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    flowControlComplete(message->conn_id, loadgenOnNotify);
+    session_t *session = sessionOfConnection(message->conn_id);
+    if (session != NULL)
+    {
+      if (sessionDispatch(session, message, loadgenOnNotify) & EFFECT_IGNORED)
+        (*ignored)++; // "Message not from current player, ignoring"
+      if (session->game.is_game_over() || session->game.won())
+        resetSession(session);
+    }
+    releaseMessageFromQueue();
+  }
+}
+
+int main(int argc, char **argv)
+{
+  loadgen_config_t config = LOADGEN_DEFAULT_CONFIG;
+  uint32_t *fields[] = {&config.clients, &config.rate_hz, &config.out_of_turn_rate_hz, &config.burst_size,
+                        &config.burst_period_ms, &config.churn_period_ms, &config.duration_ms};
+  for (int i = 1; i < argc && i <= 7; i++)
+    *fields[i - 1] = strtoul(argv[i], NULL, 10);
+  uint32_t loop_ms = argc > 8 ? strtoul(argv[8], NULL, 10) : 10;
+  if (argc > 9)
+    config.flow_control = atoi(argv[9]) != 0;
+  bool virtual_clock = argc > 10 && atoi(argv[10]) != 0;
+  if (argc > 11 && atoi(argv[11]) != 0)
+  {
+    for (int i = 0; i < MAX_SESSIONS; i++)
+      setSessionRealtime(&sessions[i], true);
+  }
+
+  const loadgen_hooks_t hooks = {host_connect, host_disconnect, host_write, host_has_turn};
+  setMessageQueuePriority(host_has_turn); // Same lane order as the firmware
+  uint32_t ignored = 0;
+  alloc_stats_t allocations;
+  std::chrono::steady_clock::time_point wall_start = std::chrono::steady_clock::now();
+
+  if (virtual_clock)
+  {
+    clockUseVirtual(true, 0);
+    loadgenBegin(&config, &hooks, clockNow());
+    markAllocBaseline();
+    int64_t next_loop = clockNow();
+    while (loadgenStep(clockNow()))
+    {
+      if (clockNow() >= next_loop)
+      {
+        dispatch_batch(&ignored);
+        next_loop += loop_ms * 1000;
+      }
+      clockAdvance(100);
+    }
+    getAllocStats(&allocations);
+  }
+  else
+  {
+    loadgenBegin(&config, &hooks, clockNow());
+
+    std::atomic<bool> running(true);
+    std::thread ble_stack([&running]()
+                          {
+      while (loadgenStep(clockNow()))
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      running = false; });
+
+    markAllocBaseline(); // Threads are up, the input path itself must not allocate
+    while (running)
+    {
+      dispatch_batch(&ignored);
+      std::this_thread::sleep_for(std::chrono::milliseconds(loop_ms));
+    }
+    getAllocStats(&allocations);
+    ble_stack.join();
+  }
+
+  loadgen_report_t report;
+  loadgenEnd(&report, clockNow());
+
+  char text[512];
+  loadgenFormatReport(&report, text, sizeof(text));
+  fputs(text, stdout);
+  printf("ignored:       %u (out of turn, dequeued then discarded)\n", (unsigned)ignored);
+  reconnect_stats_t reconnects;
+  getReconnectStats(&reconnects);
+  printf("reconnects:    %u seats held, %u restored, %u expired\n",
+         (unsigned)reconnects.held, (unsigned)reconnects.restored, (unsigned)reconnects.expired);
+  printf("allocations:   %u during the run\n", (unsigned)allocations.allocations_since_baseline);
+  printf("wall time:     %lld ms%s\n",
+         (long long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - wall_start).count(),
+         virtual_clock ? " (virtual clock)" : "");
+  return 0;
+}
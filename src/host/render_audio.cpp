@@ -0,0 +1,132 @@
+// Host render of the audio mixer into a WAV file, to listen to the mix and
+// check it for clipping without a device.
+//
+// The mixer runs block by block as the firmware's output task does; the
+// scene decides which melodies start at which block.
+//
+//   pio run -e native_audio
+//   .pio/build/native_audio/program [out.wav] [game|win|gameover|move|bomb]
+//
+// "game" is the case one voice could not handle: the win melody with moves,
+// flags and a game over started on top of it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio_mixer.h"
+#include "melodies.h"
+
+#define RENDER_MAX_SECONDS 10
+
+typedef struct
+{
+  uint32_t at_ms;
+  const audio_melody_t *melody;
+} audio_cue_t;
+
+static const audio_cue_t gameScene[] = {
+    {0, &melodyWin},          {300, &melodySimpleMove}, {450, &melodySimpleMove}, {600, &melodySimpleMove},
+    {900, &melodyPlaceBomb},  {1200, &melodySimpleMove}, {1250, &melodySimpleMove}, // Restarts in its voice
+    {1500, &melodyGameOver},  {1600, &melodyPlaceBomb}, {1700, &melodySimpleMove},
+};
+
+static void put_le(FILE *out, uint32_t value, int bytes)
+{
+  for (int i = 0; i < bytes; i++)
+    fputc((value >> (8 * i)) & 0xFF, out);
+}
+
+static void write_wav_header(FILE *out, uint32_t samples)
+{
+  uint32_t data_bytes = samples * 2;
+  fwrite("RIFF", 1, 4, out);
+  put_le(out, 36 + data_bytes, 4);
+  fwrite("WAVEfmt ", 1, 8, out);
+  put_le(out, 16, 4);                     // PCM chunk size
+  put_le(out, 1, 2);                      // PCM
+  put_le(out, 1, 2);                      // Mono
+  put_le(out, AUDIO_SAMPLE_RATE, 4);
+  put_le(out, AUDIO_SAMPLE_RATE * 2, 4);  // Byte rate
+  put_le(out, 2, 2);                      // Block align
+  put_le(out, 16, 2);                     // Bits per sample
+  fwrite("data", 1, 4, out);
+  put_le(out, data_bytes, 4);
+}
+
+int main(int argc, char **argv)
+{
+  const char *path = argc > 1 ? argv[1] : "audio.wav";
+  const char *scene = argc > 2 ? argv[2] : "game";
+
+  audio_cue_t single = {0, NULL};
+  const audio_cue_t *cues = &single;
+  int cue_count = 1;
+  if (strcmp(scene, "game") == 0)
+  {
+    cues = gameScene;
+    cue_count = sizeof(gameScene) / sizeof(gameScene[0]);
+  }
+  else if (strcmp(scene, "win") == 0)
+    single.melody = &melodyWin;
+  else if (strcmp(scene, "gameover") == 0)
+    single.melody = &melodyGameOver;
+  else if (strcmp(scene, "move") == 0)
+    single.melody = &melodySimpleMove;
+  else if (strcmp(scene, "bomb") == 0)
+    single.melody = &melodyPlaceBomb;
+  else
+  {
+    fprintf(stderr, "Unknown scene %s\n", scene);
+    return 1;
+  }
+
+  FILE *out = fopen(path, "wb");
+  if (out == NULL)
+  {
+    fprintf(stderr, "Cannot write %s\n", path);
+    return 1;
+  }
+  write_wav_header(out, 0); // Sizes are patched once the length is known
+
+  audioMixerBegin();
+  static int16_t block[AUDIO_BLOCK_FRAMES];
+  uint32_t samples = 0, clipped = 0;
+  int peak = 0, next_cue = 0;
+  while (samples < RENDER_MAX_SECONDS * AUDIO_SAMPLE_RATE)
+  {
+    // Cues take effect at the next block boundary, as on the device
+    uint32_t now_ms = (uint64_t)samples * 1000 / AUDIO_SAMPLE_RATE;
+    while (next_cue < cue_count && cues[next_cue].at_ms <= now_ms)
+      audioPlay(cues[next_cue++].melody);
+    if (next_cue == cue_count && !audioActive())
+      break;
+
+    audioMix(block, AUDIO_BLOCK_FRAMES);
+    for (int i = 0; i < AUDIO_BLOCK_FRAMES; i++)
+    {
+      int level = abs(block[i]);
+      if (level > peak)
+        peak = level;
+      if (level >= INT16_MAX)
+        clipped++;
+      put_le(out, (uint16_t)block[i], 2);
+    }
+    samples += AUDIO_BLOCK_FRAMES;
+  }
+
+  fseek(out, 0, SEEK_SET);
+  write_wav_header(out, samples);
+  fclose(out);
+
+  audio_stats_t stats;
+  getAudioStats(&stats);
+  printf("%s: %.2f s at %d Hz, peak %d (%.1f dBFS), %u samples clipped\n", path,
+         (double)samples / AUDIO_SAMPLE_RATE, AUDIO_SAMPLE_RATE, peak,
+         peak > 0 ? 20.0 * __builtin_log10((double)peak / 32767) : -99.0, clipped);
+  printf("melodies: %u played, %u restarted, %u took over a voice, %u blocks limited\n", stats.plays,
+         stats.restarted, stats.stolen, stats.limited);
+  printf("mixing: %u blocks, avg %.2f us, max %u us per %d-sample block\n", stats.blocks,
+         stats.blocks ? (double)stats.mix_total_us / stats.blocks : 0.0, stats.mix_max_us, AUDIO_BLOCK_FRAMES);
+  return 0;
+}
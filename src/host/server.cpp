@@ -0,0 +1,191 @@
+// Host build of the game server behind the local socket transport.
+//
+// The real connection layer, flow control, message queue, session routing
+// and command dispatch serve every client that connects, so throughput and
+// latency can be profiled with the usual Linux tools (perf, strace, ss, ...).
+// The main thread plays loop() and drains the queue as soon as commands
+// arrive; the transport thread plays the BLE stack.
+//
+//   pio run -e native_server
+//   .pio/build/native_server/program [unix:/tmp/bluebomb.sock | tcp:<port>] [report_s] [trace.json]
+//
+// With a trace file, spans are recorded as on the device and written there as
+// Chrome / Perfetto trace JSON on exit (the last TRACE_RECORDS events).
+//
+// A client sends one command per line and reads one notification per line:
+//   (echo S; sleep 1) | nc -U /tmp/bluebomb.sock
+//   (echo S; echo '?'; sleep 1) | nc -U /tmp/bluebomb.sock   # and the board afterwards
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "board_state.h"
+#include "esp_timer.h"
+#include "flow_control.h"
+#include "message_queue.h"
+#include "session.h"
+#include "socket_transport.h"
+#include "trace.h"
+#include "transport.h"
+
+static std::mutex sessionsMutex; // the firmware relies on the BLE task and loop() not racing here
+static std::mutex wakeMutex;
+static std::condition_variable wakeLoop;
+static bool wakePending = false; // Under wakeMutex: a command was queued since the loop last looked
+static std::atomic<bool> running(true);
+
+static void server_notify(uint16_t conn_id, const uint8_t *data, size_t length)
+{
+  transportNotify(conn_id, data, length);
+}
+
+static void server_connect(const uint8_t mac_addr[6], uint16_t conn_id)
+{
+  std::lock_guard<std::mutex> lock(sessionsMutex);
+  if (joinSession(mac_addr, conn_id) != NULL)
+    flowControlConnected(conn_id, server_notify);
+}
+
+static void server_disconnect(const uint8_t mac_addr[6], uint16_t conn_id)
+{
+  (void)mac_addr; // Seats are found by connection
+  std::lock_guard<std::mutex> lock(sessionsMutex);
+  leaveSession(conn_id); // Same as the firmware: the seat is held for a reconnect
+}
+
+static bool server_write(uint16_t conn_id, const uint8_t mac_addr[6], const uint8_t *data, size_t length)
+{
+  TraceScope span(TRACE_BLE_WRITE); // Same track name as the device's BLE callback
+  bool queued;
+  {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    queued = flowControlSubmit(conn_id, mac_addr, data, length, server_notify);
+  }
+  if (queued)
+  {
+    // Set under the lock, so a loop that just found the queue empty cannot miss it
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    wakePending = true;
+    wakeLoop.notify_one();
+  }
+  return queued;
+}
+
+static bool server_has_turn(uint16_t conn_id)
+{
+  std::lock_guard<std::mutex> lock(sessionsMutex);
+  return sessionHasTurn(conn_id);
+}
+
+static size_t server_read(uint16_t conn_id, const uint8_t **data, uint32_t *stamp)
+{
+  std::lock_guard<std::mutex> lock(sessionsMutex);
+  session_t *session = sessionOfConnection(conn_id);
+  return session != NULL ? boardStateRead(session, data, stamp) : 0;
+}
+
+static const transport_events_t serverEvents = {server_connect, server_disconnect, server_write, server_read};
+
+static void stop(int)
+{
+  running = false; // The loop notices within its 100 ms wait
+}
+
+static void report(int64_t elapsed_us)
+{
+  message_queue_stats_t queue;
+  getMessageQueueStats(&queue);
+  socket_transport_stats_t sockets;
+  getSocketTransportStats(&sockets);
+
+  double seconds = elapsed_us / 1e6;
+  printf("%.1f s: %u clients accepted (%u rejected), %u commands (%.0f/s), %u dequeued, %u dropped\n",
+         seconds, sockets.accepted, sockets.rejected, sockets.lines, sockets.lines / seconds,
+         queue.dequeued, queue.dropped);
+  printf("  queue latency (us): p50 %lld, p99 %lld, p99.9 %lld, max %lld, max depth %u\n",
+         (long long)messageQueueLatencyPercentile(&queue, 500),
+         (long long)messageQueueLatencyPercentile(&queue, 990),
+         (long long)messageQueueLatencyPercentile(&queue, 999),
+         (long long)queue.latency_max_us, queue.max_depth);
+  printf("  notifications: %u sent, %u dropped (client not reading)\n", sockets.notifications, sockets.notify_dropped);
+  board_state_stats_t state;
+  getBoardStateStats(&state);
+  printf("  board state: %u reads, %u encoded (max %u us), %u retried, %u empty\n", state.reads, state.encodes,
+         state.encode_max_us, state.retries, state.unserved);
+  fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+  const char *address = argc > 1 ? argv[1] : SOCKET_DEFAULT_ADDRESS;
+  int64_t report_us = (argc > 2 ? atoll(argv[2]) : 5) * 1000000LL;
+  const char *trace_path = argc > 3 ? argv[3] : NULL;
+  traceEnable(trace_path != NULL);
+
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+
+  setMessageQueuePriority(server_has_turn);
+  transportRegister(&socketTransport, SOCKET_CONN_ID_BASE, SOCKET_MAX_CONNECTIONS);
+  if (!transportBeginAll(address, &serverEvents))
+    return 1;
+  printf("Serving %d sessions on %s\n", MAX_SESSIONS, address);
+  fflush(stdout);
+
+  int64_t start = esp_timer_get_time();
+  int64_t next_report = start + report_us;
+  while (running)
+  {
+    message_t *message = peekMessageFromQueue();
+    if (message == NULL)
+    {
+      std::unique_lock<std::mutex> lock(wakeMutex);
+      wakeLoop.wait_for(lock, std::chrono::milliseconds(100), [] { return wakePending; });
+      wakePending = false;
+    }
+    else
+    {
+      std::lock_guard<std::mutex> lock(sessionsMutex);
+      flowControlComplete(message->conn_id, server_notify);
+      session_t *session = sessionOfConnection(message->conn_id);
+      if (session != NULL)
+      {
+        traceBegin(TRACE_DISPATCH);
+        sessionDispatch(session, message, server_notify);
+        traceEnd(TRACE_DISPATCH);
+        if (session->game.is_game_over() || session->game.won())
+          resetSession(session); // Nobody watches the host screen, start over at once
+      }
+      releaseMessageFromQueue();
+    }
+
+    int64_t now = esp_timer_get_time();
+    {
+      std::lock_guard<std::mutex> lock(sessionsMutex);
+      expireAwaySeats(now);
+    }
+    if (report_us > 0 && now >= next_report)
+    {
+      report(now - start);
+      next_report = now + report_us;
+    }
+  }
+
+  transportEndAll();
+  report(esp_timer_get_time() - start);
+  if (trace_path != NULL)
+  {
+    if (!traceWriteChrome(trace_path))
+    {
+      fprintf(stderr, "Cannot write %s\n", trace_path);
+      return 1;
+    }
+    printf("Trace written to %s\n", trace_path);
+  }
+  return 0;
+}
@@ -0,0 +1,413 @@
+// Host Monte-Carlo simulator: plays millions of games with the real engine to
+// tune the mine density and the first-click policy.
+//
+// Every game is a `Minesweeper` seeded from its own number, played by a
+// solver: it shoots the tiles the bitboard kernel proves safe, flags the ones
+// it proves to be mines, and only guesses when nothing is proven, picking the
+// tile with the lowest mine probability from the hint engine. Games run
+// SOLVER_LANES at a time so one kernel call deduces for all of them.
+//
+// Seeds are cut into batches that are dealt round-robin to one queue per
+// thread; a thread that runs dry steals from the back of the others. Results
+// only depend on the seeds, not on the thread count or the schedule.
+//
+//   pio run -e native_simulate -t exec
+//   .pio/build/native_simulate/program [games] [threads] [corner|center|random] [first_seed]
+//
+// Mine density and the engine's safe first click are build flags:
+//   PLATFORMIO_BUILD_FLAGS="-DNUM_BOMBS=20 -DSAFE_FIRST_CLICK=0" pio run -e native_simulate -t exec
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bitboard_solver.h"
+#include "minesweeper.h"
+
+#define GAMES 1000000
+#define BATCH_GAMES 512 // Seeds per work item
+#define CASCADE_BUCKETS 8 // 1, 2-3, 4-7, ... 64-127, 128
+#define GUESS_BUCKETS 8   // 0 .. 6, 7 or more
+#define SAFE_TILES (WIDTH * HEIGHT - NUM_BOMBS)
+
+enum first_click_t
+{
+    FIRST_CLICK_CORNER,
+    FIRST_CLICK_CENTER,
+    FIRST_CLICK_RANDOM
+};
+
+static const char *const firstClickNames[] = {"corner", "center", "random"};
+
+typedef struct
+{
+    uint64_t games;
+    uint64_t wins;
+    uint64_t lost_on_opening; // The first shot hit a mine (only without SAFE_FIRST_CLICK)
+    uint64_t shots;
+    uint64_t guesses; // Shots taken with nothing proven safe, the opening excluded
+    uint64_t flags;
+    uint64_t unsound; // Kernel deductions contradicted by the real board, must stay 0
+    uint64_t cascade_hist[CASCADE_BUCKETS];
+    uint64_t guess_hist[GUESS_BUCKETS];
+    uint64_t kernel_calls;
+    uint64_t batches;
+    uint64_t steals;
+} sim_stats_t;
+
+typedef struct
+{
+    Minesweeper game;
+    uint32_t rng; // esp_random() state of this game, swapped in while it is played
+    bool active;
+    bool opened;
+    uint32_t guesses;
+} sim_lane_t;
+
+typedef struct
+{
+    std::mutex lock;
+    std::deque<uint64_t> batches; // First seed of each batch
+} work_queue_t;
+
+static uint64_t totalGames = GAMES;
+static first_click_t firstClick = FIRST_CLICK_CORNER;
+static std::vector<work_queue_t> queues;
+
+static bool take_batch(int self, uint64_t *first_seed, sim_stats_t *stats)
+{
+    {
+        std::lock_guard<std::mutex> guard(queues[self].lock);
+        if (!queues[self].batches.empty())
+        {
+            *first_seed = queues[self].batches.front();
+            queues[self].batches.pop_front();
+            return true;
+        }
+    }
+
+    // Nothing new is ever queued, so one empty round means all work is handed out
+    for (size_t i = 1; i < queues.size(); i++)
+    {
+        work_queue_t &victim = queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.batches.empty())
+        {
+            *first_seed = victim.batches.back();
+            victim.batches.pop_back();
+            stats->steals++;
+            return true;
+        }
+    }
+    return false;
+}
+
+static int revealed_tiles(Minesweeper &game)
+{
+    uint64_t rows[2];
+    memcpy(rows, game.get_revealed_rows(), sizeof(rows));
+    return __builtin_popcountll(rows[0]) + __builtin_popcountll(rows[1]);
+}
+
+static void shoot_at(Minesweeper &game, uint8_t target, sim_stats_t *stats)
+{
+    int before = revealed_tiles(game);
+    game.jump_player(target);
+    game.shoot();
+    stats->shots++;
+
+    int cascade = revealed_tiles(game) - before;
+    int bucket = 0;
+    while (bucket < CASCADE_BUCKETS - 1 && cascade >= (2 << bucket))
+        bucket++;
+    stats->cascade_hist[bucket]++;
+}
+
+// Hidden, unflagged tile with the lowest mine probability. Off the frontier the
+// hint engine knows nothing, so the mines left over the tiles left stand in.
+static uint8_t pick_guess(Minesweeper &game)
+{
+    int hidden = 0, flagged = 0;
+    for (int i = 0; i < WIDTH * HEIGHT; i++)
+    {
+        if (game.is_marked_as_bomb(i))
+            flagged++;
+        else if (!game.is_revealed(i))
+            hidden++;
+    }
+    int interior = hidden ? 100 * (NUM_BOMBS - flagged) / hidden : 100;
+
+    uint8_t best = 0;
+    int best_probability = 101;
+    int start = esp_random() % (WIDTH * HEIGHT); // Ties go to a random tile, not always the top-left one
+    for (int n = 0; n < WIDTH * HEIGHT; n++)
+    {
+        uint8_t i = (start + n) % (WIDTH * HEIGHT);
+        if (game.is_revealed(i) || game.is_marked_as_bomb(i))
+            continue;
+        int probability = game.get_hint(i) == HINT_UNKNOWN ? interior : game.get_hint(i);
+        if (probability < best_probability)
+        {
+            best = i;
+            best_probability = probability;
+        }
+    }
+    return best;
+}
+
+static void open_game(sim_lane_t *lane, sim_stats_t *stats)
+{
+    uint8_t target = 0;
+    if (firstClick == FIRST_CLICK_CENTER)
+        target = (HEIGHT / 2) * WIDTH + WIDTH / 2;
+    else if (firstClick == FIRST_CLICK_RANDOM)
+        target = esp_random() % (WIDTH * HEIGHT);
+
+    shoot_at(lane->game, target, stats);
+    lane->opened = true;
+    if (lane->game.is_game_over())
+        stats->lost_on_opening++;
+}
+
+static void finish_game(sim_lane_t *lane, bool won, sim_stats_t *stats)
+{
+    stats->games++;
+    stats->wins += won;
+    stats->guesses += lane->guesses;
+    stats->guess_hist[std::min<uint32_t>(lane->guesses, GUESS_BUCKETS - 1)]++;
+    lane->active = false;
+}
+
+// Apply the kernel's verdict for one game: flag, then shoot, else guess
+static void play_lane(sim_lane_t *lane, int index, const solver_result_t *result, sim_stats_t *stats)
+{
+    Minesweeper &game = lane->game;
+    uint64_t mines[2] = {solver_lane_lo(&result->mines, index), solver_lane_hi(&result->mines, index)};
+    uint64_t safe[2] = {solver_lane_lo(&result->safe, index), solver_lane_hi(&result->safe, index)};
+
+    for (int half = 0; half < 2; half++)
+    {
+        for (uint64_t bits = mines[half]; bits != 0; bits &= bits - 1)
+        {
+            uint8_t tile = half * 64 + __builtin_ctzll(bits);
+            stats->unsound += !game.is_bomb(tile);
+            game.jump_player(tile);
+            game.builtin_button_pressed();
+            stats->flags++;
+        }
+    }
+
+    if (safe[0] == 0 && safe[1] == 0)
+    {
+        if (mines[0] == 0 && mines[1] == 0 && revealed_tiles(game) < SAFE_TILES)
+        {
+            lane->guesses++;
+            shoot_at(game, pick_guess(game), stats);
+        }
+    }
+    else
+    {
+        for (int half = 0; half < 2; half++)
+        {
+            for (uint64_t bits = safe[half]; bits != 0; bits &= bits - 1)
+            {
+                uint8_t tile = half * 64 + __builtin_ctzll(bits);
+                stats->unsound += game.is_bomb(tile);
+                if (!game.is_revealed(tile)) // An earlier cascade may have opened it
+                    shoot_at(game, tile, stats);
+            }
+        }
+    }
+
+    if (game.is_game_over())
+    {
+        finish_game(lane, false, stats);
+    }
+    else if (revealed_tiles(game) == SAFE_TILES)
+    {
+        // Whatever is still hidden is a mine, the engine also wants them flagged
+        for (int i = 0; i < WIDTH * HEIGHT; i++)
+        {
+            if (!game.is_revealed(i) && !game.is_marked_as_bomb(i))
+            {
+                game.jump_player(i);
+                game.builtin_button_pressed();
+                stats->flags++;
+            }
+        }
+        finish_game(lane, game.won(), stats);
+    }
+}
+
+static void run_batch(uint64_t first_seed, sim_stats_t *stats)
+{
+    static thread_local sim_lane_t lanes[SOLVER_LANES];
+    uint64_t next_seed = first_seed;
+    uint64_t end_seed = std::min<uint64_t>(first_seed + BATCH_GAMES, totalGames);
+    int active = 0;
+
+    for (;;)
+    {
+        // Refill finished lanes, so the kernel keeps working on full vectors
+        for (int i = 0; i < SOLVER_LANES; i++)
+        {
+            sim_lane_t *lane = &lanes[i];
+            if (lane->active || next_seed >= end_seed)
+                continue;
+            host_seed_random((uint32_t)(next_seed * 2654435761u) ^ 0x9E3779B9u);
+            next_seed++;
+            lane->game.reset();
+            lane->rng = host_random_state();
+            lane->active = true;
+            lane->opened = false;
+            lane->guesses = 0;
+            active++;
+        }
+        if (active == 0)
+            return;
+
+        solver_batch_t batch = {};
+        for (int i = 0; i < SOLVER_LANES; i++)
+        {
+            sim_lane_t *lane = &lanes[i];
+            if (!lane->active)
+                continue;
+            host_random_state() = lane->rng;
+            if (!lane->opened)
+                open_game(lane, stats);
+            lane->rng = host_random_state();
+            if (lane->game.is_game_over())
+            {
+                finish_game(lane, false, stats);
+                active--;
+                continue;
+            }
+            solver_load(&batch, i, lane->game.get_revealed_rows(), lane->game.get_marked_rows(),
+                        lane->game.get_neighbour_counts());
+        }
+
+        solver_result_t result;
+        solver_deduce(&batch, &result);
+        stats->kernel_calls++;
+
+        for (int i = 0; i < SOLVER_LANES; i++)
+        {
+            sim_lane_t *lane = &lanes[i];
+            if (!lane->active)
+                continue;
+            host_random_state() = lane->rng;
+            play_lane(lane, i, &result, stats);
+            lane->rng = host_random_state();
+            if (!lane->active)
+                active--;
+        }
+    }
+}
+
+static void worker(int self, sim_stats_t *stats)
+{
+    uint64_t first_seed;
+    while (take_batch(self, &first_seed, stats))
+    {
+        run_batch(first_seed, stats);
+        stats->batches++;
+    }
+}
+
+static void merge(sim_stats_t *into, const sim_stats_t *from)
+{
+    // Every field is a counter
+    const uint64_t *src = (const uint64_t *)from;
+    uint64_t *dst = (uint64_t *)into;
+    for (size_t i = 0; i < sizeof(sim_stats_t) / sizeof(uint64_t); i++)
+        dst[i] += src[i];
+}
+
+static void print_histogram(const char *title, const char *const *labels, const uint64_t *hist, int buckets)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < buckets; i++)
+        total += hist[i];
+
+    printf("%s\n", title);
+    for (int i = 0; i < buckets; i++)
+    {
+        double share = total ? 100.0 * hist[i] / total : 0;
+        char bar[41];
+        int width = (int)(share * 40 / 100 + 0.5);
+        memset(bar, '#', width);
+        bar[width] = '\0';
+        printf("  %8s %6.2f%% %s\n", labels[i], share, bar);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    totalGames = argc > 1 ? strtoull(argv[1], NULL, 10) : GAMES;
+    int threads = argc > 2 ? atoi(argv[2]) : 0;
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    if (argc > 3)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            if (strcmp(argv[3], firstClickNames[i]) == 0)
+                firstClick = (first_click_t)i;
+        }
+    }
+    uint64_t first_seed = argc > 4 ? strtoull(argv[4], NULL, 10) : 0;
+    totalGames += first_seed;
+
+    // Deal the batches round-robin, stealing evens out whatever is left
+    queues = std::vector<work_queue_t>(threads);
+    uint64_t batches = 0;
+    for (uint64_t seed = first_seed; seed < totalGames; seed += BATCH_GAMES)
+        queues[batches++ % threads].batches.push_back(seed);
+
+    std::vector<sim_stats_t> stats(threads);
+    std::vector<std::thread> pool;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < threads; i++)
+    {
+        memset(&stats[i], 0, sizeof(sim_stats_t));
+        pool.emplace_back(worker, i, &stats[i]);
+    }
+    for (std::thread &thread : pool)
+        thread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    sim_stats_t total;
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < threads; i++)
+        merge(&total, &stats[i]);
+
+    double win_rate = total.games ? (double)total.wins / total.games : 0;
+    printf("board:          %dx%d, %d mines, safe first click %s\n", WIDTH, HEIGHT, NUM_BOMBS,
+           SAFE_FIRST_CLICK ? "on" : "off");
+    printf("first click:    %s\n", firstClickNames[firstClick]);
+    printf("games:          %llu on %d threads (%llu batches, %llu stolen)\n", (unsigned long long)total.games,
+           threads, (unsigned long long)total.batches, (unsigned long long)total.steals);
+    printf("win rate:       %.2f%% (+/- %.2f)\n", 100 * win_rate,
+           total.games ? 196 * sqrt(win_rate * (1 - win_rate) / total.games) : 0);
+    printf("lost on opening: %llu\n", (unsigned long long)total.lost_on_opening);
+    printf("per game:       %.2f shots, %.2f guesses, %.2f flags\n", (double)total.shots / total.games,
+           (double)total.guesses / total.games, (double)total.flags / total.games);
+    printf("kernel calls:   %llu (%d boards each)\n", (unsigned long long)total.kernel_calls, SOLVER_LANES);
+
+    static const char *const cascadeLabels[CASCADE_BUCKETS] = {"1", "2-3", "4-7", "8-15", "16-31", "32-63", "64-127", "128"};
+    print_histogram("cascade size (tiles opened per shot):", cascadeLabels, total.cascade_hist, CASCADE_BUCKETS);
+    static const char *const guessLabels[GUESS_BUCKETS] = {"0", "1", "2", "3", "4", "5", "6", "7+"};
+    print_histogram("guesses per game:", guessLabels, total.guess_hist, GUESS_BUCKETS);
+
+    printf("throughput:     %.0f games/s (%.2f s)\n", total.games / seconds, seconds);
+    if (total.unsound != 0)
+        printf("UNSOUND DEDUCTIONS: %llu\n", (unsigned long long)total.unsound);
+    return total.unsound == 0 ? 0 : 1;
+}
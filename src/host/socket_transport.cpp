@@ -0,0 +1,316 @@
+// Local socket backend of the transport interface, host builds only.
+//
+// One epoll thread plays the BLE stack: it accepts clients, splits what they
+// send into lines and reports them through the transport events. Notifications
+// are written from whichever thread sends them (the epoll thread for the echo,
+// the dispatch loop for replies), under the connection table lock.
+
+#include "socket_transport.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "board_state.h"
+#include "message_queue.h"
+
+#define SOCKET_LINE_BUFFER (MAX_MESSAGE_LENGTH * 4)
+#define SOCKET_MAX_EVENTS 64
+
+typedef struct
+{
+  int fd; // -1 when the slot is free
+  uint8_t mac[6];
+  size_t buffered;
+  char line[SOCKET_LINE_BUFFER];
+} socket_client_t;
+
+static socket_client_t clients[SOCKET_MAX_CONNECTIONS];
+static std::mutex clientsMutex; // fd of a slot vs. notifications from other threads
+
+static const transport_events_t *socketEvents = NULL;
+static int listenFd = -1;
+static int epollFd = -1;
+static int wakeFd = -1;
+static char unixPath[sizeof(((sockaddr_un *)0)->sun_path)];
+static std::thread eventThread;
+static std::atomic<bool> running(false);
+
+// Bumped from both threads
+static struct
+{
+  std::atomic<uint32_t> accepted, rejected, lines, notifications, notify_dropped;
+} socketStats;
+
+static int open_listener(const char *address)
+{
+  int fd = -1;
+  if (strncmp(address, "unix:", 5) == 0)
+  {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    snprintf(unixPath, sizeof(unixPath), "%s", address + 5);
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", unixPath);
+    unlink(unixPath);
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd >= 0 && bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+      close(fd);
+      fd = -1;
+    }
+  }
+  else if (strncmp(address, "tcp:", 4) == 0)
+  {
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)atoi(address + 4));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int one = 1;
+    if (fd >= 0)
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (fd >= 0 && bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+      close(fd);
+      fd = -1;
+    }
+  }
+  if (fd >= 0 && listen(fd, SOMAXCONN) != 0)
+  {
+    close(fd);
+    fd = -1;
+  }
+  return fd;
+}
+
+static void accept_clients()
+{
+  while (true)
+  {
+    int fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK);
+    if (fd < 0)
+      return; // EAGAIN: nothing more pending
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // Fails harmlessly on Unix sockets
+
+    int slot = -1;
+    {
+      std::lock_guard<std::mutex> lock(clientsMutex);
+      for (int i = 0; i < SOCKET_MAX_CONNECTIONS && slot < 0; i++)
+      {
+        if (clients[i].fd < 0)
+          slot = i;
+      }
+      if (slot >= 0)
+      {
+        clients[slot].fd = fd;
+        clients[slot].buffered = 0;
+      }
+    }
+    if (slot < 0)
+    {
+      socketStats.rejected++;
+      close(fd);
+      continue;
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.u32 = slot;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    socketStats.accepted++;
+    socketEvents->on_connect(clients[slot].mac, SOCKET_CONN_ID_BASE + slot);
+  }
+}
+
+static void drop_client(int slot)
+{
+  int fd;
+  {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    fd = clients[slot].fd;
+    clients[slot].fd = -1;
+  }
+  if (fd < 0)
+    return;
+  epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+  close(fd);
+  socketEvents->on_disconnect(clients[slot].mac, SOCKET_CONN_ID_BASE + slot);
+}
+
+// One line to one client, with its newline already in place
+static void send_line(uint32_t slot, const char *line, size_t length)
+{
+  std::lock_guard<std::mutex> lock(clientsMutex);
+  int fd = clients[slot].fd;
+  if (fd < 0)
+    return;
+  socketStats.notifications++;
+  if (send(fd, line, length, MSG_DONTWAIT | MSG_NOSIGNAL) != (ssize_t)length)
+    socketStats.notify_dropped++; // Like a lost notification, the client has to cope
+}
+
+// "?" reads the board state: answered right away with "=<hex bytes>", like
+// the stack answers a read of the state characteristic
+static void reply_state(uint32_t slot)
+{
+  const uint8_t *data;
+  uint32_t stamp;
+  size_t length = socketEvents->on_read(SOCKET_CONN_ID_BASE + slot, &data, &stamp);
+  char line[1 + 2 * BOARD_STATE_MAX_SIZE + 1];
+  line[0] = '=';
+  for (size_t i = 0; i < length; i++)
+  {
+    line[1 + 2 * i] = "0123456789abcdef"[data[i] >> 4];
+    line[2 + 2 * i] = "0123456789abcdef"[data[i] & 0x0F];
+  }
+  line[1 + 2 * length] = '\n';
+  send_line(slot, line, 2 + 2 * length);
+}
+
+static void read_client(int slot)
+{
+  socket_client_t *client = &clients[slot];
+  while (true)
+  {
+    ssize_t received = read(client->fd, client->line + client->buffered, SOCKET_LINE_BUFFER - client->buffered);
+    if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR))
+    {
+      drop_client(slot);
+      return;
+    }
+    if (received < 0)
+      return;
+    client->buffered += received;
+
+    // Every complete line is one write, like one characteristic write over BLE
+    size_t start = 0;
+    for (size_t i = 0; i < client->buffered; i++)
+    {
+      if (client->line[i] != '\n')
+        continue;
+      size_t length = i - start;
+      if (length > 0 && client->line[i - 1] == '\r')
+        length--;
+      if (length == 1 && client->line[start] == '?' && socketEvents->on_read != NULL)
+      {
+        reply_state(slot); // A read of the state characteristic, nothing is queued
+      }
+      else if (length > 0)
+      {
+        socketStats.lines++;
+        socketEvents->on_write(SOCKET_CONN_ID_BASE + slot, client->mac, (const uint8_t *)client->line + start, length);
+      }
+      start = i + 1;
+    }
+    if (start == 0 && client->buffered == SOCKET_LINE_BUFFER)
+      start = client->buffered; // Line too long for any command, throw it away
+    memmove(client->line, client->line + start, client->buffered - start);
+    client->buffered -= start;
+  }
+}
+
+static void event_loop()
+{
+  epoll_event events[SOCKET_MAX_EVENTS];
+  while (running)
+  {
+    int count = epoll_wait(epollFd, events, SOCKET_MAX_EVENTS, -1);
+    for (int i = 0; i < count; i++)
+    {
+      uint32_t slot = events[i].data.u32;
+      if (slot == UINT32_MAX - 1)
+        accept_clients();
+      else if (slot == UINT32_MAX)
+        continue; // end() wakes us up
+      else if (events[i].events & EPOLLIN)
+        read_client(slot); // Reads to EOF first, so a last line before a hang-up is kept
+      else if (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        drop_client(slot);
+    }
+  }
+}
+
+static bool socket_begin(const char *address, const transport_events_t *events)
+{
+  socketEvents = events;
+  for (int i = 0; i < SOCKET_MAX_CONNECTIONS; i++)
+  {
+    uint16_t conn_id = SOCKET_CONN_ID_BASE + i;
+    const uint8_t mac[6] = {0x02, 0x00, 0x00, 0x00, (uint8_t)(conn_id >> 8), (uint8_t)conn_id}; // Locally administered
+    memcpy(clients[i].mac, mac, sizeof(mac));
+    clients[i].fd = -1;
+  }
+
+  listenFd = open_listener(address);
+  if (listenFd < 0)
+  {
+    fprintf(stderr, "Cannot listen on %s: %s\n", address, strerror(errno));
+    return false;
+  }
+  epollFd = epoll_create1(0);
+  wakeFd = eventfd(0, EFD_NONBLOCK);
+
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.u32 = UINT32_MAX - 1;
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+  event.data.u32 = UINT32_MAX;
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+
+  running = true;
+  eventThread = std::thread(event_loop);
+  return true;
+}
+
+static void socket_notify(uint16_t conn_id, const uint8_t *data, size_t length)
+{
+  char line[MAX_MESSAGE_LENGTH * 2 + 1];
+  if (length > sizeof(line) - 1)
+    length = sizeof(line) - 1;
+  memcpy(line, data, length);
+  line[length] = '\n';
+  send_line(conn_id - SOCKET_CONN_ID_BASE, line, length + 1);
+}
+
+static void socket_end()
+{
+  if (!running)
+    return;
+  running = false;
+  uint64_t one = 1;
+  (void)!write(wakeFd, &one, sizeof(one));
+  eventThread.join();
+
+  for (int i = 0; i < SOCKET_MAX_CONNECTIONS; i++)
+    drop_client(i);
+  close(listenFd);
+  close(epollFd);
+  close(wakeFd);
+  if (unixPath[0] != '\0')
+    unlink(unixPath);
+}
+
+const transport_t socketTransport = {"socket", socket_begin, socket_notify, socket_end};
+
+void getSocketTransportStats(socket_transport_stats_t *stats)
+{
+  stats->accepted = socketStats.accepted;
+  stats->rejected = socketStats.rejected;
+  stats->lines = socketStats.lines;
+  stats->notifications = socketStats.notifications;
+  stats->notify_dropped = socketStats.notify_dropped;
+}
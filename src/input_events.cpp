@@ -0,0 +1,169 @@
+#include "input_events.h"
+
+#include <string.h>
+
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "clock_service.h"
+
+// Per-button debounce: a press fires on the first falling edge from IDLE, any
+// edge while BOUNCING restarts the quiet window, and the button only returns
+// to IDLE once it has been quiet for INPUT_DEBOUNCE_US.
+typedef enum
+{
+  BUTTON_IDLE,
+  BUTTON_BOUNCING,
+} button_state_t;
+
+typedef struct
+{
+  uint8_t state;
+  bool disabled;
+  int64_t last_edge;
+  int64_t enabled_at; // Presses stamped before this were made while disabled
+} button_t;
+
+static button_t buttons[INPUT_MAX_BUTTONS];
+
+static input_event_t inputEvents[INPUT_EVENT_CAPACITY];
+static_assert(sizeof(inputEvents) == INPUT_STATIC_BYTES, "memory_report.cpp counts the ring by INPUT_STATIC_BYTES");
+static int inputEventsHead = 0;
+static int inputEventsTail = 0;
+static input_stats_t inputStats;
+portMUX_TYPE inputEventsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t IRAM_ATTR pending_events()
+{
+  return (inputEventsHead - inputEventsTail + INPUT_EVENT_CAPACITY) % INPUT_EVENT_CAPACITY;
+}
+
+// Caller holds inputEventsMux
+static bool IRAM_ATTR push_event(uint8_t type, uint8_t button, uint16_t conn_id, int64_t timestamp)
+{
+  int nextHead = (inputEventsHead + 1) % INPUT_EVENT_CAPACITY;
+  if (nextHead == inputEventsTail)
+  {
+    inputStats.overflows++;
+    return false;
+  }
+  input_event_t *event = &inputEvents[inputEventsHead];
+  event->type = type;
+  event->button = button;
+  event->conn_id = conn_id;
+  event->timestamp = timestamp;
+  inputEventsHead = nextHead;
+  return true;
+}
+
+void IRAM_ATTR inputButtonEdge(uint8_t button, int64_t now)
+{
+  if (button >= INPUT_MAX_BUTTONS)
+    return;
+
+  portENTER_CRITICAL_ISR(&inputEventsMux);
+  button_t *b = &buttons[button];
+  if (b->state == BUTTON_BOUNCING && now - b->last_edge < INPUT_DEBOUNCE_US)
+  {
+    b->last_edge = now; // Still bouncing, restart the quiet window
+    inputStats.bounces++;
+  }
+  else
+  {
+    b->state = BUTTON_BOUNCING;
+    b->last_edge = now;
+    // Leave the room reserved for command markers untouched
+    if (pending_events() < INPUT_EVENT_CAPACITY - MAX_MESSAGES)
+    {
+      push_event(INPUT_EVENT_BUTTON, button, 0, now);
+      inputStats.presses++;
+    }
+    else
+    {
+      inputStats.overflows++;
+    }
+  }
+  portEXIT_CRITICAL_ISR(&inputEventsMux);
+}
+
+bool inputCommandQueued(uint16_t conn_id, int64_t now)
+{
+  portENTER_CRITICAL(&inputEventsMux);
+  bool pushed = push_event(INPUT_EVENT_COMMAND, 0, conn_id, now);
+  portEXIT_CRITICAL(&inputEventsMux);
+  return pushed;
+}
+
+// Caller holds inputEventsMux
+static bool filtered(const input_event_t *event)
+{
+  if (event->type != INPUT_EVENT_BUTTON)
+    return false;
+  const button_t *b = &buttons[event->button];
+  return b->disabled || event->timestamp < b->enabled_at;
+}
+
+bool inputNextEvent(input_event_t *event)
+{
+  bool found = false;
+
+  portENTER_CRITICAL(&inputEventsMux);
+  while (!found && inputEventsHead != inputEventsTail)
+  {
+    *event = inputEvents[inputEventsTail];
+    inputEventsTail = (inputEventsTail + 1) % INPUT_EVENT_CAPACITY;
+
+    if (filtered(event))
+    {
+      inputStats.filtered++;
+      continue;
+    }
+    found = true;
+  }
+  portEXIT_CRITICAL(&inputEventsMux);
+  return found;
+}
+
+bool inputTakeCommand()
+{
+  bool take = true;
+
+  portENTER_CRITICAL(&inputEventsMux);
+  while (inputEventsHead != inputEventsTail)
+  {
+    const input_event_t *event = &inputEvents[inputEventsTail];
+    if (event->type == INPUT_EVENT_BUTTON && !filtered(event))
+    {
+      take = false; // The press came first, loop() handles it before more commands
+      break;
+    }
+    inputEventsTail = (inputEventsTail + 1) % INPUT_EVENT_CAPACITY;
+    if (event->type == INPUT_EVENT_COMMAND)
+      break;
+    inputStats.filtered++;
+  }
+  portEXIT_CRITICAL(&inputEventsMux);
+  return take;
+}
+
+void inputSetButtonsEnabled(uint32_t mask, bool enabled)
+{
+  int64_t now = clockNow();
+
+  portENTER_CRITICAL(&inputEventsMux);
+  for (int i = 0; i < INPUT_MAX_BUTTONS; i++)
+  {
+    if (!(mask & (1u << i)) || buttons[i].disabled == !enabled)
+      continue;
+    buttons[i].disabled = !enabled;
+    if (enabled)
+      buttons[i].enabled_at = now;
+  }
+  portEXIT_CRITICAL(&inputEventsMux);
+}
+
+void getInputStats(input_stats_t *stats)
+{
+  portENTER_CRITICAL(&inputEventsMux);
+  *stats = inputStats;
+  portEXIT_CRITICAL(&inputEventsMux);
+}
@@ -0,0 +1,224 @@
+#include "load_generator.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+
+typedef struct
+{
+  uint8_t mac[6];
+  bool connected;
+  int64_t next_send_us;
+  int64_t next_burst_us;
+  int64_t next_churn_us;
+  int64_t retry_at_us; // NACK retry hint, nothing is sent before it
+  uint32_t credits;
+} loadgen_client_t;
+
+static loadgen_config_t config;
+static loadgen_hooks_t hooks;
+static loadgen_client_t clients[LOADGEN_MAX_CLIENTS];
+static loadgen_report_t report;
+static int64_t start_us;
+static int64_t now_cached_us; // time of the step in progress, for notifications
+// Notifications may come from loop() while the step runs in the BLE-side task
+static portMUX_TYPE loadgenMux = portMUX_INITIALIZER_UNLOCKED;
+
+static const uint8_t commands[] = {'L', 'R', 'U', 'D', 'S'};
+
+static inline int64_t next_event_us(int64_t now_us, uint32_t rate_hz)
+{
+  return rate_hz ? now_us + 1000000 / rate_hz : INT64_MAX;
+}
+
+static inline uint16_t conn_id_of(const loadgen_client_t *client)
+{
+  return LOADGEN_CONN_ID_BASE + (client - clients);
+}
+
+static bool is_active(const loadgen_client_t *client)
+{
+  return hooks.has_turn(conn_id_of(client));
+}
+
+static void send_command(loadgen_client_t *client, int64_t now_us)
+{
+  if (config.flow_control)
+  {
+    bool allowed;
+    portENTER_CRITICAL(&loadgenMux);
+    allowed = client->credits > 0 && now_us >= client->retry_at_us;
+    if (allowed)
+      client->credits--;
+    portEXIT_CRITICAL(&loadgenMux);
+    if (!allowed)
+    {
+      report.deferred++;
+      return;
+    }
+  }
+
+  uint8_t command = commands[esp_random() % sizeof(commands)];
+  if (!is_active(client))
+    report.out_of_turn++;
+  report.offered++;
+  if (!hooks.on_write(conn_id_of(client), client->mac, &command, 1))
+    report.dropped++;
+}
+
+void loadgenOnNotify(uint16_t conn_id, const uint8_t *data, size_t length)
+{
+  uint32_t index = conn_id - LOADGEN_CONN_ID_BASE;
+  if (conn_id < LOADGEN_CONN_ID_BASE || index >= config.clients || length == 0)
+    return;
+  loadgen_client_t *client = &clients[index];
+
+  char text[24];
+  if (length >= sizeof(text))
+    length = sizeof(text) - 1;
+  memcpy(text, data, length);
+  text[length] = '\0';
+
+  unsigned credits, retry_ms, depth;
+  char command;
+  portENTER_CRITICAL(&loadgenMux);
+  if (sscanf(text, "+%u,%u", &credits, &depth) == 2)
+  {
+    client->credits += credits;
+  }
+  else if (sscanf(text, "!%c,%u,%u", &command, &retry_ms, &depth) == 3)
+  {
+    report.nacked++;
+    client->retry_at_us = now_cached_us + retry_ms * 1000;
+    client->credits++; // The rejected command did not use up a slot
+  }
+  else if (text[0] == '~')
+  {
+    report.turn_rejected++;
+    client->credits++; // Rejected before it took a credit
+  }
+  portEXIT_CRITICAL(&loadgenMux);
+}
+
+void loadgenBegin(const loadgen_config_t *cfg, const loadgen_hooks_t *h, int64_t now_us)
+{
+  config = *cfg;
+  now_cached_us = now_us;
+  if (config.clients > LOADGEN_MAX_CLIENTS)
+    config.clients = LOADGEN_MAX_CLIENTS;
+  hooks = *h;
+  memset(&report, 0, sizeof(report));
+  resetMessageQueueStats();
+  start_us = now_us;
+
+  for (uint32_t i = 0; i < config.clients; i++)
+  {
+    loadgen_client_t *client = &clients[i];
+    // Locally administered addresses, never clash with a real phone
+    const uint8_t mac[6] = {0x02, 0x4C, 0x47, 0x00, 0x00, (uint8_t)i};
+    memcpy(client->mac, mac, sizeof(mac));
+    client->connected = false;
+    client->credits = 0;
+    client->retry_at_us = 0;
+    // Spread the clients over one period so they do not fire in lockstep
+    client->next_send_us = now_us + esp_random() % 10000;
+    client->next_burst_us = config.burst_period_ms ? now_us + esp_random() % (config.burst_period_ms * 1000) : INT64_MAX;
+    client->next_churn_us = config.churn_period_ms ? now_us + esp_random() % (config.churn_period_ms * 1000) : INT64_MAX;
+
+    hooks.on_connect(client->mac, conn_id_of(client));
+    client->connected = true;
+    report.connects++;
+  }
+}
+
+bool loadgenStep(int64_t now_us)
+{
+  if (now_us - start_us >= (int64_t)config.duration_ms * 1000)
+    return false;
+  now_cached_us = now_us;
+
+  for (uint32_t i = 0; i < config.clients; i++)
+  {
+    loadgen_client_t *client = &clients[i];
+
+    if (now_us >= client->next_churn_us)
+    {
+      // Drop the link, come back on the next churn event
+      if (client->connected)
+      {
+        hooks.on_disconnect(client->mac, conn_id_of(client));
+        report.disconnects++;
+      }
+      else
+      {
+        portENTER_CRITICAL(&loadgenMux);
+        client->credits = 0; // A new connection starts from the window it is granted
+        portEXIT_CRITICAL(&loadgenMux);
+        hooks.on_connect(client->mac, conn_id_of(client));
+        report.connects++;
+      }
+      client->connected = !client->connected;
+      client->next_churn_us = now_us + (client->connected ? config.churn_period_ms * 1000 : 200000);
+    }
+    if (!client->connected)
+      continue;
+
+    if (now_us >= client->next_burst_us)
+    {
+      for (uint32_t b = 0; b < config.burst_size; b++)
+        send_command(client, now_us);
+      client->next_burst_us = now_us + config.burst_period_ms * 1000;
+    }
+
+    if (client->next_send_us == INT64_MAX && is_active(client))
+      client->next_send_us = now_us; // Silent out of turn, the turn just came back
+
+    if (now_us >= client->next_send_us)
+    {
+      send_command(client, now_us);
+      client->next_send_us = next_event_us(now_us, is_active(client) ? config.rate_hz : config.out_of_turn_rate_hz);
+    }
+  }
+  return true;
+}
+
+void loadgenEnd(loadgen_report_t *out, int64_t now_us)
+{
+  for (uint32_t i = 0; i < config.clients; i++)
+  {
+    if (clients[i].connected)
+    {
+      hooks.on_disconnect(clients[i].mac, conn_id_of(&clients[i]));
+      clients[i].connected = false;
+      report.disconnects++;
+    }
+  }
+  report.elapsed_ms = (now_us - start_us) / 1000;
+  getMessageQueueStats(&report.queue);
+  *out = report;
+}
+
+size_t loadgenFormatReport(const loadgen_report_t *r, char *buffer, size_t size)
+{
+  double seconds = r->elapsed_ms ? r->elapsed_ms / 1000.0 : 1.0;
+  return snprintf(buffer, size,
+                  "elapsed:       %u ms\n"
+                  "offered:       %u (%.1f/s, %u out of turn)\n"
+                  "throughput:    %u dequeued (%.1f/s)\n"
+                  "dropped:       %u (%.1f%%, %u NACKed, %u out of turn), queue max depth %u\n"
+                  "deferred:      %u (no credit)\n"
+                  "connects:      %u, disconnects %u\n"
+                  "latency (us):  p50 %lld, p99 %lld, p99.9 %lld, max %lld\n",
+                  (unsigned)r->elapsed_ms,
+                  (unsigned)r->offered, r->offered / seconds, (unsigned)r->out_of_turn,
+                  (unsigned)r->queue.dequeued, r->queue.dequeued / seconds,
+                  (unsigned)r->dropped, r->offered ? 100.0 * r->dropped / r->offered : 0.0, (unsigned)r->nacked, (unsigned)r->turn_rejected,
+                  (unsigned)r->queue.max_depth, (unsigned)r->deferred,
+                  (unsigned)r->connects, (unsigned)r->disconnects,
+                  (long long)messageQueueLatencyPercentile(&r->queue, 500),
+                  (long long)messageQueueLatencyPercentile(&r->queue, 990),
+                  (long long)messageQueueLatencyPercentile(&r->queue, 999),
+                  (long long)r->queue.latency_max_us);
+}
@@ -1,9 +1,5 @@
 #include <Arduino.h>
 
-#include <BLEDevice.h>
-#include <BLEServer.h>
-#include <BLE2902.h>
-
 #include <TFT_eSPI.h>
 #include <SPI.h>
 
@@ -11,452 +7,680 @@
 // #define TFT_HEIGHT 160
 #include "minesweeper.h"
 #include "bt_commands.h"
+#include "message_queue.h"
+#include "players.h"
+#include "session.h"
+#include "board_pool.h"
+#include "board_state.h"
+#include "player_cache.h"
+#include "transport.h"
+#include "ble_transport.h"
+#include "flow_control.h"
+#include "load_generator.h"
+#include "diagnostics.h"
+#include "alloc_stats.h"
+#include "memory_report.h"
+#include "power.h"
+#include "input_events.h"
+#include "render_scheduler.h"
+#include "ui_widgets.h"
+#include "stall_monitor.h"
+#include "trace.h"
+#include "audio_output.h"
+#include "melodies.h"
+
+#include "clock_service.h"
 
 TFT_eSPI tft = TFT_eSPI();
 
-volatile uint8_t shouldRedrawMap = 0;
+uint8_t shouldRedrawMap = 0;
 bool formerDisplayMenu = false;
 
-// Check if Bluetooth Serial is properly supported
-#if !defined(CONFIG_BT_ENABLED) || !defined(CONFIG_BLUEDROID_ENABLED)
-#error Bluetooth is not enabled! Please run `make menuconfig` and enable Bluetooth Classic.
-#endif
-
 #define BAUD_RATE 9600
+#define TRACE_DUMP_POLL_MS 50 // About one trace line at BAUD_RATE
 
 // Global variables
-bool deviceConnected = false;
-bool oldDeviceConnected = false;
-
-struct device_connected_t
-{
-  esp_bd_addr_t remote_bda; // Remote Bluetooth device address
-  char name[10];
-};
-
-device_connected_t devices[2]; // Structure to hold connected device information
-uint32_t devices_size = 0;
-
 // Keep track of connected clients (in Classic BT we'll have just one active client)
 uint8_t connectedAddress[6] = {0};
 bool hasConnectedClient = false;
 
-// Queue for handling messages
-#define MAX_MESSAGES 10
-#define MAX_MESSAGE_LENGTH 20
-typedef struct
-{
-  uint8_t handle[6]; // Mac address of the device who sent the msg
-  uint16_t length;
-  uint8_t data[MAX_MESSAGE_LENGTH];
-} message_t;
-
-message_t messageQueue[MAX_MESSAGES];
-int messageQueueHead = 0;
-int messageQueueTail = 0;
-portMUX_TYPE messageQueueMux = portMUX_INITIALIZER_UNLOCKED;
-
-Minesweeper game;
-int playerTurn = 0;
+int selectedSession = 0; // Session shown on the display
 volatile bool gameStarted = false;
 volatile bool displayMenu = true;
 
-#define SERVICE_UUID "4fafc201-1fb5-459e-8fcc-c5c9c331914b"
-#define CHARACTERISTIC_UUID "beb5483e-36e1-4688-b7f5-ea07361b26a8"
+#define DEVICE_NAME "HoriaESP32"
 
-//--------------------------------------------START OF MESSAGE QUEUE CODE--------------------------------------------
+//--------------------------------------------START OF CONNECTION LAYER CODE--------------------------------------------
 
-// Function to add message to queue to be handled fby main loop
-bool addMessageToQueue(uint8_t mac_addr[6], uint8_t *data, size_t length)
+// Notify a single connection, through whichever transport it came in on
+void notifyConnection(uint16_t conn_id, const uint8_t *data, size_t length)
 {
-  if (length > MAX_MESSAGE_LENGTH)
+  transportNotify(conn_id, data, length);
+}
+
+// Connection-layer entry points, called by every transport (BLE, load generator)
+
+void onDeviceConnected(const uint8_t mac_addr[6], uint16_t conn_id)
+{
+  portENTER_CRITICAL(&sessionMux);
+  bool seated = sessionOfConnection(conn_id) != NULL;
+  portEXIT_CRITICAL(&sessionMux);
+  if (seated)
   {
-    length = MAX_MESSAGE_LENGTH; // Truncate if too long
+    // Device already exists in the list
+    return;
   }
+  int64_t connectedAt = clockNow();
+  bool restored;
+  session_t *session = joinSession(mac_addr, conn_id, &restored);
+  if (session != NULL)
+  {
+    flowControlConnected(conn_id, notifyConnection);
+    if (restored)
+    {
+      // Seat, turn, name and cursor were held, the credits just granted make it playable
+      sessionReconnectPlayable(clockNow() - connectedAt);
+      Serial.printf("Restored seat in session %d\n", sessionIndex(session) + 1);
+    }
+    else
+    {
+      Serial.printf("Seated in session %d\n", sessionIndex(session) + 1);
+    }
+    renderRequest(RENDER_SCREEN); // Status bar or menu
+    powerWake();
+    formerDisplayMenu = false; // Reset display menu flag
+  }
+  else
+  {
+    Serial.println("All sessions are full, cannot add new device");
+  }
+}
 
-  portENTER_CRITICAL(&messageQueueMux);
-  int nextHead = (messageQueueHead + 1) % MAX_MESSAGES;
+void onDeviceDisconnected(const uint8_t mac_addr[6], uint16_t conn_id)
+{
+  // The seat is held for a reconnect; the menu only comes up if the grace period runs out
+  session_t *session = leaveSession(conn_id);
+  if (session != NULL)
+  {
+    Serial.printf("Holding seat in session %d for %d s\n", sessionIndex(session) + 1, SESSION_GRACE_US / 1000000);
+    renderRequest(RENDER_SCREEN); // Mark the player away
+    formerDisplayMenu = false; // Reset display menu flag
+    powerWake();
+  }
+}
 
-  if (nextHead == messageQueueTail)
+bool onCommandReceived(uint16_t conn_id, const uint8_t mac_addr[6], const uint8_t *data, size_t length)
+{
+  // Add to message queue, the sender gets either the echo or a NACK with a retry hint
+  if (!flowControlSubmit(conn_id, mac_addr, data, length, notifyConnection))
   {
-    // Queue is full
-    portEXIT_CRITICAL(&messageQueueMux);
+    Serial.println("No credit left for this device, command rejected");
     return false;
   }
+  if (!inputCommandQueued(conn_id, clockNow()))
+  {
+    // No room for its marker: loop() still serves it once no event is left ahead of it
+    Serial.println("Input stream full, command queued without a marker");
+  }
+  powerWake(); // loop() picks the command up right away instead of at its next poll
+  return true;
+}
 
-  // messageQueue[messageQueueHead].handle = handle;
-  memcpy(messageQueue[messageQueueHead].handle, mac_addr, sizeof(messageQueue[messageQueueHead].handle));
-  messageQueue[messageQueueHead].length = length;
-  memcpy(messageQueue[messageQueueHead].data, data, length);
+// Read of the state characteristic, in the BLE task; encodes only if the game moved since the last read
+size_t onStateRead(uint16_t conn_id, const uint8_t **data, uint32_t *stamp)
+{
+  portENTER_CRITICAL(&sessionMux);
+  session_t *session = sessionOfConnection(conn_id);
+  portEXIT_CRITICAL(&sessionMux);
+  return session != NULL ? boardStateRead(session, data, stamp) : 0; // Sessions never move, only seats do
+}
 
-  messageQueueHead = nextHead;
-  portEXIT_CRITICAL(&messageQueueMux);
-  return true;
+// What every transport reports into
+const transport_events_t connectionEvents = {onDeviceConnected, onDeviceDisconnected, onCommandReceived, onStateRead};
+static_assert(BLE_CONN_ID_BASE + BLE_MAX_CONNECTIONS <= LOADGEN_CONN_ID_BASE, "BLE and simulated conn ids must not overlap");
+
+//--------------------------------------------END OF CONNECTION LAYER CODE--------------------------------------------
+
+//---------------------------------------------START OF ISRs CODE--------------------------------------------
+
+// The buttons only feed the input stream, loop() acts on the debounced presses
+enum Button
+{
+  BUTTON_RESET, // GPIO0: total reset of the game
+  BUTTON_MARK,  // GPIO2: mark as bomb, or pick the session in the menu
+  BUTTON_MENU,  // GPIO32: start game and pause
+};
+#define ALL_BUTTONS ((1u << BUTTON_RESET) | (1u << BUTTON_MARK) | (1u << BUTTON_MENU))
+
+// By Button; also the wake-up pins of light sleep, in the same order
+static const uint8_t buttonPins[] = {GPIO_NUM_0, GPIO_NUM_2, GPIO_NUM_32};
+
+// ISR for pressing GPIO0 button
+void IRAM_ATTR buttonISR_GPIO0()
+{
+  inputButtonEdge(BUTTON_RESET, clockNow());
+  powerWakeFromISR();
 }
 
-// Function to get message from queue
-bool getMessageFromQueue(message_t *message)
+// Mark as bomb button on GPIO2
+void IRAM_ATTR buttonISR_GPIO2()
 {
-  portENTER_CRITICAL(&messageQueueMux);
-  if (messageQueueHead == messageQueueTail)
-  {
-    // Queue is empty
-    portEXIT_CRITICAL(&messageQueueMux);
-    return false;
-  }
+  inputButtonEdge(BUTTON_MARK, clockNow());
+  powerWakeFromISR();
+}
 
-  *message = messageQueue[messageQueueTail];
-  messageQueueTail = (messageQueueTail + 1) % MAX_MESSAGES;
-  portEXIT_CRITICAL(&messageQueueMux);
-  return true;
+// Handle Menu: Start game and pause on GPIO32
+void IRAM_ATTR buttonISR_GPIO32()
+{
+  inputButtonEdge(BUTTON_MENU, clockNow());
+  powerWakeFromISR();
 }
 
-//--------------------------------------------END OF MESSAGE QUEUE CODE--------------------------------------------
+//---------------------------------------------END OF ISRs CODE--------------------------------------------
 
-//--------------------------------------------START OF BLUETOOTH CONNECTION CODE--------------------------------------------
+//---------------------------------------------START OF TFT DRAWING CODE--------------------------------------------
 
-class MyServerCallbacks : public BLEServerCallbacks
+const char *currentPlayerName(session_t *session)
 {
-  void onConnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param)
-  {
-    deviceConnected = true;
-    BLEDevice::startAdvertising();
-    // Get mac address of the connected device
-    esp_bd_addr_t *addr = (esp_bd_addr_t *)param->connect.remote_bda;
-    char mac[18];
-    snprintf(mac, sizeof(mac), "%02X:%02X:%02X:%02X:%02X:%02X",
-             (*addr)[0], (*addr)[1], (*addr)[2],
-             (*addr)[3], (*addr)[4], (*addr)[5]);
-    Serial.print("Connected to device with MAC: ");
-    Serial.println(mac);
+  device_connected_t *player = currentPlayer(session);
+  return player != NULL ? player->name : "-";
+}
 
-    for (int i = 0; i < devices_size; i++)
-    {
-      if (memcmp(devices[i].remote_bda, addr, sizeof(esp_bd_addr_t)) == 0)
-      {
-        // Device already exists in the list
-        return;
-      }
-    }
-    if (devices_size < sizeof(devices) / sizeof(devices[0]))
-    {
-      // Add new device to the list
-      memcpy(devices[devices_size].remote_bda, addr, sizeof(esp_bd_addr_t));
-
-      char _name[10];
-      sprintf(_name, "Device %d", devices_size + 1);
-      size_t _name_len = strnlen(_name, 9);
-      strncpy(devices[devices_size].name, _name, _name_len);
-      devices[devices_size].name[_name_len] = '\0'; // Ensure null termination
-      devices_size++;
-      formerDisplayMenu = false; // Reset display menu flag
-    }
-    else
-    {
-      Serial.println("Device list is full, cannot add new device");
-    }
-  };
+// Retained widgets: each screen is cleared once when it is entered, after that
+// only labels whose text changed are repainted.
+
+#define STATUS_BAR_Y (13 * 16)
+#define MENU_ROWS (MAX_SESSIONS * (1 + MAX_PLAYERS)) // A line per session and one per seat
+
+// Longest text of each row format below, with the terminator, so no row is cut
+#define MENU_SESSION_TEXT sizeof("> S9 playing, real time")
+#define MENU_SEAT_TEXT (sizeof("  ") - 1 + PLAYER_NAME_LENGTH - 1 + sizeof(" (00:00:00:00:00:00) away"))
+#define STATUS_TURN_TEXT (sizeof("Real time: ") - 1 + PLAYER_NAME_LENGTH - 1 + sizeof(" (away)"))
+static_assert(MAX_SESSIONS <= 9, "MENU_SESSION_TEXT has room for one digit");
+static_assert(MENU_SESSION_TEXT <= UI_LABEL_TEXT && MENU_SEAT_TEXT <= UI_LABEL_TEXT &&
+                  STATUS_TURN_TEXT <= UI_LABEL_TEXT,
+              "UI_LABEL_TEXT must hold the longest menu and status rows");
+
+ui_label_t statusTurn, statusOther, statusSession;
+ui_label_t *const gameLabels[] = {&statusTurn, &statusOther, &statusSession};
+ui_screen_t gameScreen = {TFT_CYAN, gameLabels, 3};
 
-  void onDisconnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param)
+ui_label_t menuTitle, menuHint, menuHeader, menuRows[MENU_ROWS];
+ui_label_t *menuLabels[3 + MENU_ROWS] = {&menuTitle, &menuHint, &menuHeader};
+ui_screen_t menuScreen = {TFT_CYAN, menuLabels, 3 + MENU_ROWS};
+
+ui_label_t lostTitle, lostName, lostExit;
+ui_label_t *const lostLabels[] = {&lostTitle, &lostName, &lostExit};
+ui_screen_t lostScreen = {TFT_RED, lostLabels, 3};
+
+ui_label_t wonTitle, wonName, wonExit;
+ui_label_t *const wonLabels[] = {&wonTitle, &wonName, &wonExit};
+ui_screen_t wonScreen = {TFT_GREEN, wonLabels, 3};
+
+void init_ui()
+{
+  uiLabelInit(&statusTurn, 2, STATUS_BAR_Y, 1, TFT_RED, TFT_CYAN);
+  uiLabelInit(&statusOther, 2, STATUS_BAR_Y + 16, 1, TFT_BLACK, TFT_CYAN);
+  uiLabelInit(&statusSession, tft.width() - 14, STATUS_BAR_Y + 16, 1, TFT_BLACK, TFT_CYAN);
+
+  uiLabelInit(&menuTitle, 10, 10, 3, TFT_BLACK, TFT_CYAN);
+  uiLabelPrintf(&menuTitle, "Menu");
+  uiLabelInit(&menuHint, 3, 50, 2, TFT_BLACK, TFT_CYAN);
+  uiLabelPrintf(&menuHint, "Press again to resume");
+  uiLabelInit(&menuHeader, 2, 90, 1, TFT_BLACK, TFT_CYAN);
+  uiLabelPrintf(&menuHeader, "Sessions (GPIO2 selects):");
+  for (int i = 0; i < MENU_ROWS; i++)
   {
-    Serial.print("Device disconnected: ");
-    esp_bd_addr_t *addr = (esp_bd_addr_t *)param->connect.remote_bda;
-    char mac[18];
-    snprintf(mac, sizeof(mac), "%02X:%02X:%02X:%02X:%02X:%02X",
-             (*addr)[0], (*addr)[1], (*addr)[2],
-             (*addr)[3], (*addr)[4], (*addr)[5]);
-    Serial.println(mac);
-    deviceConnected = false;
+    uiLabelInit(&menuRows[i], 2, 102 + 10 * i, 1, TFT_BLACK, TFT_CYAN);
+    menuLabels[3 + i] = &menuRows[i];
+  }
 
-    // Remove device from the list
-    for (int i = 0; i < devices_size; i++)
-    {
-      if (memcmp(devices[i].remote_bda, addr, sizeof(esp_bd_addr_t)) == 0)
-      {
-        // Shift remaining devices down
-        for (int j = i; j < devices_size - 1; j++)
-        {
-          memcpy(&devices[j], &devices[j + 1], sizeof(device_connected_t));
-        }
-        devices_size--;
-        // display the menu when someone disconnects
-        displayMenu = true;
-        formerDisplayMenu = false; // Reset display menu flag
+  uiLabelInit(&lostTitle, 10, 10, 2, TFT_WHITE, TFT_RED);
+  uiLabelPrintf(&lostTitle, "Game Over");
+  uiLabelInit(&lostName, 10, 50, 2, TFT_WHITE, TFT_RED);
+  uiLabelInit(&lostExit, 10, 90, 1, TFT_WHITE, TFT_RED);
 
-        playerTurn = 0; // Reset player turn
+  uiLabelInit(&wonTitle, 10, 10, 2, TFT_BLACK, TFT_GREEN);
+  uiLabelPrintf(&wonTitle, "You Won!");
+  uiLabelInit(&wonName, 10, 50, 2, TFT_BLACK, TFT_GREEN);
+  uiLabelInit(&wonExit, 10, 90, 1, TFT_BLACK, TFT_GREEN);
+}
 
-        break;
-      }
-    }
+void update_status_bar()
+{
+  session_t *session = &sessions[selectedSession];
+  uiLabelPrintf(&statusSession, "S%d", selectedSession + 1);
+
+  if (session->players.size == 0)
+  {
+    uiLabelPrintf(&statusTurn, "No devices connected");
+    uiLabelPrintf(&statusOther, "%s", "");
+    return;
   }
 
-  void onWrite(BLECharacteristic *pCharacteristic, esp_ble_gatts_cb_param_t *param)
+  if (session->realtime)
   {
-    std::string value = pCharacteristic->getValue();
-    if (value.length() > 0)
-    {
-      Serial.print("Received Value: ");
-      Serial.print(value.c_str());
-      Serial.printf(" From MAC: %02X:%02X:%02X:%02X:%02X:%02X\n",
-                    param->write.bda[0], param->write.bda[1],
-                    param->write.bda[2], param->write.bda[3],
-                    param->write.bda[4], param->write.bda[5]);
-      // Send back the received value
-      pCharacteristic->setValue(value);
-      pCharacteristic->notify();
-      Serial.println();
-      // Add to message queue
-      if (!addMessageToQueue(param->write.bda, (uint8_t *)value.c_str(), value.length()))
-      {
-        Serial.println("Message queue is full, dropping message");
-      }
-    }
+    // Nobody has the turn: the first seat's cursor is orange, the second's magenta
+    device_connected_t *first = &session->players.devices[0];
+    uiLabelPrintf(&statusTurn, "Real time: %s%s", first->name, playerAway(first) ? " (away)" : "");
+    device_connected_t *second = session->players.size > 1 ? &session->players.devices[1] : NULL;
+    uiLabelPrintf(&statusOther, "%s%s", second != NULL ? second->name : "",
+                  second != NULL && playerAway(second) ? " (away)" : "");
+    return;
   }
-};
 
-BLEServer *pServer = NULL;
-BLECharacteristic *pCharacteristic = NULL;
-class MyCallbacks : public BLECharacteristicCallbacks
+  device_connected_t *turn = currentPlayer(session);
+  uiLabelPrintf(&statusTurn, "%s *%s", turn->name, playerAway(turn) ? " (away)" : "");
+  if (session->players.size == 1)
+  {
+    uiLabelPrintf(&statusOther, "%s", "");
+  }
+  else
+  {
+    device_connected_t *other = &session->players.devices[1 - session->player_turn];
+    uiLabelPrintf(&statusOther, "%s%s", other->name, playerAway(other) ? " (away)" : "");
+  }
+}
+
+void update_menu()
 {
-  void onWrite(BLECharacteristic *pCharacteristic, esp_ble_gatts_cb_param_t *param)
+  int row = 0;
+  for (int s = 0; s < MAX_SESSIONS; s++)
   {
-    std::string value = pCharacteristic->getValue();
-    if (value.length() > 0)
+    session_t *session = &sessions[s];
+    uiLabelPrintf(&menuRows[row++], "%c S%d %s%s", s == selectedSession ? '>' : ' ', s + 1,
+                  session->players.size == MAX_PLAYERS ? "playing" : session->players.size ? "waiting" : "free",
+                  session->realtime ? ", real time" : "");
+    for (int i = 0; i < MAX_PLAYERS; i++)
     {
-      Serial.print("Received Value: ");
-      for (int i = 0; i < value.length(); i++)
-      {
-        Serial.print(value[i]);
-      }
-      // Send back the received value
-      Serial.printf(" From MAC: %02X:%02X:%02X:%02X:%02X:%02X\n",
-                    param->write.bda[0], param->write.bda[1],
-                    param->write.bda[2], param->write.bda[3],
-                    param->write.bda[4], param->write.bda[5]);
-      // Send back the received value
-      // Add to message queue
-      if (!addMessageToQueue(param->write.bda, (uint8_t *)value.c_str(), value.length()))
+      if (i >= session->players.size)
       {
-        Serial.println("Message queue is full, dropping message");
+        uiLabelPrintf(&menuRows[row++], "%s", "");
+        continue;
       }
-      pCharacteristic->setValue(value);
-      pCharacteristic->notify();
-      Serial.println();
+      device_connected_t *device = &session->players.devices[i];
+      uiLabelPrintf(&menuRows[row++], "  %s (%02X:%02X:%02X:%02X:%02X:%02X)%s",
+                    device->name,
+                    device->remote_bda[0], device->remote_bda[1],
+                    device->remote_bda[2], device->remote_bda[3],
+                    device->remote_bda[4], device->remote_bda[5],
+                    playerAway(device) ? " away" : "");
     }
   }
-};
+}
 
-//--------------------------------------------END OF BLUETOOTH CONNECTION CODE--------------------------------------------
+void render_frame(uint32_t flags)
+{
+  TraceScope span(TRACE_RENDER);
+  ui_screen_t *screen = uiCurrentScreen();
+  if (screen == &menuScreen)
+    update_menu();
+  else if (screen == &gameScreen)
+    update_status_bar();
+
+  bool cleared = uiRender(tft);
+
+  // The board is not a widget: all of it after a clear, otherwise only the tiles that changed
+  session_t *session = &sessions[selectedSession];
+  if (screen == &gameScreen && cleared)
+    session->game.draw_map(tft, session->show_hints);
+  else if (screen == &gameScreen && (flags & RENDER_MAP))
+    session->game.draw_changes(tft, session->show_hints);
+}
 
-//---------------------------------------------START OF ISRs CODE--------------------------------------------
+// ---------------------------------------------END OF TFT DRAWING CODE--------------------------------------------
+
+// The buzzer is on GPIO25, DAC channel 1; the tunes are in src/melodies.cpp
+
+//---------------------------------------------START OF LOAD GENERATOR SELF-TEST CODE--------------------------------------------
 
-// https://circuitdigest.com/microcontroller-projects/esp32-timers-and-timer-interrupts
-// Setup one second timer
-hw_timer_t *my_timer = NULL;
-volatile uint32_t timerCounter = 0; // this increments every milisecond
-void IRAM_ATTR timerISR()
+// Simulated clients go through the same entry points as the BLE callbacks,
+// while loop() keeps dispatching as usual. Started from the serial console:
+//   loadgen [clients] [rate_hz] [spam_hz] [seconds]
+
+static_assert(LOADGEN_CONN_ID_BASE + LOADGEN_MAX_CLIENTS <= MAX_CONNECTIONS, "Simulated clients need routing entries");
+
+volatile bool loadgenRunning = false;
+
+const loadgen_hooks_t loadgenHooks = {onDeviceConnected, onDeviceDisconnected, onCommandReceived, sessionHasTurn};
+
+// Simulated clients are driven by loadgenStep(), the transport only routes their notifications back
+const transport_t loadgenTransport = {"loadgen", NULL, loadgenOnNotify, NULL};
+
+#define LOADGEN_REPORT_TEXT 512
+static_assert(LOADGEN_REPORT_TEXT + sizeof(loadgen_report_t) <= LOADGEN_TASK_STACK / 2,
+              "the final report is formatted on the load generator's stack");
+
+void loadgenTask(void *parameter)
 {
-  timerCounter++;
-}
+  // Runs next to the BLE stack task, at the rate the simulated clients need
+  static int stall = stallRegister("loadgen"); // One slot for every run
+  while (loadgenStep(clockNow()))
+  {
+    stallSection(stall, NULL);
+    vTaskDelay(1);
+    stallHeartbeat(stall);
+    stallSection(stall, "loadgen step");
+  }
 
-volatile uint32_t lastButtonPressTime = 0; // Last time a button was pressed
+  loadgen_report_t report;
+  loadgenEnd(&report, clockNow());
+  char text[LOADGEN_REPORT_TEXT];
+  loadgenFormatReport(&report, text, sizeof(text));
+  Serial.print(text);
 
-// ISR for pressing GPIO0 button
-void IRAM_ATTR buttonISR_GPIO0()
+  loadgenRunning = false;
+  vTaskDelete(NULL);
+}
+
+void diagnosticsLoadgen(const char *args)
 {
-  if (timerCounter - lastButtonPressTime < 300)
+  if (loadgenRunning)
   {
-    return; // Ignore button presses that are too close together
+    Serial.println("Load generator already running");
+    return;
   }
-  lastButtonPressTime = timerCounter; // Update last button press time
-  shouldRedrawMap = 1; // total reset the game
-  displayMenu = true;
-  formerDisplayMenu = false; // Reset display menu flag
-  playerTurn = 0;            // Reset player turn
+  loadgen_config_t config = LOADGEN_DEFAULT_CONFIG;
+  unsigned clients = config.clients, rate = config.rate_hz, spam = config.out_of_turn_rate_hz, seconds = config.duration_ms / 1000;
+  sscanf(args, "%u %u %u %u", &clients, &rate, &spam, &seconds);
+  config.clients = clients;
+  config.rate_hz = rate;
+  config.out_of_turn_rate_hz = spam;
+  config.duration_ms = seconds * 1000;
+
+  Serial.printf("Load generator: %u clients, %u/s in turn, %u/s out of turn, %u s\n", clients, rate, spam, seconds);
+  loadgenRunning = true;
+  loadgenBegin(&config, &loadgenHooks, clockNow());
+  xTaskCreate(loadgenTask, "loadgen", LOADGEN_TASK_STACK, NULL, 1, NULL);
 }
 
-// Marjk as bomb button on GPIO2
-volatile bool mark_as_bomb = false;
+//---------------------------------------------END OF LOAD GENERATOR SELF-TEST CODE--------------------------------------------
 
-void IRAM_ATTR buttonISR_GPIO2()
+void diagnosticsHeap(const char *args)
 {
-  if (timerCounter - lastButtonPressTime < 300)
+  alloc_stats_t stats;
+  getAllocStats(&stats);
+  Serial.printf("C++ allocations: %u, frees: %u, live: %u\n",
+                stats.allocations, stats.frees, stats.allocations - stats.frees);
+  Serial.printf("Allocations since the game started: %u\n", stats.allocations_since_baseline);
+  Serial.printf("Free heap: %u, minimum ever: %u\n", ESP.getFreeHeap(), ESP.getMinFreeHeap());
+}
+
+void diagnosticsMemory(const char *args)
+{
+  const memory_region_t *regions;
+  int count = getStaticMemory(&regions);
+  Serial.printf("Static tables: %u of %u bytes budgeted\n", getStaticMemoryTotal(), MEMORY_STATIC_BUDGET);
+  for (int i = 0; i < count; i++)
+    Serial.printf("  %-18s %6u\n", regions[i].name, regions[i].bytes);
+
+  memory_heap_t heap;
+  getHeapReport(&heap);
+  Serial.printf("Heap: %u total, %u free, high-water %u used, largest free block %u\n",
+                heap.total, heap.free, heap.total - heap.min_free, heap.largest_block);
+
+  memory_stack_t stacks[MEMORY_MAX_STACKS];
+  count = getStackReport(stacks, MEMORY_MAX_STACKS);
+  Serial.printf("%-10s %6s %6s\n", "task", "stack", "peak");
+  for (int i = 0; i < count; i++)
   {
-    return; // Ignore button presses that are too close together
+    if (!stacks[i].running)
+    {
+      Serial.printf("%-10s %6u %6s\n", stacks[i].task, stacks[i].stack_bytes, "-");
+      continue;
+    }
+    Serial.printf("%-10s %6u %6u%s\n", stacks[i].task, stacks[i].stack_bytes,
+                  stacks[i].stack_bytes - stacks[i].free_min,
+                  stacks[i].free_min < MEMORY_STACK_MARGIN ? "  under margin" : "");
   }
-  lastButtonPressTime = timerCounter; // Update last button press time
-  mark_as_bomb = true;
 }
 
-// Handke Menu: Start game and pause on GPIO32
-void IRAM_ATTR buttonISR_GPIO32()
+void diagnosticsPower(const char *args)
 {
-  if (timerCounter - lastButtonPressTime < 300)
+  if (strncmp(args, "reset", 5) == 0)
   {
-    return; // Ignore button presses that are too close together
+    resetPowerStats();
+    Serial.println("Power statistics reset");
+    return;
   }
-  lastButtonPressTime = timerCounter; // Update last button press time
-  displayMenu = !displayMenu; // Toggle menu display
+  power_stats_t stats;
+  getPowerStats(&stats);
+  uint64_t total = stats.active_us + stats.idle_us;
+  Serial.printf("Power management: %s\n", !stats.enabled ? "off (fixed clock)" : stats.light_sleep ? "frequency scaling + light sleep" : "frequency scaling");
+  Serial.printf("loop() active: %llu ms (%u%%), idle: %llu ms (%u%%)\n",
+                stats.active_us / 1000, total ? (unsigned)(stats.active_us * 100 / total) : 0,
+                stats.idle_us / 1000, total ? (unsigned)(stats.idle_us * 100 / total) : 0);
+  Serial.printf("Wake-ups: %u, latency avg %u us, max %u us, over %u us budget: %u\n",
+                stats.wakeups, stats.wakeups ? (unsigned)(stats.wake_latency_total_us / stats.wakeups) : 0,
+                stats.wake_latency_max_us, POWER_WAKE_BUDGET_US, stats.over_budget);
+  if (stats.light_sleep)
+    Serial.printf("Woken from light sleep by a button: %u\n", stats.button_wakeups);
 }
 
-//---------------------------------------------END OF ISRs CODE--------------------------------------------
-
-//---------------------------------------------START OF TFT DRAWING CODE--------------------------------------------
+int loopStall = -1;
+esp_timer_handle_t stallTimer = NULL;
 
-void draw_map(bool update_players_order = false)
+void stallTimerCallback(void *arg)
 {
-  // Clear the buttom of the screen for displaying player turn properly
-  if (update_players_order)
-    tft.fillRect(0, 13 * 16, tft.width(), tft.height() - 13 * 16, TFT_CYAN);
-
-  game.draw_map(tft);
-  tft.setTextSize(1);
-
-  tft.setCursor(2, 13 * 16);
+  stallCheck();
+}
 
-  if (devices_size == 0)
+void diagnosticsStalls(const char *args)
+{
+  if (strncmp(args, "reset", 5) == 0)
   {
-    tft.setTextColor(TFT_RED);
-    tft.printf("No devices connected");
-    tft.setTextColor(TFT_BLACK);
+    resetStallRecords();
+    Serial.println("Stall records reset");
     return;
   }
-
-  tft.setTextColor(TFT_RED);
-  tft.printf("%s *", devices[playerTurn].name);
-  tft.setTextColor(TFT_BLACK);
-  if (devices_size == 1)
+  const char *task;
+  stall_task_stats_t stats;
+  for (int slot = 0; getStallTaskStats(slot, &task, &stats); slot++)
   {
-    return;
+    Serial.printf("%-10s %u iterations, %u over %u us, longest %u us\n",
+                  task, stats.iterations, stats.stalls, STALL_THRESHOLD_US, stats.longest_gap_us);
+  }
+  stall_record_t records[STALL_RECORDS];
+  int count = getStallRecords(records, STALL_RECORDS);
+  Serial.println("Longest iterations:");
+  for (int i = 0; i < count; i++)
+  {
+    Serial.printf("  %8u us  %-10s in %-10s at %lld ms\n", records[i].gap_us, records[i].task,
+                  records[i].section != NULL ? records[i].section : "-", records[i].at_us / 1000);
   }
-
-  tft.setCursor(2, 14 * 16);
-  tft.printf("%s", devices[1 - playerTurn].name);
-  // tft.setCursor(10, 13 * 16);
 }
 
-void draw_menu()
+void diagnosticsTasks(const char *args)
 {
-  tft.fillScreen(TFT_CYAN);
-  tft.setTextColor(TFT_BLACK);
-  tft.setTextSize(3);
-  tft.setCursor(10, 10);
-  tft.print("Menu");
-  tft.setTextSize(2);
-  tft.setCursor(3, 50);
-  tft.print("Press again to resume");
-
-  tft.setTextSize(1);
-  tft.setCursor(2, 90);
-  tft.print("Connected devices:");
-  for (int i = 0; i < devices_size; i++)
+#if configUSE_TRACE_FACILITY
+  TaskStatus_t status[24];
+  uint32_t totalRuntime = 0;
+  UBaseType_t count = uxTaskGetSystemState(status, 24, &totalRuntime);
+  Serial.printf("%-16s %4s %6s %11s\n", "task", "prio", "cpu", "stack free");
+  for (UBaseType_t i = 0; i < count; i++)
   {
-    tft.setCursor(8, 110 + i * 20);
-    tft.printf("%s (%02X:%02X:%02X:%02X:%02X:%02X)",
-               devices[i].name,
-               devices[i].remote_bda[0], devices[i].remote_bda[1],
-               devices[i].remote_bda[2], devices[i].remote_bda[3],
-               devices[i].remote_bda[4], devices[i].remote_bda[5]);
+#if configGENERATE_RUN_TIME_STATS
+    // Per mille of the runtime since boot, both cores together
+    uint32_t cpu = totalRuntime / 1000 ? status[i].ulRunTimeCounter / (totalRuntime / 1000) : 0;
+#else
+    uint32_t cpu = 0;
+#endif
+    Serial.printf("%-16s %4u %3u.%u%% %11u\n", status[i].pcTaskName, (unsigned)status[i].uxCurrentPriority,
+                  cpu / 10, cpu % 10, (unsigned)status[i].usStackHighWaterMark);
   }
+#if !configGENERATE_RUN_TIME_STATS
+  Serial.println("Runtime statistics are disabled in this SDK build, cpu column is 0");
+#endif
+#else
+  Serial.println("FreeRTOS trace facility is disabled in this SDK build");
+#endif
 }
 
-// ---------------------------------------------END OF TFT DRAWING CODE--------------------------------------------
-
-#include "pitches.h" // Include the pitches header for note definitions
-
-const int BUZZZER_PIN = GPIO_NUM_25;
-
-// notes in the melody:
-int melodyWin[] = {
-    NOTE_E5, NOTE_E5, NOTE_E5,
-    NOTE_E5, NOTE_E5, NOTE_E5,
-    NOTE_E5, NOTE_G5, NOTE_C5, NOTE_D5,
-    NOTE_E5,
-    NOTE_F5, NOTE_F5, NOTE_F5, NOTE_F5,
-    NOTE_F5, NOTE_E5, NOTE_E5, NOTE_E5, NOTE_E5,
-    NOTE_E5, NOTE_D5, NOTE_D5, NOTE_E5,
-    NOTE_D5, NOTE_G5};
-
-int noteDurationsWin[] = {
-    8, 8, 4,
-    8, 8, 4,
-    8, 8, 8, 8,
-    2,
-    8, 8, 8, 8,
-    8, 8, 8, 16, 16,
-    8, 8, 8, 8,
-    4, 4};
-
-int gameOverMelody[] = {
-    NOTE_C5, NOTE_B4, NOTE_AS4, NOTE_A4,
-    NOTE_GS4, NOTE_G4, NOTE_FS4, NOTE_F4};
-
-int gameOverDurations[] = {
-    8, 8, 8, 8,
-    8, 8, 8, 4};
-
-int simpleMoveMelody[] = {
-    NOTE_C6};
-int simpleMoveDurations[] = {
-    16};
-
-int placeBombMelody[] = {
-    NOTE_C4};
+void diagnosticsRender(const char *args)
+{
+  if (strncmp(args, "reset", 5) == 0)
+  {
+    resetRenderStats();
+    resetUiStats();
+    Serial.println("Render statistics reset");
+    return;
+  }
+  render_stats_t stats;
+  getRenderStats(&stats);
+  Serial.printf("Frames: %u (target %u fps), redraw requests: %u, coalesced: %u\n",
+                stats.frames, RENDER_TARGET_FPS, stats.requests, stats.coalesced);
+  Serial.printf("Frame cost avg %u us, max %u us, over %u us budget: %u\n",
+                stats.frames ? (unsigned)(stats.cost_total_us / stats.frames) : 0,
+                stats.cost_max_us, RENDER_BUDGET_US, stats.over_budget);
+  ui_stats_t ui;
+  getUiStats(&ui);
+  Serial.printf("Screen clears: %u, labels drawn: %u, unchanged: %u, pixels written: %u\n",
+                ui.screens, ui.labels_drawn, ui.labels_skipped, ui.pixels);
+}
 
-int placeBombDurations[] = {
-  16};
+void diagnosticsInput(const char *args)
+{
+  input_stats_t stats;
+  getInputStats(&stats);
+  Serial.printf("Button presses: %u, bounces swallowed: %u, dropped while disabled: %u, overflows: %u\n",
+                stats.presses, stats.bounces, stats.filtered, stats.overflows);
+}
 
-void init_bt()
+void diagnosticsLanes(const char *args)
 {
-  // Create the BLE Device
-  BLEDevice::init("HoriaESP32");
+  for (int s = 0; s < MAX_SESSIONS; s++)
+  {
+    session_t *session = &sessions[s];
+    for (int i = 0; i < session->players.size; i++)
+    {
+      device_connected_t *device = &session->players.devices[i];
+      Serial.printf("S%d %-9s%s queued %u, credits %u, out of turn %u, dropped %u\n",
+                    s + 1, device->name, session->realtime || i == session->player_turn ? "*" : " ",
+                    playerAway(device) ? 0 : getMessageLaneDepth(device->conn_id),
+                    device->credits, device->out_of_turn, device->dropped);
+    }
+  }
+  message_queue_stats_t stats;
+  getMessageQueueStats(&stats);
+  Serial.printf("Queue: %u lanes of %u, %u waiting, max %u, dropped %u\n", MESSAGE_LANES, MESSAGE_LANE_DEPTH,
+                getMessageQueueDepth(), stats.max_depth, stats.dropped);
+}
 
-  // Create the BLE Server
-  pServer = BLEDevice::createServer();
-  pServer->setCallbacks(new MyServerCallbacks());
+void diagnosticsReconnect(const char *args)
+{
+  reconnect_stats_t stats;
+  getReconnectStats(&stats);
+  Serial.printf("Drops held: %u, restored: %u, expired after %d s: %u, names from cache: %u\n",
+                stats.held, stats.restored, SESSION_GRACE_US / 1000000, stats.expired, stats.named);
+  if (stats.restored == 0)
+    return;
+  Serial.printf("Outage avg %lld ms, max %lld ms; reconnect to playable avg %u us, max %u us\n",
+                (long long)(stats.outage_total_us / stats.restored / 1000), (long long)(stats.outage_max_us / 1000),
+                stats.playable_total_us / stats.restored, stats.playable_max_us);
+}
 
-  // Create the BLE Service
-  BLEService *pService = pServer->createService(SERVICE_UUID);
+void diagnosticsBoards(const char *args)
+{
+  board_pool_stats_t stats;
+  getBoardPoolStats(&stats);
+  Serial.printf("Boards ready: %u of %u, generated: %u (max %u us)\n",
+                stats.ready, BOARD_POOL_SIZE, stats.generated, stats.generate_max_us);
+  Serial.printf("Resets from the pool: %u, from the flash bank: %u, generated in place: %u\n",
+                stats.from_pool, stats.from_bank, stats.missed);
+}
 
-  // Create a BLE Characteristic
-  pCharacteristic = pService->createCharacteristic(
-      CHARACTERISTIC_UUID,
-      BLECharacteristic::PROPERTY_READ |
-          BLECharacteristic::PROPERTY_WRITE |
-          BLECharacteristic::PROPERTY_NOTIFY |
-          BLECharacteristic::PROPERTY_INDICATE);
+void diagnosticsState(const char *args)
+{
+  board_state_stats_t stats;
+  getBoardStateStats(&stats);
+  Serial.printf("Board state reads: %u, encoded: %u (max %u us), served from cache: %u, retried: %u, empty: %u\n",
+                stats.reads, stats.encodes, stats.encode_max_us, stats.reads - stats.encodes - stats.unserved,
+                stats.retries, stats.unserved);
+}
 
-  // https://www.bluetooth.com/specifications/gatt/viewer?attributeXmlFile=org.bluetooth.descriptor.gatt.client_characteristic_configuration.xml
-  // Create a BLE Descriptor
-  pCharacteristic->addDescriptor(new BLE2902());
+void diagnosticsAudio(const char *args)
+{
+  if (strncmp(args, "reset", 5) == 0)
+  {
+    resetAudioStats();
+    Serial.println("Audio statistics reset");
+    return;
+  }
+  audio_stats_t stats;
+  getAudioStats(&stats);
+  Serial.printf("Melodies played: %u, restarted: %u, voices taken over: %u (%u voices), blocks limited: %u\n",
+                stats.plays, stats.restarted, stats.stolen, AUDIO_VOICES, stats.limited);
+  Serial.printf("Blocks mixed: %u, mix avg %u us, max %u us (block lasts %u us)\n", stats.blocks,
+                stats.blocks ? (unsigned)(stats.mix_total_us / stats.blocks) : 0, stats.mix_max_us,
+                AUDIO_BLOCK_FRAMES * 1000000 / AUDIO_SAMPLE_RATE);
+}
 
-  // Add the callback for characteristic writes
-  pCharacteristic->setCallbacks(new MyCallbacks());
+static void trace_line(const char *line)
+{
+  Serial.println(line);
+}
 
-  // Start the service
-  pService->start();
+// As many trace lines as the UART takes without blocking: the whole ring is
+// about ten seconds of output at BAUD_RATE
+static void trace_dump_step()
+{
+  traceDumpStep(trace_line, Serial.availableForWrite() / TRACE_DUMP_LINE_MAX);
+}
 
-  // Start advertising
-  BLEAdvertising *pAdvertising = BLEDevice::getAdvertising();
-  pAdvertising->addServiceUUID(SERVICE_UUID);
-  pAdvertising->setScanResponse(true);
-  pAdvertising->setMinPreferred(0x0); // set value to 0x00 to not advertise this parameter
-  BLEDevice::startAdvertising();
+void diagnosticsTrace(const char *args)
+{
+  if (strncmp(args, "dump", 4) == 0)
+  {
+    traceDumpBegin(); // python scripts/trace_to_chrome.py <serial log>
+    return;
+  }
+  if (strncmp(args, "reset", 5) == 0)
+    resetTrace();
+  else if (strncmp(args, "on", 2) == 0)
+    traceEnable(true);
+  else if (strncmp(args, "off", 3) == 0)
+    traceEnable(false);
+  trace_stats_t stats;
+  getTraceStats(&stats);
+  Serial.printf("Tracing %s, %u events recorded, %u overwritten (ring of %u)\n",
+                traceEnabled() ? "on" : "off", stats.recorded, stats.overwritten, TRACE_RECORDS);
 }
 
 void setup()
 {
   Serial.begin(BAUD_RATE);
+  playerCacheBegin(); // Before any device can connect
+  boardPoolBegin();   // Fills at idle priority, ready long before the first reset
+  setMessageQueuePriority(sessionHasTurn); // The players whose turn it is go first
   Serial.println("Starting Bluetooth Classic Relay Server...");
 
-  init_bt();
+  transportRegister(&bleTransport, BLE_CONN_ID_BASE, BLE_MAX_CONNECTIONS);
+  transportRegister(&loadgenTransport, LOADGEN_CONN_ID_BASE, LOADGEN_MAX_CLIENTS);
+  transportBeginAll(DEVICE_NAME, &connectionEvents);
 
   Serial.println("Bluetooth Classic device started, ready to pair!");
 
+  diagnosticsRegister("loadgen", "[clients] [rate_hz] [spam_hz] [seconds] simulated client load", diagnosticsLoadgen);
+  diagnosticsRegister("heap", "heap allocation counters", diagnosticsHeap);
+  diagnosticsRegister("memory", "static tables per subsystem, heap and stack high-water", diagnosticsMemory);
+  diagnosticsRegister("stalls", "[reset] longest loop iterations and the section that held them", diagnosticsStalls);
+  diagnosticsRegister("tasks", "FreeRTOS runtime and stack high-water mark per task", diagnosticsTasks);
+  diagnosticsRegister("render", "[reset] frame pacing and render cost", diagnosticsRender);
+  diagnosticsRegister("input", "button debounce and input stream counters", diagnosticsInput);
+  diagnosticsRegister("power", "[reset] active/idle residency and wake-up latency", diagnosticsPower);
+  diagnosticsRegister("lanes", "per-player input lanes: queued, rejected out of turn, dropped", diagnosticsLanes);
+  diagnosticsRegister("reconnect", "held seats, restores and reconnect-to-playable time", diagnosticsReconnect);
+  diagnosticsRegister("boards", "pregenerated board pool and flash bank use", diagnosticsBoards);
+  diagnosticsRegister("state", "board state characteristic: reads, encodings, cache hits", diagnosticsState);
+  diagnosticsRegister("audio", "[reset] mixer voices and block mixing cost", diagnosticsAudio);
+  diagnosticsRegister("trace", "[dump|reset|on|off] execution spans, dump for Chrome / Perfetto", diagnosticsTrace);
+
   tft.init();
   tft.setRotation(0);
   tft.fillScreen(TFT_CYAN);
   tft.drawString(" Horia BlueBomb ", 18, 30, 2);
+  init_ui();
+  sessions[selectedSession].game.animate_cascades(true);
   Serial.println("TFT initialized with red background");
   Serial.printf("TFT width: %d, height: %d\n", tft.width(), tft.height());
 
@@ -472,49 +696,23 @@ void setup()
   pinMode(GPIO_NUM_32, INPUT_PULLUP);
   attachInterrupt(digitalPinToInterrupt(GPIO_NUM_32), buttonISR_GPIO32, FALLING);
 
-  // Initialize timer for one second
-  my_timer = timerBegin(0, 80, true);              // Timer 0, prescaler 80 (1 tick = 1 us)
-  timerAttachInterrupt(my_timer, &timerISR, true); // Attach the interrupt
-  timerAlarmWrite(my_timer, 1000000 / 1000, true); // Set alarm for 1/1000 second
-  timerAlarmEnable(my_timer);                      // Enable the alarm
+  // The buttons wake the CPU from light sleep as well as loop()
+  powerBegin(buttonPins, sizeof(buttonPins));
 
-  // Sing when the device starts
-  int size = sizeof(noteDurationsWin) / sizeof(int);
-  pinMode(BUZZZER_PIN, OUTPUT); // Set the buzzer pin as output
+  // Sing when the device starts, mixed in the background while setup() goes on
+  audioOutputBegin();
+  audioOutputPlay(&melodyWin);
 
-  for (int thisNote = 0; thisNote < size; thisNote++)
-  {
+  loopStall = stallRegister("loop");
+  const esp_timer_create_args_t stallTimerArgs = {stallTimerCallback, NULL, ESP_TIMER_TASK, "stall"};
+  esp_timer_create(&stallTimerArgs, &stallTimer);
 
-    // to calculate the note duration, take one second divided by the note type.
-    // e.g. quarter note = 1000 / 4, eighth note = 1000/8, etc.
-    int noteDuration = 1000 / noteDurationsWin[thisNote];
-    tone(BUZZZER_PIN, melodyWin[thisNote], noteDuration);
-
-    // to distinguish the notes, set a minimum time between them.
-    // the note's duration + 30% seems to work well:
-    int pauseBetweenNotes = noteDuration * 1.30;
-    delay(pauseBetweenNotes);
-    // stop the tone playing:
-    noTone(BUZZZER_PIN);
-  }
+  markAllocBaseline(); // Everything after setup() is steady state
 }
 
-bool play_song = false;
-
-const int noteWinDuration_size = sizeof(noteDurationsWin) / sizeof(int);
-const int noteGameOverDuration_size = sizeof(gameOverDurations) / sizeof(int);
-
-int currentNote = 0; // Track the current note being played
-uint32_t lastTimerCheck = 0;
-bool action_playing;
-
-const int displayFinalScreenTime = 2000; // 2 seconds in timer ticks (1000 ticks per second)
-int startTimeDisplayFinalScreen = 0;     // Start time for displaying final screen
-bool displayFinalScreen = false;         // Flag to indicate if final screen should be displayed
-
-int note_size;
-int *curr_notes;
-int *curr_durations;
+const int64_t displayFinalScreenTime = 2000000; // 2 seconds
+clock_deadline_t finalScreenDeadline;           // When the final screen may be left
+bool displayFinalScreen = false;                // Flag to indicate if final screen should be displayed
 
 enum MusicType
 {
@@ -526,303 +724,284 @@ enum MusicType
 
 void startMusic(MusicType type)
 {
-  if (type == MUSIC_WIN)
-  {
-    curr_notes = melodyWin;
-    curr_durations = noteDurationsWin;
-    note_size = noteWinDuration_size;
-  }
-  else if (type == MUSIC_GAME_OVER)
-  {
-    curr_notes = gameOverMelody;
-    curr_durations = gameOverDurations;
-    note_size = noteGameOverDuration_size;
-  }
-  else if (type == MUSIC_SIMPLE_MOVE)
-  {
-    curr_notes = simpleMoveMelody;
-    curr_durations = simpleMoveDurations;
-    note_size = sizeof(simpleMoveDurations) / sizeof(int);
-  }
-  else if (type == MUSIC_PLACE_BOMB)
-  {
-    curr_notes = placeBombMelody;
-    curr_durations = placeBombDurations;
-    note_size = sizeof(placeBombDurations) / sizeof(int);
-  }
-  currentNote = 0;        // Reset the current note
-  play_song = true;       // Set the flag to start playing music
-  action_playing = false; // Reset action playing state
-
-  // DDRAM(BUZZZER_PIN, OUTPUT); // Set the buzzer pin as output
+  // A new sound joins whatever is playing instead of cutting it off
+  static const audio_melody_t *const melodies[] = {&melodyWin, &melodyGameOver, &melodySimpleMove, &melodyPlaceBomb};
+  audioOutputPlay(melodies[type]);
 }
 
-void change_player_name(message_t &message)
+void loop()
 {
-  char new_name[10];
-  size_t name_length = message.length - 1; // Exclude the command character
-  if (name_length > 9)
+  stallHeartbeat(loopStall);
+  esp_timer_start_once(stallTimer, STALL_THRESHOLD_US); // Catch whatever blocks this iteration
+
+  stallSection(loopStall, "console");
+  diagnosticsPoll();
+  if (traceDumping())
+    trace_dump_step();
+
+  session_t *current = &sessions[selectedSession]; // The game on screen
+  reapFinishedSessions(current, clockNow());
+  uint32_t expired = expireAwaySeats(clockNow());
+  if (expired != 0)
   {
-    name_length = 9; // Limit to 9 characters
+    // display the menu when someone left the game on screen for good
+    if (expired & (1u << selectedSession))
+      displayMenu = true;
+    formerDisplayMenu = false; // Reset display menu flag
   }
-  memcpy(new_name, &message.data[1], name_length);
-  new_name[name_length] = '\0'; // Null-terminate the string
 
-  for (int i = 0; i < devices_size; i++)
+  stallSection(loopStall, "input");
+  // Drain the input stream in order. Presses are handled right here; a command
+  // ends the drain, and the queue behind it is served in the dispatch section.
+  input_event_t event;
+  bool commandPending = false;
+  while (!commandPending && inputNextEvent(&event))
   {
-    Serial.printf("Checking device %d with MAC: %02X:%02X:%02X:%02X:%02X:%02X\n",
-                  i,
-                  devices[i].remote_bda[0], devices[i].remote_bda[1],
-                  devices[i].remote_bda[2], devices[i].remote_bda[3],
-                  devices[i].remote_bda[4], devices[i].remote_bda[5]);
-    if (memcmp(devices[i].remote_bda, message.handle, sizeof(esp_bd_addr_t)) == 0)
+    if (event.type == INPUT_EVENT_COMMAND)
     {
-      // Found the device, update its name
-      strncpy(devices[i].name, new_name, sizeof(devices[i].name) - 1);
-      devices[i].name[sizeof(devices[i].name) - 1] = '\0'; // Ensure null termination
-      Serial.printf("Updated device name to: %s\n", devices[i].name);
-      break;
+      commandPending = true;
     }
-  }
-}
-
-void loop()
-{
-  // Process messages from the queue
-  if (mark_as_bomb)
-  {
-    mark_as_bomb = false;
-    Serial.printf("Bomb marked in position %d %d\n",
-                  (game.get_player_position() & 0x0F), // X position
-                  (game.get_player_position() >> 4));  // Y position
-    game.builtin_button_pressed();
-    draw_map();
-    Serial.printf("flag value %d\n",
-                  game.is_marked_as_bomb(game.get_player_position()));
-
-    // play_song = true; // Play song when marking a bomb
-    lastTimerCheck = timerCounter;
-    action_playing = false;
-    startMusic(MUSIC_PLACE_BOMB); // Start playing the place bomb melody
-  }
-
-  if (play_song)
-  {
-    if (currentNote < note_size)
+    else if (event.button == BUTTON_RESET)
     {
-      int noteDuration = 1000 / curr_durations[currentNote];
-      if (!action_playing)
-      {
-        action_playing = true; // Set the action as playing
-        tone(BUZZZER_PIN, curr_notes[currentNote], noteDuration);
-      }
-      if (timerCounter - lastTimerCheck >= noteDuration + noteDuration / 4) // Check if enough time has passed
-      {
-        lastTimerCheck = timerCounter; // Update the last check time
-        noTone(BUZZZER_PIN);
-        currentNote++;
-        Serial.printf("Current note: %d, Duration: %d ms\n",
-                      currentNote, noteDuration);
-        action_playing = false;
-      }
+      shouldRedrawMap = 1; // total reset of the game
+      displayMenu = true;
+      formerDisplayMenu = false; // Reset display menu flag
     }
-    else
+    else if (event.button == BUTTON_MENU)
+    {
+      displayMenu = !displayMenu; // Toggle menu display
+    }
+    else if (event.button == BUTTON_MARK && displayMenu)
     {
-      play_song = false; // Stop playing when all notes are done
-      currentNote = 0;   // Reset for next time
+      // In the menu the button picks the session to show
+      current->game.animate_cascades(false); // Only the game on screen animates
+      selectedSession = (selectedSession + 1) % MAX_SESSIONS;
+      current = &sessions[selectedSession];
+      current->game.animate_cascades(true);
+      formerDisplayMenu = false; // Redraw the menu with the new selection
+    }
+    else if (event.button == BUTTON_MARK)
+    {
+      Minesweeper &game = current->game;
+      Serial.printf("Bomb marked in position %d %d\n",
+                    (game.get_player_position() & 0x0F), // X position
+                    (game.get_player_position() >> 4));  // Y position
+      game.builtin_button_pressed();
+      renderRequest(RENDER_SCREEN | RENDER_MAP);
+      Serial.printf("flag value %d\n",
+                    game.is_marked_as_bomb(game.get_player_position()));
+
+      startMusic(MUSIC_PLACE_BOMB); // Start playing the place bomb melody
     }
   }
 
-  message_t message;
-
+  stallSection(loopStall, "screens");
   if (displayMenu && !formerDisplayMenu)
   {
     Serial.println("Displaying menu");
-    draw_menu();
+    uiScreenShow(&menuScreen);
+    renderRequest(RENDER_SCREEN); // Only the rows that changed are repainted
     formerDisplayMenu = true; // Set the flag to indicate menu is displayed
     Serial.println("Menu button pressed, toggling displayMenu state");
     Serial.printf("displayMenu: %d\n\n", displayMenu);
   }
-  else if (displayMenu)
-  {
-
-    if (getMessageFromQueue(&message))
-    { // Loop over received messages while displaying the menu
-      // Don't process commands, only change the name:
-      if (message.length > 0 && message.data[0] == 'N')
-      {
-        Serial.printf("Changing name for device with MAC: %02X:%02X:%02X:%02X:%02X:%02X\n",
-                      message.handle[0], message.handle[1],
-                      message.handle[2], message.handle[3],
-                      message.handle[4], message.handle[5]);
-        change_player_name(message);
-        formerDisplayMenu = false; // Reset the flag to redraw the menu
-      }
-    }
-  }
   else if (!displayMenu)
   {
     if (formerDisplayMenu)
     {
-      tft.fillScreen(TFT_CYAN);
-      draw_map();                // Redraw the game map when exiting the menu
+      uiScreenShow(&gameScreen);
+      renderRequest(RENDER_SCREEN | RENDER_MAP); // Redraw the game map when exiting the menu
       formerDisplayMenu = false; // Reset the flag when exiting the menu
     }
     if (shouldRedrawMap)
     {
-      tft.fillScreen(TFT_CYAN);
-
-      game = Minesweeper(); // Reset the game
-      draw_map();
+      resetSession(current); // Reset the game in place
+      renderRequest(RENDER_SCREEN | RENDER_MAP); // Every cell is repainted, no clear needed
+      markAllocBaseline(); // Gameplay from here on should not allocate
       shouldRedrawMap = 0;
     }
-    else if (game.is_game_over())
+    else if (current->game.is_game_over())
     {
-      if (!displayFinalScreen && !game.displayed_final)
+      if (!displayFinalScreen && !current->game.displayed_final)
       {
 
-        detachInterrupt(digitalPinToInterrupt(GPIO_NUM_0));  // Disable button interrupt
-        detachInterrupt(digitalPinToInterrupt(GPIO_NUM_2));  // Disable bomb marking button interrupt
-        detachInterrupt(digitalPinToInterrupt(GPIO_NUM_32)); // Disable menu button interrupt
+        inputSetButtonsEnabled(ALL_BUTTONS, false); // Presses are dropped while the result is shown
 
         displayFinalScreen = true; // Set the flag to indicate final scr
-        tft.fillScreen(TFT_RED);
-        tft.setTextColor(TFT_WHITE);
-        tft.setTextSize(2);
-        tft.setCursor(10, 10);
-        tft.print("Game Over");
-
-        tft.setCursor(10, 50);
-        tft.printf("Lose: %s\n", devices[playerTurn].name);
-        game.displayed_final = true;                // Set the flag to indicate final screen has been displayed
-        startTimeDisplayFinalScreen = timerCounter; // Start the timer for displaying final screen
+        uiLabelPrintf(&lostName, "Lose: %s", currentPlayerName(current));
+        uiLabelPrintf(&lostExit, "%s", "");
+        uiScreenShow(&lostScreen); // Pending board updates are dropped with the game screen
+        renderRequest(RENDER_SCREEN);
+        current->game.displayed_final = true;       // Set the flag to indicate final screen has been displayed
+        deadlineArm(&finalScreenDeadline, displayFinalScreenTime); // Start the timer for displaying final screen
 
         startMusic(MUSIC_GAME_OVER); // Start playing the game over melody
       }
-      if (displayFinalScreen && timerCounter - startTimeDisplayFinalScreen >= displayFinalScreenTime)
+      if (displayFinalScreen && deadlineExpired(&finalScreenDeadline))
       {
         // If the final screen has been displayed for enough time, reset the game
         displayFinalScreen = false; // Reset the flag
 
-        tft.setCursor(10, 90);
-        tft.setTextSize(1);
-        tft.print("You can exit the page now");
+        uiLabelPrintf(&lostExit, "You can exit the page now");
+        renderRequest(RENDER_SCREEN);
 
-        attachInterrupt(digitalPinToInterrupt(GPIO_NUM_0), buttonISR_GPIO0, FALLING);   // Re-enable button interrupt
-        attachInterrupt(digitalPinToInterrupt(GPIO_NUM_2), buttonISR_GPIO2, FALLING);   // Re-enable bomb marking button interrupt
-        attachInterrupt(digitalPinToInterrupt(GPIO_NUM_32), buttonISR_GPIO32, FALLING); // Re-enable menu button interrupt
+        inputSetButtonsEnabled(ALL_BUTTONS, true); // Back to normal
       }
 
       // game = Minesweeper();
       // shouldRedrawMap = 1;
     }
-    else if (game.won())
+    else if (current->game.won())
     {
-      if (!displayFinalScreen && !game.displayed_final)
+      if (!displayFinalScreen && !current->game.displayed_final)
       {
 
-        detachInterrupt(digitalPinToInterrupt(GPIO_NUM_0));  // Disable button interrupt
-        detachInterrupt(digitalPinToInterrupt(GPIO_NUM_2));  // Disable bomb marking button interrupt
-        detachInterrupt(digitalPinToInterrupt(GPIO_NUM_32)); // Disable menu button interrupt
+        inputSetButtonsEnabled(ALL_BUTTONS, false); // Presses are dropped while the result is shown
 
         displayFinalScreen = true; // Set the flag to indicate final screen should be displayed
-        tft.fillScreen(TFT_GREEN);
-        tft.setTextColor(TFT_BLACK);
-        tft.setTextSize(2);
-        tft.setCursor(10, 10);
-        tft.print("You Won!");
-        tft.setCursor(10, 50);
-        tft.printf("Congrats %s\n", devices[playerTurn].name);
-        game.displayed_final = true;                // Set the flag to indicate final screen has been displayed
-        startTimeDisplayFinalScreen = timerCounter; // Start the timer for displaying final screen
+        uiLabelPrintf(&wonName, "Congrats %s", currentPlayerName(current));
+        uiLabelPrintf(&wonExit, "%s", "");
+        uiScreenShow(&wonScreen); // Pending board updates are dropped with the game screen
+        renderRequest(RENDER_SCREEN);
+        current->game.displayed_final = true;       // Set the flag to indicate final screen has been displayed
+        deadlineArm(&finalScreenDeadline, displayFinalScreenTime); // Start the timer for displaying final screen
         startMusic(MUSIC_WIN);                      // Start playing the win melody
       }
-      if (displayFinalScreen && timerCounter - startTimeDisplayFinalScreen >= displayFinalScreenTime)
+      if (displayFinalScreen && deadlineExpired(&finalScreenDeadline))
       {
         // If the final screen has been displayed for enough time, reset the game
         displayFinalScreen = false; // Reset the flag
 
-        tft.setCursor(10, 90);
-        tft.setTextSize(1);
-        tft.print("You can exit the page now");
+        uiLabelPrintf(&wonExit, "You can exit the page now");
+        renderRequest(RENDER_SCREEN);
 
-        attachInterrupt(digitalPinToInterrupt(GPIO_NUM_0), buttonISR_GPIO0, FALLING);   // Re-enable button interrupt
-        attachInterrupt(digitalPinToInterrupt(GPIO_NUM_2), buttonISR_GPIO2, FALLING);   // Re-enable bomb marking button interrupt
-        attachInterrupt(digitalPinToInterrupt(GPIO_NUM_32), buttonISR_GPIO32, FALLING); // Re-enable menu button interrupt
+        inputSetButtonsEnabled(ALL_BUTTONS, true); // Back to normal
       }
     }
-    if (getMessageFromQueue(&message)) // Going through the message queue
+  }
+
+  message_t *message; // Points into the queue slot, valid until released
+
+  stallSection(loopStall, "dispatch");
+  // Everything waiting is handled now, in arrival order, so that a command
+  // waits one iteration however many players are sending. The first command
+  // uses the marker the input drain stopped at; every further one takes its
+  // own marker, and a button press ahead of it ends the batch.
+  for (int dispatched = 0; dispatched < DISPATCH_BATCH && ((dispatched == 0 && commandPending) || inputTakeCommand()) &&
+                           (message = peekMessageFromQueue()) != NULL; dispatched++) // Going through the message queue
+  {
+    flowControlComplete(message->conn_id, notifyConnection);
+    session_t *session = sessionOfConnection(message->conn_id);
+    // At 9600 baud a log line per command would cost more than the game itself in real time
+    bool log = session == NULL || !session->realtime;
+    if (displayMenu)
     {
-      Serial.printf("Processing message (%d bytes) from %02X:%02X:%02X:%02X:%02X:%02X\n", message.length,
-                    message.handle[0], message.handle[1],
-                    message.handle[2], message.handle[3],
-                    message.handle[4], message.handle[5]);
-      if (memcmp(message.handle, devices[playerTurn].remote_bda, sizeof(esp_bd_addr_t)) != 0)
+      // Don't process commands while displaying the menu, only change the name:
+      if (session != NULL && (sessionRename(session, message) & EFFECT_RENAMED))
+      {
+        Serial.printf("Changed name for device with MAC: %02X:%02X:%02X:%02X:%02X:%02X\n",
+                      message->handle[0], message->handle[1],
+                      message->handle[2], message->handle[3],
+                      message->handle[4], message->handle[5]);
+        formerDisplayMenu = false; // Reset the flag to redraw the menu
+      }
+    }
+    else
+    {
+      if (log)
+      {
+        Serial.printf("Processing message (%d bytes) from %02X:%02X:%02X:%02X:%02X:%02X\n", message->length,
+                      message->handle[0], message->handle[1],
+                      message->handle[2], message->handle[3],
+                      message->handle[4], message->handle[5]);
+      }
+      traceBegin(TRACE_DISPATCH);
+      uint32_t effects = session != NULL ? sessionDispatch(session, message, notifyConnection) : EFFECT_IGNORED;
+      traceEnd(TRACE_DISPATCH);
+      if (effects & EFFECT_IGNORED)
       {
         // If the message is not from the current player, ignore it
         Serial.println("Message not from current player, ignoring");
       }
-      else
+      else if (session == current)
       {
-        // If you want to echo back to the same device:
-        if (message.data[0] == 'L')
-        {
-          game.move_player(CMD_LEFT);
-          startMusic(MUSIC_SIMPLE_MOVE); // Play simple move melody
-        }
-        else if (message.data[0] == 'R')
-        {
-          game.move_player(CMD_RIGHT);
-          startMusic(MUSIC_SIMPLE_MOVE); // Play simple move melody
-        }
-        else if (message.data[0] == 'U')
+        // Only the game on screen gets sound and a redraw, the others run silently
+        if (effects & EFFECT_MOVED)
         {
-          game.move_player(CMD_UP);
           startMusic(MUSIC_SIMPLE_MOVE); // Play simple move melody
         }
-        else if (message.data[0] == 'D')
+        else if (effects & EFFECT_FLAGGED)
         {
-          game.move_player(CMD_DOWN);
-          startMusic(MUSIC_SIMPLE_MOVE); // Play simple move melody
-        }
-        else if (message.data[0] == 'S')
-        {
-          game.move_player(CMD_SHOOT);
-          playerTurn = (playerTurn + 1) % devices_size; // Switch to the next player
-          game.set_player_turn(playerTurn);
-        }
-        else if (message.data[0] == 'N')
-        { // Change name for MAC address
-          change_player_name(message);
+          startMusic(MUSIC_PLACE_BOMB); // Same as the mark button
         }
-
-        draw_map(message.data[0] == 'S');
+        renderRequest(RENDER_SCREEN | RENDER_MAP); // The status bar follows the turn by itself
       }
 
-      // For debugging, print message content to Serial
-      Serial.print("Message content: ");
-      for (int i = 0; i < message.length; i++)
+      if (log)
       {
-        Serial.print((char)message.data[i]);
+        // For debugging, print message content to Serial
+        Serial.print("Message content: ");
+        for (int i = 0; i < message->length; i++)
+        {
+          Serial.print((char)message->data[i]);
+        }
+        Serial.println();
       }
-      Serial.println();
+    }
+    releaseMessageFromQueue();
+    if (current->game.is_game_over() || current->game.won())
+    {
+      break; // The final screen comes first, later commands wait for the next iteration
     }
   }
 
-  // Handle reconnection
-  if (!deviceConnected && oldDeviceConnected)
+  stallSection(loopStall, "render");
+  // At most one frame per frame period, whatever changed since the last one
+  int64_t now = clockNow();
+  int64_t frameDueIn = renderDueIn(now);
+  if (frameDueIn == 0)
   {
-    delay(500); // Give the bluetooth stack time to get things ready
-    oldDeviceConnected = deviceConnected;
+    // A reveal cascade grows by one ring per frame, the board shows each of them
+    bool cascading = current->game.step_cascade();
+    render_frame(renderBegin(now));
+    renderEnd(clockNow());
+    frameDueIn = -1;
+    if (cascading)
+    {
+      renderRequest(RENDER_MAP);
+      frameDueIn = renderDueIn(now);
+    }
   }
 
-  // Handle new connection
-  if (deviceConnected && !oldDeviceConnected)
+  // Sleep until the next command or button press, or until the next deadline
+  // (final screen) or frame is due. The DAC needs its clock while it
+  // plays. Queued commands are handled back to back, the frame pacing absorbs them.
+  int64_t wakeIn = clockNextDeadlineIn(now);
+  if (frameDueIn >= 0 && (wakeIn < 0 || frameDueIn < wakeIn))
+    wakeIn = frameDueIn;
+  uint32_t timeout = POWER_IDLE_POLL_MS;
+  if (wakeIn >= 0 && wakeIn / 1000 < timeout)
+    timeout = (wakeIn + 999) / 1000;
+  if (traceDumping() && timeout > TRACE_DUMP_POLL_MS)
+    timeout = TRACE_DUMP_POLL_MS; // Back when the UART has room for the next lines
+  if (getMessageQueueDepth() > 0)
   {
-    oldDeviceConnected = deviceConnected;
+    timeout = 0;
+  }
+  else
+  {
+    stallSection(loopStall, "nvs");
+    playerCacheCommit(); // Flash writes only when no command is waiting
+  }
+  powerHoldAwake(audioActive()); // I2S needs its clock while the DAC plays
+  esp_timer_stop(stallTimer);
+  stallSection(loopStall, NULL); // Sleeping on purpose is no stall
+  uint32_t pressed = powerIdle(timeout);
+  for (uint8_t button = 0; button < sizeof(buttonPins); button++)
+  {
+    if (pressed & (1u << button))
+      inputButtonEdge(button, clockNow()); // Its ISR was masked for light sleep
   }
-
-  delay(10); // Small delay for stability
 }
 
 int main()
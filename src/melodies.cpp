@@ -0,0 +1,33 @@
+#include "melodies.h"
+
+#include "pitches.h"
+
+// Phase steps and sample counts are worked out by the compiler, nothing is
+// computed when a melody starts
+#define NOTES(table) table, sizeof(table) / sizeof(table[0])
+
+static const audio_note_t winNotes[] = {
+    audioNote(NOTE_E5, 8), audioNote(NOTE_E5, 8), audioNote(NOTE_E5, 4),
+    audioNote(NOTE_E5, 8), audioNote(NOTE_E5, 8), audioNote(NOTE_E5, 4),
+    audioNote(NOTE_E5, 8), audioNote(NOTE_G5, 8), audioNote(NOTE_C5, 8), audioNote(NOTE_D5, 8),
+    audioNote(NOTE_E5, 2),
+    audioNote(NOTE_F5, 8), audioNote(NOTE_F5, 8), audioNote(NOTE_F5, 8), audioNote(NOTE_F5, 8),
+    audioNote(NOTE_F5, 8), audioNote(NOTE_E5, 8), audioNote(NOTE_E5, 8), audioNote(NOTE_E5, 16), audioNote(NOTE_E5, 16),
+    audioNote(NOTE_E5, 8), audioNote(NOTE_D5, 8), audioNote(NOTE_D5, 8), audioNote(NOTE_E5, 8),
+    audioNote(NOTE_D5, 4), audioNote(NOTE_G5, 4)};
+
+static const audio_note_t gameOverNotes[] = {
+    audioNote(NOTE_C5, 8), audioNote(NOTE_B4, 8), audioNote(NOTE_AS4, 8), audioNote(NOTE_A4, 8),
+    audioNote(NOTE_GS4, 8), audioNote(NOTE_G4, 8), audioNote(NOTE_FS4, 8), audioNote(NOTE_F4, 4)};
+
+static const audio_note_t simpleMoveNotes[] = {
+    audioNote(NOTE_C6, 16)};
+
+static const audio_note_t placeBombNotes[] = {
+    audioNote(NOTE_C4, 16)};
+
+// The tunes stay square like the old buzzer; the effects sit under them
+const audio_melody_t melodyWin = {NOTES(winNotes), AUDIO_WAVE_SQUARE, 128};
+const audio_melody_t melodyGameOver = {NOTES(gameOverNotes), AUDIO_WAVE_SQUARE, 128};
+const audio_melody_t melodySimpleMove = {NOTES(simpleMoveNotes), AUDIO_WAVE_TRIANGLE, 96};
+const audio_melody_t melodyPlaceBomb = {NOTES(placeBombNotes), AUDIO_WAVE_TRIANGLE, 96};
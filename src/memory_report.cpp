@@ -0,0 +1,92 @@
+#include "memory_report.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "audio_output.h"
+#include "ble_transport.h"
+#include "board_pool.h"
+#include "board_state.h"
+#include "input_events.h"
+#include "load_generator.h"
+#include "message_queue.h"
+#include "player_cache.h"
+#include "session.h"
+#include "stall_monitor.h"
+#include "trace.h"
+
+// The big tables, by the size of the objects themselves: the globals directly,
+// the file-static ones through the *_STATIC_BYTES their owner asserts against
+static constexpr memory_region_t staticRegions[] = {
+    {"sessions", sizeof(sessions)},
+    {"connection routes", SESSION_ROUTES_STATIC_BYTES},
+    {"message lanes", sizeof(messageLanes)},
+    {"input events", INPUT_STATIC_BYTES},
+    {"player cache", PLAYER_CACHE_STATIC_BYTES},
+    {"board pool", BOARD_POOL_STATIC_BYTES},
+    {"board state cache", BOARD_STATE_STATIC_BYTES},
+    {"BLE state reads", BLE_STATE_STATIC_BYTES},
+    {"audio", AUDIO_MIXER_STATIC_BYTES + AUDIO_OUTPUT_STATIC_BYTES},
+    {"trace ring", TRACE_STATIC_BYTES},
+    {"stall records", STALL_STATIC_BYTES},
+};
+
+#define STATIC_REGIONS (int)(sizeof(staticRegions) / sizeof(staticRegions[0]))
+
+static constexpr uint32_t static_total()
+{
+  uint32_t total = 0;
+  for (int i = 0; i < STATIC_REGIONS; i++)
+    total += staticRegions[i].bytes;
+  return total;
+}
+
+static_assert(static_total() <= MEMORY_STATIC_BUDGET,
+              "static tables exceed MEMORY_STATIC_BUDGET: fewer sessions, players or a smaller board");
+
+// Tasks the firmware creates, with the stack each was given
+static const memory_stack_t taskStacks[] = {
+    {"loopTask", MEMORY_LOOP_STACK, 0, false},
+    {"audio", AUDIO_TASK_STACK, 0, false},
+    {"boards", BOARD_POOL_STACK, 0, false},
+    {"loadgen", LOADGEN_TASK_STACK, 0, false},
+#ifdef CONFIG_BT_BTC_TASK_STACK_SIZE
+    {"BTC_TASK", CONFIG_BT_BTC_TASK_STACK_SIZE, 0, false},
+#endif
+#ifdef CONFIG_BT_BTU_TASK_STACK_SIZE
+    {"BTU_TASK", CONFIG_BT_BTU_TASK_STACK_SIZE, 0, false},
+#endif
+};
+
+int getStaticMemory(const memory_region_t **regions)
+{
+  *regions = staticRegions;
+  return STATIC_REGIONS;
+}
+
+uint32_t getStaticMemoryTotal()
+{
+  return static_total();
+}
+
+void getHeapReport(memory_heap_t *heap)
+{
+  heap->total = heap_caps_get_total_size(MALLOC_CAP_8BIT);
+  heap->free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  heap->min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+  heap->largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+}
+
+int getStackReport(memory_stack_t *stacks, int max_stacks)
+{
+  int count = 0;
+  for (size_t i = 0; i < sizeof(taskStacks) / sizeof(taskStacks[0]) && count < max_stacks; i++)
+  {
+    memory_stack_t *stack = &stacks[count++];
+    *stack = taskStacks[i];
+    TaskHandle_t handle = xTaskGetHandle(stack->task);
+    stack->running = handle != NULL;
+    // Bytes on the ESP32 port, where a stack word is a byte
+    stack->free_min = stack->running ? uxTaskGetStackHighWaterMark(handle) : 0;
+  }
+  return count;
+}
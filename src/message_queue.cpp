@@ -0,0 +1,226 @@
+#include "message_queue.h"
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "clock_service.h"
+#include "memory_budget.h"
+#include "trace.h"
+
+message_lane_t messageLanes[MESSAGE_LANES];
+uint32_t messageQueueDepth = 0;
+int servedLane = -1; // Lane whose head was handed out by peekMessageFromQueue()
+static uint32_t arrivalSequence = 0;
+portMUX_TYPE messageQueueMux = portMUX_INITIALIZER_UNLOCKED;
+static message_priority_t messagePriority = NULL;
+
+message_queue_stats_t messageQueueStats;
+
+// peekMessageFromQueue() snapshots every lane on loop()'s stack
+static_assert(MESSAGE_LANES * (sizeof(uint16_t) + sizeof(uint32_t) + sizeof(bool)) <= MEMORY_LOOP_FRAME_BUDGET,
+              "MESSAGE_LANES too large for the lane snapshot on loop()'s stack");
+
+static inline uint32_t latency_bucket(int64_t latency_us)
+{
+  if (latency_us < 8)
+    return latency_us < 0 ? 0 : (uint32_t)latency_us;
+
+  uint32_t exponent = 63 - __builtin_clzll((uint64_t)latency_us); // >= 3
+  uint32_t sub = (uint32_t)(latency_us >> (exponent - 2)) & 3;
+  uint32_t bucket = 8 + (exponent - 3) * 4 + sub;
+  return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+static inline int64_t latency_bucket_upper_bound(uint32_t bucket)
+{
+  if (bucket < 8)
+    return bucket;
+
+  uint32_t exponent = (bucket - 8) / 4 + 3;
+  uint32_t sub = (bucket - 8) % 4;
+  return ((int64_t)(4 + sub + 1) << (exponent - 2)) - 1;
+}
+
+// Caller holds messageQueueMux
+static message_lane_t *lane_of(uint16_t conn_id)
+{
+  message_lane_t *free_lane = NULL;
+  for (int i = 0; i < MESSAGE_LANES; i++)
+  {
+    if (messageLanes[i].count == 0)
+    {
+      if (free_lane == NULL)
+        free_lane = &messageLanes[i];
+    }
+    else if (messageLanes[i].conn_id == conn_id)
+    {
+      return &messageLanes[i];
+    }
+  }
+  return free_lane;
+}
+
+// Function to add message to queue to be handled fby main loop
+bool addMessageToQueue(uint16_t conn_id, const uint8_t mac_addr[6], const uint8_t *data, size_t length)
+{
+  TraceScope span(TRACE_QUEUE_ADD);
+  if (length > MAX_MESSAGE_LENGTH)
+  {
+    length = MAX_MESSAGE_LENGTH; // Truncate if too long
+  }
+
+  int64_t now = clockNow();
+
+  portENTER_CRITICAL(&messageQueueMux);
+  message_lane_t *lane = lane_of(conn_id);
+  if (lane == NULL || lane->count == MESSAGE_LANE_DEPTH)
+  {
+    // Lane is full
+    messageQueueStats.dropped++;
+    portEXIT_CRITICAL(&messageQueueMux);
+    return false;
+  }
+
+  message_t *message = &lane->slots[(lane->head + lane->count) % MESSAGE_LANE_DEPTH];
+  memcpy(message->handle, mac_addr, sizeof(message->handle));
+  message->conn_id = conn_id;
+  message->length = length;
+  memcpy(message->data, data, length);
+  message->enqueued_at = now;
+  message->sequence = arrivalSequence++;
+
+  lane->conn_id = conn_id;
+  lane->count++;
+  messageQueueDepth++;
+
+  messageQueueStats.enqueued++;
+  if (messageQueueDepth > messageQueueStats.max_depth)
+    messageQueueStats.max_depth = messageQueueDepth;
+  portEXIT_CRITICAL(&messageQueueMux);
+  return true;
+}
+
+message_t *peekMessageFromQueue()
+{
+  TraceScope span(TRACE_QUEUE_PEEK);
+  portENTER_CRITICAL(&messageQueueMux);
+  if (servedLane >= 0)
+  {
+    message_t *message = &messageLanes[servedLane].slots[messageLanes[servedLane].head];
+    portEXIT_CRITICAL(&messageQueueMux);
+    return message;
+  }
+
+  // Only the consumer empties lanes, so a busy lane, its owner and its head stay as seen here
+  uint16_t owners[MESSAGE_LANES];
+  uint32_t heads[MESSAGE_LANES];
+  bool busy[MESSAGE_LANES];
+  for (int i = 0; i < MESSAGE_LANES; i++)
+  {
+    busy[i] = messageLanes[i].count > 0;
+    owners[i] = messageLanes[i].conn_id;
+    heads[i] = messageLanes[i].slots[messageLanes[i].head].sequence;
+  }
+  portEXIT_CRITICAL(&messageQueueMux);
+
+  // The priority check may take the caller's own locks, never under messageQueueMux
+  int chosen = -1;
+  for (int pass = messagePriority != NULL ? 0 : 1; pass < 2 && chosen < 0; pass++)
+  {
+    for (int i = 0; i < MESSAGE_LANES; i++)
+    {
+      // Oldest head first; the sequence wraps, the difference does not
+      if (busy[i] && (chosen < 0 || (int32_t)(heads[i] - heads[chosen]) < 0) &&
+          (pass == 1 || messagePriority(owners[i])))
+      {
+        chosen = i;
+      }
+    }
+  }
+  if (chosen < 0)
+    return NULL; // Queue is empty
+
+  int64_t now = clockNow();
+
+  portENTER_CRITICAL(&messageQueueMux);
+  servedLane = chosen;
+  message_t *message = &messageLanes[chosen].slots[messageLanes[chosen].head];
+  // Queueing latency ends when the consumer first sees the message
+  int64_t latency = now - message->enqueued_at;
+  messageQueueStats.dequeued++;
+  messageQueueStats.latency_hist[latency_bucket(latency)]++;
+  if (latency > messageQueueStats.latency_max_us)
+    messageQueueStats.latency_max_us = latency;
+  portEXIT_CRITICAL(&messageQueueMux);
+  return message;
+}
+
+void releaseMessageFromQueue()
+{
+  TraceScope span(TRACE_QUEUE_RELEASE);
+  portENTER_CRITICAL(&messageQueueMux);
+  if (servedLane >= 0)
+  {
+    message_lane_t *lane = &messageLanes[servedLane];
+    lane->head = (lane->head + 1) % MESSAGE_LANE_DEPTH;
+    lane->count--;
+    messageQueueDepth--;
+    servedLane = -1;
+  }
+  portEXIT_CRITICAL(&messageQueueMux);
+}
+
+void setMessageQueuePriority(message_priority_t priority)
+{
+  messagePriority = priority;
+}
+
+uint32_t getMessageQueueDepth()
+{
+  portENTER_CRITICAL(&messageQueueMux);
+  uint32_t depth = messageQueueDepth;
+  portEXIT_CRITICAL(&messageQueueMux);
+  return depth;
+}
+
+uint32_t getMessageLaneDepth(uint16_t conn_id)
+{
+  uint32_t depth = 0;
+  portENTER_CRITICAL(&messageQueueMux);
+  for (int i = 0; i < MESSAGE_LANES; i++)
+  {
+    if (messageLanes[i].count > 0 && messageLanes[i].conn_id == conn_id)
+      depth = messageLanes[i].count;
+  }
+  portEXIT_CRITICAL(&messageQueueMux);
+  return depth;
+}
+void getMessageQueueStats(message_queue_stats_t *stats)
+{
+  portENTER_CRITICAL(&messageQueueMux);
+  *stats = messageQueueStats;
+  portEXIT_CRITICAL(&messageQueueMux);
+}
+
+void resetMessageQueueStats()
+{
+  portENTER_CRITICAL(&messageQueueMux);
+  memset(&messageQueueStats, 0, sizeof(messageQueueStats));
+  portEXIT_CRITICAL(&messageQueueMux);
+}
+
+int64_t messageQueueLatencyPercentile(const message_queue_stats_t *stats, uint32_t per_mille)
+{
+  uint64_t target = ((uint64_t)stats->dequeued * per_mille + 999) / 1000;
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < LATENCY_BUCKETS; i++)
+  {
+    seen += stats->latency_hist[i];
+    if (seen >= target && seen > 0)
+    {
+      int64_t bound = latency_bucket_upper_bound(i);
+      return bound < stats->latency_max_us ? bound : stats->latency_max_us;
+    }
+  }
+  return stats->latency_max_us;
+}
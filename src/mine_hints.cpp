@@ -0,0 +1,194 @@
+#include "mine_hints.h"
+
+static inline bool test_bit(const uint8_t *bits, int32_t x, int32_t y)
+{
+    return (bits[x] & (1 << y)) != 0;
+}
+
+// Grow a row bitset by one tile in every direction (8-neighbourhood)
+static void dilate(const uint8_t *in, uint8_t *out)
+{
+    uint8_t horizontal[HEIGHT];
+    for (int32_t x = 0; x < HEIGHT; x++)
+    {
+        horizontal[x] = (in[x] | (in[x] << 1) | (in[x] >> 1)) & ((1 << WIDTH) - 1);
+    }
+    for (int32_t x = 0; x < HEIGHT; x++)
+    {
+        out[x] = horizontal[x];
+        if (x > 0)
+            out[x] |= horizontal[x - 1];
+        if (x < HEIGHT - 1)
+            out[x] |= horizontal[x + 1];
+    }
+}
+
+MineHints::MineHints()
+{
+    reset();
+}
+
+void MineHints::reset()
+{
+    for (int p = 0; p < 2; p++)
+    {
+        for (int i = 0; i < WIDTH * HEIGHT; i++)
+        {
+            constraint[p][i] = HINT_UNKNOWN;
+            probability[p][i] = HINT_UNKNOWN;
+        }
+        for (int x = 0; x < HEIGHT; x++)
+        {
+            changed[p][x] = 0;
+        }
+    }
+}
+
+void MineHints::_update_constraint(uint8_t player, uint8_t position, const uint8_t *revealed,
+                                   const uint8_t *flagged, const uint8_t *neighbour_count)
+{
+    int32_t x = position / WIDTH;
+    int32_t y = position % WIDTH;
+
+    if (!test_bit(revealed, x, y))
+    {
+        constraint[player][position] = HINT_UNKNOWN;
+        return;
+    }
+
+    int32_t hidden = 0;
+    int32_t flags = 0;
+    for (int32_t i = -1; i <= 1; i++)
+    {
+        for (int32_t j = -1; j <= 1; j++)
+        {
+            int32_t nx = x + i;
+            int32_t ny = y + j;
+            if ((i == 0 && j == 0) || nx < 0 || nx >= HEIGHT || ny < 0 || ny >= WIDTH)
+                continue;
+            if (test_bit(revealed, nx, ny))
+                continue;
+            if (test_bit(flagged, nx, ny))
+                flags++;
+            else
+                hidden++;
+        }
+    }
+
+    if (hidden == 0)
+    {
+        constraint[player][position] = HINT_UNKNOWN; // Nothing left to say about its neighbours
+        return;
+    }
+
+    int32_t remaining = neighbour_count[position] - flags;
+    if (remaining < 0)
+        remaining = 0; // Wrong flags around, the tile still constrains nothing beyond "safe"
+    if (remaining > hidden)
+        remaining = hidden;
+    constraint[player][position] = (uint8_t)(remaining * 100 / hidden);
+}
+
+void MineHints::_update_probability(uint8_t player, uint8_t position, const uint8_t *revealed,
+                                    const uint8_t *flagged)
+{
+    int32_t x = position / WIDTH;
+    int32_t y = position % WIDTH;
+
+    if (test_bit(revealed, x, y) || test_bit(flagged, x, y))
+    {
+        probability[player][position] = HINT_UNKNOWN;
+        return;
+    }
+
+    uint8_t estimate = HINT_UNKNOWN;
+    for (int32_t i = -1; i <= 1; i++)
+    {
+        for (int32_t j = -1; j <= 1; j++)
+        {
+            int32_t nx = x + i;
+            int32_t ny = y + j;
+            if ((i == 0 && j == 0) || nx < 0 || nx >= HEIGHT || ny < 0 || ny >= WIDTH)
+                continue;
+            uint8_t c = constraint[player][nx * WIDTH + ny];
+            if (c == HINT_UNKNOWN)
+                continue;
+            if (c == 0 || c == 100)
+            {
+                estimate = c; // A certain constraint wins over any estimate
+                break;
+            }
+            if (estimate == HINT_UNKNOWN || c > estimate)
+                estimate = c;
+        }
+        if (estimate == 0 || estimate == 100)
+            break;
+    }
+    probability[player][position] = estimate;
+}
+
+void MineHints::flush(uint8_t player, const uint8_t *revealed, const uint8_t *flagged,
+                      const uint8_t *neighbour_count)
+{
+    uint8_t constraints_dirty[HEIGHT];
+    uint8_t tiles_dirty[HEIGHT];
+    uint8_t any = 0;
+    dilate(changed[player], constraints_dirty); // constraints that can see a changed tile
+    for (int32_t x = 0; x < HEIGHT; x++)
+    {
+        constraints_dirty[x] &= revealed[x]; // Tiles are never hidden again, only revealed ones constrain
+        any |= constraints_dirty[x];
+    }
+    if (any == 0)
+    {
+        // No constraint sees the changes, so each changed tile was and stays
+        // HINT_UNKNOWN: hidden with no revealed neighbour, flagged or not
+        for (int32_t x = 0; x < HEIGHT; x++)
+        {
+            changed[player][x] = 0;
+        }
+        return;
+    }
+    dilate(constraints_dirty, tiles_dirty); // tiles that can see one of those constraints
+    for (int32_t x = 0; x < HEIGHT; x++)
+    {
+        // Only the frontier has a probability: revealed and flagged tiles keep
+        // HINT_UNKNOWN unless they are the ones that changed
+        tiles_dirty[x] &= changed[player][x] | ~(revealed[x] | flagged[x]);
+    }
+
+    for (int32_t x = 0; x < HEIGHT; x++)
+    {
+        for (int32_t y = 0; constraints_dirty[x] >> y; y++)
+        {
+            if (test_bit(constraints_dirty, x, y))
+                _update_constraint(player, x * WIDTH + y, revealed, flagged, neighbour_count);
+        }
+    }
+    for (int32_t x = 0; x < HEIGHT; x++)
+    {
+        for (int32_t y = 0; tiles_dirty[x] >> y; y++)
+        {
+            if (test_bit(tiles_dirty, x, y))
+                _update_probability(player, x * WIDTH + y, revealed, flagged);
+        }
+        changed[player][x] = 0;
+    }
+}
+
+void MineHints::rebuild(uint8_t player, const uint8_t *revealed, const uint8_t *flagged,
+                        const uint8_t *neighbour_count)
+{
+    for (int i = 0; i < WIDTH * HEIGHT; i++)
+    {
+        _update_constraint(player, i, revealed, flagged, neighbour_count);
+    }
+    for (int i = 0; i < WIDTH * HEIGHT; i++)
+    {
+        _update_probability(player, i, revealed, flagged);
+    }
+    for (int x = 0; x < HEIGHT; x++)
+    {
+        changed[player][x] = 0;
+    }
+}
@@ -1,35 +1,161 @@
 #include "minesweeper.h"
 
+#include "hot_path.h"
+#include "trace.h"
+
 Minesweeper::Minesweeper()
 {
+    animate = false; // Host tools and the simulator want every shot complete on return
+    realtime = false;
+    version = 0;
+    changing = 0;
+    reset();
+}
+
+void Minesweeper::generate_mines(uint8_t *mine_rows)
+{
+    for (int i = 0; i < (WIDTH * HEIGHT + 7) / 8; i++)
+    {
+        mine_rows[i] = 0;
+    }
+    int placed = 0;
+    while (placed < NUM_BOMBS)
+    {
+        // for each bomb: 0xxxxyyy, where x is the line and y is the column
+        uint8_t position = esp_random() % (WIDTH * HEIGHT);
+        if (!(mine_rows[get_x_pos(position)] & (1 << get_y_pos(position))))
+        {
+            mine_rows[get_x_pos(position)] |= 1 << get_y_pos(position);
+            placed++;
+        }
+    }
+}
+
+void Minesweeper::reset()
+{
+    uint8_t mine_rows[(WIDTH * HEIGHT + 7) / 8];
+    generate_mines(mine_rows);
+    reset(mine_rows);
+}
+
+void Minesweeper::reset(const uint8_t *mine_rows)
+{
+    ChangeScope change(*this);
     player_turn = 0; // Start with player 0
+    displayed_final = false;
+    hints.reset();
+    invalidate_map();
+    for (int row = 0; row < HEIGHT; row++)
+    {
+        cascade_held[row] = 0; // Rings still to draw belong to the old board
+    }
     for (int i = 0; i < (WIDTH * HEIGHT + 7) / 8; i++)
     {
+        bomb_mask[i] = 0;
         flag_is_revealed[i] = 0;
         marked_as_bomb[0][i] = marked_as_bomb[1][i] = 0; // Initialize marked positions as not bombs
     }
 
+    for (int i = 0; i < WIDTH * HEIGHT; i++)
+    {
+        neighbour_count[i] = 0;
+    }
+
     is_lost = false;
+    first_shot_done = false;
     player_position[0] = player_position[1] = 0; // Start at the top-left corner
-    esp_fill_random(bombs, NUM_BOMBS);
-    for (int i = 0; i < NUM_BOMBS; i++)
+
+    // Counts are patched per mine, so loading a layout costs the same whatever produced it
+    for (int row = 0; row < HEIGHT; row++)
     {
-        bombs[i] &= 0x7F; // Ensure the first bit is 0
-        // for each bomb: 0xxxxyyy, where x is the line and y is the column
+        for (uint8_t bits = mine_rows[row]; bits != 0; bits &= bits - 1)
+        {
+            _place_bomb(row * WIDTH + __builtin_ctz(bits));
+        }
     }
 }
 
-inline uint8_t Minesweeper::get_x_pos(uint8_t position)
+void Minesweeper::_place_bomb(uint8_t position)
 {
-    return position >> 3;
+    int32_t x = get_x_pos(position);
+    int32_t y = get_y_pos(position);
+    bomb_mask[x] |= (1 << y);
+
+    // Only the 3x3 around the bomb sees a different count
+    for (int32_t i = -1; i <= 1; i++)
+    {
+        for (int32_t j = -1; j <= 1; j++)
+        {
+            int32_t nx = x + i;
+            int32_t ny = y + j;
+            if ((i != 0 || j != 0) && nx >= 0 && nx < HEIGHT && ny >= 0 && ny < WIDTH)
+            {
+                neighbour_count[nx * WIDTH + ny]++;
+            }
+        }
+    }
 }
-inline uint8_t Minesweeper::get_y_pos(uint8_t position)
+
+void Minesweeper::_remove_bomb(uint8_t position)
 {
-    return position & 0x07;
+    int32_t x = get_x_pos(position);
+    int32_t y = get_y_pos(position);
+    bomb_mask[x] &= ~(1 << y);
+
+    for (int32_t i = -1; i <= 1; i++)
+    {
+        for (int32_t j = -1; j <= 1; j++)
+        {
+            int32_t nx = x + i;
+            int32_t ny = y + j;
+            if ((i != 0 || j != 0) && nx >= 0 && nx < HEIGHT && ny >= 0 && ny < WIDTH)
+            {
+                neighbour_count[nx * WIDTH + ny]--;
+            }
+        }
+    }
 }
 
-void Minesweeper::move_player(command_t command)
+void Minesweeper::_make_first_shot_safe(uint8_t position)
 {
+    // Move every bomb in the 3x3 around the first shot to a free tile outside of it.
+    // At most 9 bombs move and each one patches two 3x3 regions of the count cache,
+    // so this is bounded and independent of the board size.
+    int32_t x = get_x_pos(position);
+    int32_t y = get_y_pos(position);
+
+    for (int32_t i = -1; i <= 1; i++)
+    {
+        for (int32_t j = -1; j <= 1; j++)
+        {
+            int32_t nx = x + i;
+            int32_t ny = y + j;
+            if (nx < 0 || nx >= HEIGHT || ny < 0 || ny >= WIDTH || !is_bomb(nx * WIDTH + ny))
+                continue;
+
+            // Linear probe from a random tile, skipping bombs and the protected 3x3
+            uint8_t target = esp_random() % (WIDTH * HEIGHT);
+            for (int tries = 0; tries < WIDTH * HEIGHT; tries++)
+            {
+                int32_t dx = get_x_pos(target) - x;
+                int32_t dy = get_y_pos(target) - y;
+                bool protected_tile = dx >= -1 && dx <= 1 && dy >= -1 && dy <= 1;
+                if (!protected_tile && !is_bomb(target))
+                {
+                    _remove_bomb(nx * WIDTH + ny);
+                    _place_bomb(target);
+                    break;
+                }
+                target = (target + 1) % (WIDTH * HEIGHT);
+            }
+        }
+    }
+}
+
+void HOT_PATH Minesweeper::move_player(command_t command)
+{
+    TraceScope span(TRACE_MOVE);
+    ChangeScope change(*this);
     uint8_t x = get_x_pos(player_position[player_turn]);
     uint8_t y = get_y_pos(player_position[player_turn]);
 
@@ -60,22 +186,33 @@ void Minesweeper::move_player(command_t command)
         break;
     }
 
+    _mark_redraw(player_position[player_turn]);
     player_position[player_turn] = 8 * x + y;
+    _mark_redraw(player_position[player_turn]);
 }
 
-bool Minesweeper::is_revealed(uint8_t position)
+void HOT_PATH Minesweeper::jump_player(uint8_t position)
 {
-    int32_t x = get_x_pos(position);
-    int32_t y = get_y_pos(position);
-    return (flag_is_revealed[x] & (1 << y)) != 0;
+    if (position < WIDTH * HEIGHT)
+    {
+        ChangeScope change(*this);
+        _mark_redraw(player_position[player_turn]);
+        player_position[player_turn] = position;
+        _mark_redraw(position);
+    }
 }
 
-void Minesweeper::set_revealed(uint8_t position)
+void HOT_PATH Minesweeper::set_revealed(uint8_t position)
 {
     int32_t x = get_x_pos(position);
     int32_t y = get_y_pos(position);
     flag_is_revealed[x] |= (1 << y);
-    marked_as_bomb[player_turn][x] &= ~(1 << y); // Unmark as bomb when revealed
+    marked_as_bomb[0][x] &= ~(1 << y); // Unmark as bomb when revealed, whoever had flagged it
+    marked_as_bomb[1][x] &= ~(1 << y);
+    redraw[x] |= (1 << y);
+
+    hints.mark_changed(0, position);
+    hints.mark_changed(1, position);
 }
 
 bool Minesweeper::is_marked_as_bomb(uint8_t position)
@@ -84,22 +221,39 @@ bool Minesweeper::is_marked_as_bomb(uint8_t position)
     int32_t y = get_y_pos(position);
     return (marked_as_bomb[player_turn][x] & (1 << y)) != 0;
 }
-void Minesweeper::set_marked_as_bomb(uint8_t position)
+bool Minesweeper::set_marked_as_bomb(uint8_t position)
 {
+    ChangeScope change(*this);
     if (is_revealed(position))
     {
-        return; // Cannot mark a revealed position as a bomb
+        return false; // Cannot mark a revealed position as a bomb
     }
     int32_t x = get_x_pos(position);
     int32_t y = get_y_pos(position);
     marked_as_bomb[player_turn][x] ^= (1 << y); // change state
+    redraw[x] |= (1 << y);
+
+    hints.mark_changed(player_turn, position);
+    _flush_hints();
+    return true;
 }
 
-bool Minesweeper::shoot()
+bool HOT_PATH Minesweeper::shoot()
 {
+    TraceScope span(TRACE_SHOOT);
+    ChangeScope change(*this);
+#if SAFE_FIRST_CLICK
+    if (!first_shot_done)
+    {
+        _make_first_shot_safe(player_position[player_turn]);
+    }
+#endif
+    first_shot_done = true;
+
     if (is_bomb(player_position[player_turn]))
     {
         set_revealed(player_position[player_turn]);
+        _flush_hints();
         is_lost = true;
         return true; // Game over
     }
@@ -107,50 +261,91 @@ bool Minesweeper::shoot()
     {
         set_revealed(player_position[player_turn]);
         _reveal_until_neighbouring_bomb(player_position[player_turn]);
+        _flush_hints();
         return false; // Continue playing
     }
 }
 
-uint8_t Minesweeper::how_many_neighbouring_bombs(uint8_t position)
+bool HOT_PATH Minesweeper::chord(uint8_t position)
 {
-    uint8_t count = 0;
+    TraceScope span(TRACE_CHORD);
+    ChangeScope change(*this);
+    if (!is_revealed(position) || is_lost)
+    {
+        return false;
+    }
+
     int32_t x = get_x_pos(position);
     int32_t y = get_y_pos(position);
+    uint8_t flags = 0;
+    for (int32_t i = -1; i <= 1; i++)
+    {
+        for (int32_t j = -1; j <= 1; j++)
+        {
+            int32_t nx = x + i;
+            int32_t ny = y + j;
+            if ((i != 0 || j != 0) && nx >= 0 && nx < HEIGHT && ny >= 0 && ny < WIDTH &&
+                (marked_as_bomb[player_turn][nx] & (1 << ny)))
+            {
+                flags++;
+            }
+        }
+    }
+    if (flags != neighbour_count[position])
+    {
+        return false;
+    }
 
+    // Same reveal engine as a shot, with a single hint update for all of it
     for (int32_t i = -1; i <= 1; i++)
     {
         for (int32_t j = -1; j <= 1; j++)
         {
-            if (i == 0 && j == 0)
-                continue; // Skip the current position
             int32_t nx = x + i;
             int32_t ny = y + j;
-            if (nx >= 0 && nx < HEIGHT && ny >= 0 && ny < WIDTH)
+            if (nx < 0 || nx >= HEIGHT || ny < 0 || ny >= WIDTH)
+                continue;
+            uint8_t neighbour = nx * WIDTH + ny;
+            if (is_revealed(neighbour) || is_marked_as_bomb(neighbour))
+                continue;
+            if (is_bomb(neighbour))
             {
-                if (is_bomb(nx * WIDTH + ny))
-                {
-                    count++;
-                }
+                set_revealed(neighbour);
+                is_lost = true;
+            }
+            else
+            {
+                _reveal_until_neighbouring_bomb(neighbour);
             }
         }
     }
-    return count;
+    _flush_hints();
+    return true;
 }
 
-void Minesweeper::_reveal_until_neighbouring_bomb(uint8_t position)
+uint8_t Minesweeper::how_many_neighbouring_bombs(uint8_t position)
 {
-    // BFS algorithm to reveal tiles until a neighbouring bomb is found
+    return neighbour_count[position];
+}
 
+void HOT_PATH Minesweeper::_reveal_until_neighbouring_bomb(uint8_t position)
+{
+    // BFS algorithm to reveal tiles until a neighbouring bomb is found. The
+    // whole cascade is revealed here; when it is animated, every tile past the
+    // first is held back from the screen and step_cascade() shows it later.
+    TraceScope span(TRACE_REVEAL);
     uint8_t queue[WIDTH * HEIGHT];
-    int32_t front = 0;
-    int32_t rear = 0;
+    uint8_t front = 0;
+    uint8_t rear = 0;
+    if (!is_revealed(position))
+    {
+        set_revealed(position);
+    }
     queue[rear++] = position;
-    set_revealed(position);
     while (front < rear)
     {
         uint8_t current = queue[front++];
-        uint8_t count = how_many_neighbouring_bombs(current);
-        if (count > 0)
+        if (how_many_neighbouring_bombs(current) > 0)
         {
             continue; // Stop if a neighbouring bomb is found
         }
@@ -167,8 +362,12 @@ void Minesweeper::_reveal_until_neighbouring_bomb(uint8_t position)
                     uint8_t neighbour = nx * WIDTH + ny;
                     if (!is_revealed(neighbour))
                     {
-                        set_revealed(neighbour);
+                        set_revealed(neighbour); // Every tile is queued once, the queue cannot overflow
                         queue[rear++] = neighbour;
+                        if (animate)
+                        {
+                            cascade_held[nx] |= 1 << ny;
+                        }
                     }
                 }
             }
@@ -176,79 +375,248 @@ void Minesweeper::_reveal_until_neighbouring_bomb(uint8_t position)
     }
 }
 
-void Minesweeper::draw_map(TFT_eSPI &tft)
+void Minesweeper::_release_held()
+{
+    for (int row = 0; row < HEIGHT; row++)
+    {
+        redraw[row] |= cascade_held[row];
+        cascade_held[row] = 0;
+    }
+}
+
+bool HOT_PATH Minesweeper::step_cascade()
+{
+    if (!cascade_pending())
+    {
+        return false;
+    }
+    // The next ring: held tiles next to a shown, revealed empty tile. Those are
+    // the tiles the BFS queued from the ring drawn last.
+    uint8_t open[HEIGHT];
+    for (int row = 0; row < HEIGHT; row++)
+    {
+        open[row] = 0;
+        for (uint8_t bits = flag_is_revealed[row] & ~cascade_held[row]; bits != 0; bits &= bits - 1)
+        {
+            if (neighbour_count[row * WIDTH + __builtin_ctz(bits)] == 0)
+                open[row] |= bits & -bits;
+        }
+    }
+    bool released = false;
+    for (int row = 0; row < HEIGHT; row++)
+    {
+        uint8_t near = 0;
+        for (int r = row - 1; r <= row + 1; r++)
+        {
+            if (r >= 0 && r < HEIGHT)
+                near |= open[r] | open[r] << 1 | open[r] >> 1;
+        }
+        uint8_t ring = cascade_held[row] & near;
+        redraw[row] |= ring;
+        cascade_held[row] &= ~ring;
+        released |= ring != 0;
+    }
+    if (!released)
+    {
+        _release_held(); // Not reachable from what is shown, no order to keep
+    }
+    return cascade_pending();
+}
+
+void Minesweeper::animate_cascades(bool enabled)
+{
+    animate = enabled;
+    if (!enabled)
+    {
+        _release_held();
+    }
+}
+
+void Minesweeper::set_realtime(bool enabled)
+{
+    ChangeScope change(*this);
+    realtime = enabled;
+    invalidate_map(); // One cursor or all of them
+}
+
+int Minesweeper::_cursor_at(uint8_t position)
+{
+    if (!realtime)
+    {
+        return position == player_position[player_turn] ? player_turn : -1;
+    }
+    for (int p = 0; p < 2; p++)
+    {
+        if (position == player_position[p])
+        {
+            return p;
+        }
+    }
+    return -1;
+}
+
+bool Minesweeper::_flag_shown(uint8_t position)
+{
+    if (!realtime)
+    {
+        return is_marked_as_bomb(position);
+    }
+    uint8_t bit = 1 << get_y_pos(position);
+    return ((marked_as_bomb[0][get_x_pos(position)] | marked_as_bomb[1][get_x_pos(position)]) & bit) != 0;
+}
+
+uint8_t Minesweeper::_hint_shown(uint8_t position)
+{
+    return hints.get_probability(realtime ? 0 : player_turn, position);
+}
+
+void HOT_PATH Minesweeper::_draw_tile(TFT_eSPI &tft, uint8_t position, bool show_hints)
 {
     const int pixel_size = 13;
-    tft.setTextSize(1);
-    for (int i = 0; i < WIDTH; i++)
+    int i = get_y_pos(position); // column on screen
+    int j = get_x_pos(position); // row on screen
+    shown_hint[position] = show_hints ? _hint_shown(position) : HINT_UNKNOWN;
+    int cursor = _cursor_at(position);
+    if (cursor >= 0)
     {
-        for (int j = 0; j < HEIGHT; j++)
+        // Write 0 at the first position; the second player's cursor is magenta
+        tft.fillRect(i * pixel_size, j * pixel_size, pixel_size, pixel_size, cursor == 0 ? TFT_ORANGE : TFT_MAGENTA);
+        tft.setTextColor(TFT_WHITE);
+        tft.setTextSize(1);
+        if (this->is_revealed(j * 8 + i))
         {
-            if (j * 8 + i == this->get_player_position())
-            {
-                // Write 0 at the first position
-                tft.fillRect(i * pixel_size, j * pixel_size, pixel_size, pixel_size, TFT_ORANGE);
-                tft.setTextColor(TFT_WHITE);
-                tft.setTextSize(1);
-                if (this->is_revealed(j * 8 + i))
-                {
-                    if (this->is_bomb(j * 8 + i))
-                    {
-                        tft.setCursor(i * pixel_size + 2, j * pixel_size + 2);
-                        tft.print("L");
-                    }
-                    else // standard revealed tile
-                    {
-                        // tft.setTextColor(TFT_BLACK);
-                        char text[2];
-                        int num_bombs = this->how_many_neighbouring_bombs(j * 8 + i);
-                        sprintf(text, "%d", num_bombs);
-                        tft.setCursor(i * pixel_size + 2, j * pixel_size + 2);
-                        tft.print(text);
-                    }
-                }
-                else if (this->is_marked_as_bomb(j * 8 + i))
-                {
-                    tft.setCursor(i * pixel_size + 2, j * pixel_size + 2);
-                    tft.setTextColor(TFT_BLACK);
-                    tft.print("B");
-                }
-            }
-            else if (!this->is_revealed(j * 8 + i) && !this->is_marked_as_bomb(j * 8 + i))
-            {
-                tft.drawRect(i * pixel_size, j * pixel_size, pixel_size, pixel_size, TFT_BLACK);
-                tft.fillRect(i * pixel_size + 1, j * pixel_size + 1, pixel_size - 2, pixel_size - 2, TFT_LIGHTGREY);
-            }
-            else if (this->is_revealed(j * 8 + i) && this->is_bomb(j * 8 + i))
+            if (this->is_bomb(j * 8 + i))
             {
-                tft.drawRect(i * pixel_size, j * pixel_size, pixel_size, pixel_size, TFT_BLACK);
-                tft.fillRect(i * pixel_size + 1, j * pixel_size + 1, pixel_size - 2, pixel_size - 2, TFT_RED);
-            }
-            else if (!this->is_revealed(j * 8 + i) && this->is_marked_as_bomb(j * 8 + i))
-            {
-                tft.drawRect(i * pixel_size, j * pixel_size, pixel_size, pixel_size, TFT_BLACK);
-                tft.fillRect(i * pixel_size + 1, j * pixel_size + 1, pixel_size - 2, pixel_size - 2, TFT_YELLOW);
                 tft.setCursor(i * pixel_size + 2, j * pixel_size + 2);
-                tft.setTextColor(TFT_BLACK);
-                tft.print("B");
+                tft.print("L");
             }
-            else
+            else // standard revealed tile
             {
-                // revealed but not a bomb
-                tft.drawRect(i * pixel_size, j * pixel_size, pixel_size, pixel_size, TFT_BLACK);
-                tft.fillRect(i * pixel_size + 1, j * pixel_size + 1, pixel_size - 2, pixel_size - 2, TFT_GREEN);
-                tft.setCursor(i * pixel_size + 2, j * pixel_size + 2);
-
-                char text[2];
+                // tft.setTextColor(TFT_BLACK);
+                char text[4];
                 int num_bombs = this->how_many_neighbouring_bombs(j * 8 + i);
-                if (num_bombs > 0)
-                {
-                    sprintf(text, "%d", num_bombs);
-                    tft.setTextColor(TFT_BLACK);
-                    tft.print(text);
-                }
+                sprintf(text, "%d", num_bombs);
+                tft.setCursor(i * pixel_size + 2, j * pixel_size + 2);
+                tft.print(text);
             }
         }
+        else if (_flag_shown(j * 8 + i))
+        {
+            tft.setCursor(i * pixel_size + 2, j * pixel_size + 2);
+            tft.setTextColor(TFT_BLACK);
+            tft.print("B");
+        }
+    }
+    else if (!this->is_revealed(j * 8 + i) && !_flag_shown(j * 8 + i))
+    {
+        uint16_t color = TFT_LIGHTGREY;
+        uint8_t hint = _hint_shown(j * 8 + i);
+        if (show_hints && hint != HINT_UNKNOWN)
+        {
+            // Heat overlay: green for safe, red for certain mine
+            color = tft.color565(hint * 255 / 100, (100 - hint) * 255 / 100, 0);
+        }
+        tft.drawRect(i * pixel_size, j * pixel_size, pixel_size, pixel_size, TFT_BLACK);
+        tft.fillRect(i * pixel_size + 1, j * pixel_size + 1, pixel_size - 2, pixel_size - 2, color);
+    }
+    else if (this->is_revealed(j * 8 + i) && this->is_bomb(j * 8 + i))
+    {
+        tft.drawRect(i * pixel_size, j * pixel_size, pixel_size, pixel_size, TFT_BLACK);
+        tft.fillRect(i * pixel_size + 1, j * pixel_size + 1, pixel_size - 2, pixel_size - 2, TFT_RED);
+    }
+    else if (!this->is_revealed(j * 8 + i) && _flag_shown(j * 8 + i))
+    {
+        tft.drawRect(i * pixel_size, j * pixel_size, pixel_size, pixel_size, TFT_BLACK);
+        tft.fillRect(i * pixel_size + 1, j * pixel_size + 1, pixel_size - 2, pixel_size - 2, TFT_YELLOW);
+        tft.setCursor(i * pixel_size + 2, j * pixel_size + 2);
+        tft.setTextColor(TFT_BLACK);
+        tft.print("B");
+    }
+    else
+    {
+        // revealed but not a bomb
+        tft.drawRect(i * pixel_size, j * pixel_size, pixel_size, pixel_size, TFT_BLACK);
+        tft.fillRect(i * pixel_size + 1, j * pixel_size + 1, pixel_size - 2, pixel_size - 2, TFT_GREEN);
+        tft.setCursor(i * pixel_size + 2, j * pixel_size + 2);
+
+        char text[4]; // Counts are 1..8, sized for what sprintf may write
+        int num_bombs = this->how_many_neighbouring_bombs(j * 8 + i);
+        if (num_bombs > 0)
+        {
+            sprintf(text, "%d", num_bombs);
+            tft.setTextColor(TFT_BLACK);
+            tft.print(text);
+        }
+    }
+}
+
+void HOT_PATH Minesweeper::draw_map(TFT_eSPI &tft, bool show_hints)
+{
+    TraceScope span(TRACE_DRAW_MAP);
+    _flush_hints_of(realtime ? 0 : player_turn); // The overlay's player may not be the one who acted
+    tft.setTextSize(1);
+    for (int row = 0; row < HEIGHT; row++)
+    {
+        cascade_held[row] = 0; // A full repaint shows the whole board
+    }
+    for (int position = 0; position < WIDTH * HEIGHT; position++)
+    {
+        _draw_tile(tft, position, show_hints);
+    }
+    for (int row = 0; row < HEIGHT; row++)
+    {
+        redraw[row] = 0;
+    }
+}
+
+void HOT_PATH Minesweeper::draw_changes(TFT_eSPI &tft, bool show_hints)
+{
+    TraceScope span(TRACE_DRAW_CHANGES);
+    _flush_hints_of(realtime ? 0 : player_turn); // The overlay's player may not be the one who acted
+    tft.setTextSize(1);
+    for (int position = 0; position < WIDTH * HEIGHT; position++)
+    {
+        if ((cascade_held[get_x_pos(position)] >> get_y_pos(position)) & 1)
+        {
+            continue; // Revealed, shown when its ring comes; step_cascade() marks it then
+        }
+        bool dirty = (redraw[get_x_pos(position)] >> get_y_pos(position)) & 1;
+        // Probabilities can move anywhere on the frontier, so compare against what is on screen
+        uint8_t hint = show_hints ? _hint_shown(position) : HINT_UNKNOWN;
+        if (dirty || hint != shown_hint[position])
+        {
+            _draw_tile(tft, position, show_hints);
+        }
+    }
+    for (int row = 0; row < HEIGHT; row++)
+    {
+        redraw[row] = 0;
+    }
+}
+
+void HOT_PATH Minesweeper::_flush_hints()
+{
+    // One pass over the region touched by the whole operation, not one per
+    // revealed tile, and only for the player who acted. A reveal changes the
+    // other player's view too; that stays marked until their hints are read.
+    _flush_hints_of(player_turn);
+}
+
+void HOT_PATH Minesweeper::_flush_hints_of(int player)
+{
+    if (!hints.pending(player))
+    {
+        return;
+    }
+    TraceScope span(TRACE_HINTS);
+    hints.flush(player, flag_is_revealed, marked_as_bomb[player], neighbour_count);
+}
+
+void Minesweeper::rebuild_hints()
+{
+    for (int p = 0; p < 2; p++)
+    {
+        hints.rebuild(p, flag_is_revealed, marked_as_bomb[p], neighbour_count);
     }
 }
 
@@ -267,7 +635,7 @@ bool Minesweeper::won()
             return false; // Not all non-bomb positions are revealed
         }
 
-        if (is_bomb(i) && !is_marked_as_bomb(i))
+        if (is_bomb(i) && !(realtime ? _flag_shown(i) : is_marked_as_bomb(i)))
         {
             return false; // Not all bomb positions are marked as bombs
         }
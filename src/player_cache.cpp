@@ -0,0 +1,110 @@
+#include "player_cache.h"
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "memory_budget.h"
+
+#ifdef ESP_PLATFORM
+#include <Preferences.h>
+#endif
+
+// playerCacheCommit() copies the whole cache onto loop()'s stack
+static_assert(sizeof(player_cache_entry_t) * PLAYER_CACHE_ENTRIES <= MEMORY_LOOP_FRAME_BUDGET,
+              "PLAYER_CACHE_ENTRIES too large for the commit snapshot on loop()'s stack");
+
+static player_cache_entry_t cache[PLAYER_CACHE_ENTRIES];
+static_assert(sizeof(cache) == PLAYER_CACHE_STATIC_BYTES, "memory_report.cpp counts the cache by PLAYER_CACHE_STATIC_BYTES");
+static uint32_t cacheClock = 0;
+static bool cacheDirty = false;
+portMUX_TYPE playerCacheMux = portMUX_INITIALIZER_UNLOCKED; // Lookups come from the BLE task
+
+// Caller holds playerCacheMux
+static player_cache_entry_t *find_entry(const uint8_t mac_addr[6])
+{
+  for (int i = 0; i < PLAYER_CACHE_ENTRIES; i++)
+  {
+    if (cache[i].last_seen != 0 && memcmp(cache[i].mac, mac_addr, sizeof(cache[i].mac)) == 0)
+      return &cache[i];
+  }
+  return NULL;
+}
+
+void playerCacheBegin()
+{
+#ifdef ESP_PLATFORM
+  Preferences preferences;
+  preferences.begin(PLAYER_CACHE_NAMESPACE, true);
+  // A blob of another size is from an older layout, start over
+  if (preferences.getBytesLength("cache") == sizeof(cache))
+    preferences.getBytes("cache", cache, sizeof(cache));
+  preferences.end();
+#endif
+
+  for (int i = 0; i < PLAYER_CACHE_ENTRIES; i++)
+  {
+    cache[i].name[PLAYER_NAME_LENGTH - 1] = '\0';
+    if (cache[i].last_seen > cacheClock)
+      cacheClock = cache[i].last_seen;
+  }
+}
+
+bool playerCacheLookup(const uint8_t mac_addr[6], char name[PLAYER_NAME_LENGTH])
+{
+  portENTER_CRITICAL(&playerCacheMux);
+  player_cache_entry_t *entry = find_entry(mac_addr);
+  if (entry != NULL)
+  {
+    memcpy(name, entry->name, PLAYER_NAME_LENGTH);
+    entry->last_seen = ++cacheClock; // Recency is only saved with the next real change
+  }
+  portEXIT_CRITICAL(&playerCacheMux);
+  return entry != NULL;
+}
+
+void playerCacheStore(const uint8_t mac_addr[6], const char *name)
+{
+  portENTER_CRITICAL(&playerCacheMux);
+  player_cache_entry_t *entry = find_entry(mac_addr);
+  if (entry == NULL)
+  {
+    // Free entry or, failing that, the least recently seen one
+    entry = &cache[0];
+    for (int i = 1; i < PLAYER_CACHE_ENTRIES; i++)
+    {
+      if (cache[i].last_seen < entry->last_seen)
+        entry = &cache[i];
+    }
+    memcpy(entry->mac, mac_addr, sizeof(entry->mac));
+    entry->name[0] = '\0';
+  }
+  if (strncmp(entry->name, name, PLAYER_NAME_LENGTH) != 0)
+  {
+    strncpy(entry->name, name, PLAYER_NAME_LENGTH - 1);
+    entry->name[PLAYER_NAME_LENGTH - 1] = '\0';
+    cacheDirty = true;
+  }
+  entry->last_seen = ++cacheClock;
+  portEXIT_CRITICAL(&playerCacheMux);
+}
+
+bool playerCacheCommit()
+{
+  player_cache_entry_t snapshot[PLAYER_CACHE_ENTRIES];
+  portENTER_CRITICAL(&playerCacheMux);
+  bool dirty = cacheDirty;
+  cacheDirty = false;
+  memcpy(snapshot, cache, sizeof(snapshot));
+  portEXIT_CRITICAL(&playerCacheMux);
+
+  if (!dirty)
+    return false;
+#ifdef ESP_PLATFORM
+  // A flash write takes milliseconds, never under the lock
+  Preferences preferences;
+  preferences.begin(PLAYER_CACHE_NAMESPACE, false);
+  preferences.putBytes("cache", snapshot, sizeof(snapshot));
+  preferences.end();
+#endif
+  return true;
+}
@@ -0,0 +1,82 @@
+#include "players.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static_assert(MAX_PLAYERS < 100, "Default player names must fit in PLAYER_NAME_LENGTH");
+
+int findDevice(const player_table_t *table, const uint8_t mac_addr[6])
+{
+  for (uint32_t i = 0; i < table->size; i++)
+  {
+    if (memcmp(table->devices[i].remote_bda, mac_addr, sizeof(table->devices[i].remote_bda)) == 0)
+    {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+int findConnection(const player_table_t *table, uint16_t conn_id)
+{
+  for (uint32_t i = 0; i < table->size; i++)
+  {
+    if (table->devices[i].conn_id == conn_id)
+    {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+bool addDevice(player_table_t *table, const uint8_t mac_addr[6], uint16_t conn_id)
+{
+  if (findDevice(table, mac_addr) >= 0)
+  {
+    // Device already exists in the list
+    return false;
+  }
+  if (table->size >= MAX_PLAYERS)
+  {
+    return false;
+  }
+
+  // Add new device to the list
+  device_connected_t *device = &table->devices[table->size];
+  memcpy(device->remote_bda, mac_addr, sizeof(device->remote_bda));
+  // Formatted at full width, then kept to the name field: "Device 99" still fits in it
+  char name[sizeof("Device ") + 10];
+  snprintf(name, sizeof(name), "Device %u", (unsigned)(table->size + 1));
+  size_t name_length = strnlen(name, sizeof(device->name) - 1);
+  memcpy(device->name, name, name_length);
+  device->name[name_length] = '\0';
+  device->conn_id = conn_id;
+  device->credits = 0; // Until flow control hands out the window
+  device->credits_owed = 0;
+  device->away_since = 0;
+  device->out_of_turn = 0;
+  device->dropped = 0;
+  table->size++;
+  return true;
+}
+
+bool removeDevice(player_table_t *table, uint16_t conn_id)
+{
+  int i = findConnection(table, conn_id);
+  if (i < 0)
+  {
+    return false;
+  }
+  removeSeat(table, i);
+  return true;
+}
+
+void removeSeat(player_table_t *table, int seat)
+{
+  // Shift remaining devices down
+  for (uint32_t j = seat; j + 1 < table->size; j++)
+  {
+    memcpy(&table->devices[j], &table->devices[j + 1], sizeof(device_connected_t));
+  }
+  table->size--;
+}
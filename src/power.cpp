@@ -0,0 +1,182 @@
+#include "power.h"
+
+#include <Arduino.h>
+
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "driver/uart.h"
+
+#define POWER_MAX_WAKEUP_PINS 4
+
+static TaskHandle_t loopTaskHandle = NULL;
+#if POWER_MANAGEMENT && defined(CONFIG_PM_ENABLE)
+static esp_pm_lock_handle_t activeLock = NULL; // Full clock while loop() works
+static esp_pm_lock_handle_t awakeLock = NULL;  // No light sleep while the buzzer plays
+#endif
+static bool holdingAwake = false;
+
+static gpio_num_t wakeupPins[POWER_MAX_WAKEUP_PINS];
+static int wakeupPinCount = 0;
+
+static power_stats_t stats;
+static int64_t phaseStart = 0;      // Start of the current active stretch
+static volatile int64_t wakeAt = 0; // First pending wake-up, 0 when none
+
+portMUX_TYPE powerMux = portMUX_INITIALIZER_UNLOCKED;
+
+void powerBegin(const uint8_t *wakeup_pins, int pin_count)
+{
+  loopTaskHandle = xTaskGetCurrentTaskHandle();
+  memset(&stats, 0, sizeof(stats));
+
+#if POWER_MANAGEMENT && defined(CONFIG_PM_ENABLE)
+  esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "loop", &activeLock);
+  esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "buzzer", &awakeLock);
+  esp_pm_lock_acquire(activeLock);
+
+  // Light sleep needs tickless idle in the SDK, fall back to frequency scaling alone
+  esp_pm_config_esp32_t config = {POWER_MAX_FREQ_MHZ, POWER_MIN_FREQ_MHZ, true};
+  esp_err_t err = esp_pm_configure(&config);
+  if (err == ESP_ERR_NOT_SUPPORTED)
+  {
+    config.light_sleep_enable = false;
+    err = esp_pm_configure(&config);
+  }
+  stats.enabled = err == ESP_OK;
+  stats.light_sleep = stats.enabled && config.light_sleep_enable;
+
+  if (stats.light_sleep)
+  {
+    // Buttons are armed as level wake-ups only while idle, see powerIdle()
+    for (int i = 0; i < pin_count && i < POWER_MAX_WAKEUP_PINS; i++)
+    {
+      wakeupPins[wakeupPinCount++] = (gpio_num_t)wakeup_pins[i];
+    }
+    esp_sleep_enable_gpio_wakeup();
+    uart_set_wakeup_threshold(UART_NUM_0, 3); // The first characters of a console line are lost
+    esp_sleep_enable_uart_wakeup(UART_NUM_0);
+  }
+#endif
+
+  phaseStart = esp_timer_get_time();
+}
+
+uint32_t powerIdle(uint32_t timeout_ms)
+{
+  int64_t now = esp_timer_get_time();
+  stats.active_us += now - phaseStart;
+
+  // A level wake-up replaces the edge interrupt of the pin, so it is only armed
+  // while nothing runs. The button ISR is masked meanwhile: a low level would
+  // fire it again on every return for as long as the button is held. A press
+  // made while masked is found from the pin levels after the wait instead.
+  uint32_t released = 0;
+  for (int i = 0; i < wakeupPinCount; i++)
+  {
+    gpio_intr_disable(wakeupPins[i]);
+    if (gpio_get_level(wakeupPins[i]) != 0)
+      released |= 1u << i;
+    gpio_wakeup_enable(wakeupPins[i], GPIO_INTR_LOW_LEVEL);
+  }
+  if (wakeupPinCount > 0 && timeout_ms > POWER_BUTTON_POLL_MS)
+    timeout_ms = POWER_BUTTON_POLL_MS; // Nothing wakes loop() for a masked press
+#if POWER_MANAGEMENT && defined(CONFIG_PM_ENABLE)
+  if (activeLock != NULL)
+    esp_pm_lock_release(activeLock);
+#endif
+
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms));
+
+#if POWER_MANAGEMENT && defined(CONFIG_PM_ENABLE)
+  if (activeLock != NULL)
+    esp_pm_lock_acquire(activeLock);
+#endif
+  uint32_t pressed = 0;
+  for (int i = 0; i < wakeupPinCount; i++)
+  {
+    gpio_wakeup_disable(wakeupPins[i]);
+    gpio_set_intr_type(wakeupPins[i], GPIO_INTR_NEGEDGE); // Back to attachInterrupt(FALLING)
+    if ((released & (1u << i)) && gpio_get_level(wakeupPins[i]) == 0)
+      pressed |= 1u << i;
+    gpio_intr_enable(wakeupPins[i]);
+  }
+  if (pressed != 0 && esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO)
+    stats.button_wakeups++;
+
+  phaseStart = esp_timer_get_time();
+  stats.idle_us += phaseStart - now;
+
+  portENTER_CRITICAL(&powerMux);
+  int64_t woken = wakeAt;
+  wakeAt = 0;
+  portEXIT_CRITICAL(&powerMux);
+
+  if (woken != 0)
+  {
+    uint32_t latency = phaseStart - woken;
+    stats.wakeups++;
+    stats.wake_latency_total_us += latency;
+    if (latency > stats.wake_latency_max_us)
+      stats.wake_latency_max_us = latency;
+    if (latency > POWER_WAKE_BUDGET_US)
+      stats.over_budget++;
+  }
+  return pressed;
+}
+
+void powerHoldAwake(bool hold)
+{
+  if (hold == holdingAwake)
+    return;
+  holdingAwake = hold;
+#if POWER_MANAGEMENT && defined(CONFIG_PM_ENABLE)
+  if (awakeLock == NULL)
+    return;
+  if (hold)
+    esp_pm_lock_acquire(awakeLock);
+  else
+    esp_pm_lock_release(awakeLock);
+#endif
+}
+
+void powerWake()
+{
+  if (loopTaskHandle == NULL)
+    return;
+  portENTER_CRITICAL(&powerMux);
+  if (wakeAt == 0)
+    wakeAt = esp_timer_get_time();
+  portEXIT_CRITICAL(&powerMux);
+  xTaskNotifyGive(loopTaskHandle);
+}
+
+void IRAM_ATTR powerWakeFromISR()
+{
+  if (loopTaskHandle == NULL)
+    return;
+  portENTER_CRITICAL_ISR(&powerMux);
+  if (wakeAt == 0)
+    wakeAt = esp_timer_get_time();
+  portEXIT_CRITICAL_ISR(&powerMux);
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+  vTaskNotifyGiveFromISR(loopTaskHandle, &higherPriorityTaskWoken);
+  portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
+
+void getPowerStats(power_stats_t *stats_out)
+{
+  *stats_out = stats;
+  // Include the stretch loop() is in right now
+  stats_out->active_us += esp_timer_get_time() - phaseStart;
+}
+
+void resetPowerStats()
+{
+  bool enabled = stats.enabled, light_sleep = stats.light_sleep;
+  memset(&stats, 0, sizeof(stats));
+  stats.enabled = enabled;
+  stats.light_sleep = light_sleep;
+  phaseStart = esp_timer_get_time();
+}
@@ -0,0 +1,74 @@
+#include "render_scheduler.h"
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+// Requests come from loop() and from the BLE task (connections redraw the menu)
+static uint32_t dirtyFlags = 0;
+static int64_t lastFrameStart = INT64_MIN / 2; // The first frame is due at once
+static int64_t frameStart = 0;
+static render_stats_t renderStats;
+portMUX_TYPE renderMux = portMUX_INITIALIZER_UNLOCKED;
+
+void renderRequest(uint32_t flags)
+{
+  portENTER_CRITICAL(&renderMux);
+  renderStats.requests++;
+  if (dirtyFlags != 0)
+    renderStats.coalesced++;
+  dirtyFlags |= flags;
+  portEXIT_CRITICAL(&renderMux);
+}
+
+int64_t renderDueIn(int64_t now)
+{
+  portENTER_CRITICAL(&renderMux);
+  uint32_t flags = dirtyFlags;
+  portEXIT_CRITICAL(&renderMux);
+
+  if (flags == 0)
+    return -1;
+  int64_t due = lastFrameStart + RENDER_FRAME_US;
+  return due > now ? due - now : 0;
+}
+
+uint32_t renderBegin(int64_t now)
+{
+  portENTER_CRITICAL(&renderMux);
+  uint32_t flags = dirtyFlags;
+  dirtyFlags = 0;
+  portEXIT_CRITICAL(&renderMux);
+
+  lastFrameStart = now;
+  frameStart = now;
+  return flags;
+}
+
+void renderEnd(int64_t now)
+{
+  uint32_t cost = now - frameStart;
+
+  portENTER_CRITICAL(&renderMux);
+  renderStats.frames++;
+  renderStats.cost_total_us += cost;
+  if (cost > renderStats.cost_max_us)
+    renderStats.cost_max_us = cost;
+  if (cost > RENDER_BUDGET_US)
+    renderStats.over_budget++;
+  portEXIT_CRITICAL(&renderMux);
+}
+
+void getRenderStats(render_stats_t *stats)
+{
+  portENTER_CRITICAL(&renderMux);
+  *stats = renderStats;
+  portEXIT_CRITICAL(&renderMux);
+}
+
+void resetRenderStats()
+{
+  portENTER_CRITICAL(&renderMux);
+  memset(&renderStats, 0, sizeof(renderStats));
+  portEXIT_CRITICAL(&renderMux);
+}
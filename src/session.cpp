@@ -0,0 +1,402 @@
+#include "session.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "board_pool.h"
+#include "clock_service.h"
+#include "hot_path.h"
+#include "player_cache.h"
+
+session_t sessions[MAX_SESSIONS];
+static reconnect_stats_t reconnectStats;
+portMUX_TYPE sessionMux = portMUX_INITIALIZER_UNLOCKED;
+
+static int8_t connectionRoutes[MAX_CONNECTIONS]; // session index per conn_id, -1 = not seated
+static_assert(sizeof(connectionRoutes) == SESSION_ROUTES_STATIC_BYTES,
+              "memory_report.cpp counts the routes by SESSION_ROUTES_STATIC_BYTES");
+static bool routesReady = false;
+
+static inline bool valid_connection(uint16_t conn_id)
+{
+  return conn_id < MAX_CONNECTIONS;
+}
+
+static void init_routes()
+{
+  memset(connectionRoutes, -1, sizeof(connectionRoutes));
+  routesReady = true;
+}
+
+HOT_PATH session_t *sessionOfConnection(uint16_t conn_id)
+{
+  if (!routesReady || !valid_connection(conn_id) || connectionRoutes[conn_id] < 0)
+    return NULL;
+  return &sessions[connectionRoutes[conn_id]];
+}
+
+device_connected_t *deviceOfConnection(uint16_t conn_id)
+{
+  session_t *session = sessionOfConnection(conn_id);
+  if (session == NULL)
+    return NULL;
+  int seat = findConnection(&session->players, conn_id); // at most MAX_PLAYERS entries
+  return seat >= 0 ? &session->players.devices[seat] : NULL;
+}
+
+// Caller holds sessionMux
+static bool has_turn(uint16_t conn_id)
+{
+  session_t *session = sessionOfConnection(conn_id);
+  if (session == NULL)
+    return false;
+  if (session->realtime)
+    return true; // Seated and connected, routes only point at those
+  device_connected_t *current = currentPlayer(session);
+  return current != NULL && current->conn_id == conn_id;
+}
+
+bool HOT_PATH sessionHasTurn(uint16_t conn_id)
+{
+  portENTER_CRITICAL(&sessionMux);
+  bool turn = has_turn(conn_id);
+  portEXIT_CRITICAL(&sessionMux);
+  return turn;
+}
+
+// Hand a held seat back to its device, NULL if it has none. Caller holds sessionMux.
+static session_t *restore_seat(const uint8_t mac_addr[6], uint16_t conn_id)
+{
+  for (int i = 0; i < MAX_SESSIONS; i++)
+  {
+    int seat = findDevice(&sessions[i].players, mac_addr);
+    if (seat < 0 || !playerAway(&sessions[i].players.devices[seat]))
+      continue;
+
+    device_connected_t *device = &sessions[i].players.devices[seat];
+    int64_t outage = clockNow() - device->away_since;
+    reconnectStats.restored++;
+    reconnectStats.outage_total_us += outage;
+    if (outage > reconnectStats.outage_max_us)
+      reconnectStats.outage_max_us = outage;
+
+    device->conn_id = conn_id;
+    device->away_since = 0;
+    connectionRoutes[conn_id] = i;
+    return &sessions[i];
+  }
+  return NULL;
+}
+
+// Caller holds sessionMux
+static session_t *join_seat(const uint8_t mac_addr[6], uint16_t conn_id, bool *restored)
+{
+  if (!valid_connection(conn_id))
+    return NULL;
+  if (connectionRoutes[conn_id] >= 0)
+    return &sessions[connectionRoutes[conn_id]]; // Device already exists in the list
+
+  session_t *held = restore_seat(mac_addr, conn_id);
+  if (held != NULL)
+  {
+    *restored = true;
+    return held;
+  }
+
+  // Prefer a session where someone is already waiting, then an empty one
+  session_t *target = NULL;
+  for (int i = 0; i < MAX_SESSIONS && target == NULL; i++)
+  {
+    if (sessions[i].players.size > 0 && sessions[i].players.size < MAX_PLAYERS)
+      target = &sessions[i];
+  }
+  for (int i = 0; i < MAX_SESSIONS && target == NULL; i++)
+  {
+    if (sessions[i].players.size == 0)
+      target = &sessions[i];
+  }
+  if (target == NULL || !addDevice(&target->players, mac_addr, conn_id))
+    return NULL;
+
+  device_connected_t *device = &target->players.devices[target->players.size - 1];
+  if (playerCacheLookup(mac_addr, device->name))
+    reconnectStats.named++;
+
+  connectionRoutes[conn_id] = sessionIndex(target);
+  return target;
+}
+
+session_t *joinSession(const uint8_t mac_addr[6], uint16_t conn_id, bool *restored)
+{
+  bool held = false;
+  portENTER_CRITICAL(&sessionMux);
+  if (!routesReady)
+    init_routes();
+  session_t *session = join_seat(mac_addr, conn_id, &held);
+  portEXIT_CRITICAL(&sessionMux);
+
+  if (restored != NULL)
+    *restored = held;
+  return session;
+}
+
+session_t *leaveSession(uint16_t conn_id)
+{
+  int64_t now = clockNow();
+  portENTER_CRITICAL(&sessionMux);
+  session_t *session = sessionOfConnection(conn_id);
+  if (session != NULL)
+  {
+    // Keep the seat, turn and cursor; the game waits if it is this player's turn
+    device_connected_t *device = deviceOfConnection(conn_id);
+    device->conn_id = PLAYER_AWAY;
+    device->away_since = now;
+    device->credits = 0;
+    device->credits_owed = 0;
+    connectionRoutes[conn_id] = -1;
+    reconnectStats.held++;
+  }
+  portEXIT_CRITICAL(&sessionMux);
+  return session;
+}
+
+uint32_t expireAwaySeats(int64_t now_us)
+{
+  uint32_t expired = 0;
+  // Shifting a table moves devices under the feet of the transport tasks
+  portENTER_CRITICAL(&sessionMux);
+  for (int i = 0; i < MAX_SESSIONS; i++)
+  {
+    player_table_t *players = &sessions[i].players;
+    for (int seat = players->size - 1; seat >= 0; seat--)
+    {
+      device_connected_t *device = &players->devices[seat];
+      if (!playerAway(device) || now_us - device->away_since < SESSION_GRACE_US)
+        continue;
+
+      removeSeat(players, seat);
+      sessions[i].player_turn = 0; // Reset player turn
+      sessions[i].game.set_player_turn(0);
+      reconnectStats.expired++;
+      expired |= 1u << i;
+    }
+  }
+  portEXIT_CRITICAL(&sessionMux);
+  return expired;
+}
+
+void sessionReconnectPlayable(uint32_t elapsed_us)
+{
+  reconnectStats.playable_total_us += elapsed_us;
+  if (elapsed_us > reconnectStats.playable_max_us)
+    reconnectStats.playable_max_us = elapsed_us;
+}
+
+void getReconnectStats(reconnect_stats_t *stats)
+{
+  *stats = reconnectStats;
+}
+
+void resetSession(session_t *session)
+{
+  board_layout_t layout;
+  if (boardPoolTake(&layout))
+    session->game.reset(layout.mines); // Constant time, whatever the generator costs
+  else
+    session->game.reset();
+  session->player_turn = 0;
+  session->finished_at = 0;
+}
+
+void setSessionRealtime(session_t *session, bool realtime)
+{
+  session->realtime = realtime;
+  session->game.set_realtime(realtime);
+  session->game.set_player_turn(session->player_turn);
+}
+
+// Every seated player learns the mode, not only the one who switched it
+static void notify_mode(session_t *session, flow_notify_t notify)
+{
+  const uint8_t reply[2] = {'M', (uint8_t)(session->realtime ? '1' : '0')};
+  for (uint32_t i = 0; i < session->players.size; i++)
+  {
+    if (!playerAway(&session->players.devices[i]))
+      notify(session->players.devices[i].conn_id, reply, sizeof(reply));
+  }
+}
+
+// Next player on turn; in real time nobody waits for anyone
+static void pass_turn(session_t *session)
+{
+  if (session->realtime)
+    return;
+  session->player_turn = (session->player_turn + 1) % session->players.size; // Switch to the next player
+  session->game.set_player_turn(session->player_turn);
+}
+
+static void change_player_name(session_t *session, const message_t *message)
+{
+  int seat = findConnection(&session->players, message->conn_id);
+  if (seat < 0)
+    return;
+
+  device_connected_t *device = &session->players.devices[seat];
+  size_t name_length = message->length - 1; // Exclude the command character
+  if (name_length > sizeof(device->name) - 1)
+  {
+    name_length = sizeof(device->name) - 1; // Limit to 9 characters
+  }
+  memcpy(device->name, &message->data[1], name_length);
+  device->name[name_length] = '\0'; // Null-terminate the string
+  playerCacheStore(device->remote_bda, device->name); // Comes back with the device next time
+}
+
+uint32_t sessionRename(session_t *session, const message_t *message)
+{
+  if (message->length > 0 && message->data[0] == 'N')
+  {
+    change_player_name(session, message);
+    return EFFECT_RENAMED;
+  }
+  return EFFECT_NONE;
+}
+
+// "<row>,<col>" after the command letter; false if missing or off the board
+static bool parse_cell(const message_t *message, uint8_t *position)
+{
+  uint32_t value[2] = {0, 0};
+  int field = 0;
+  bool digits = false;
+  for (int i = 1; i < message->length; i++)
+  {
+    uint8_t c = message->data[i];
+    if (c >= '0' && c <= '9')
+    {
+      value[field] = value[field] * 10 + (c - '0');
+      digits = true;
+      if (value[field] > 255)
+        return false;
+    }
+    else if (c == ',' && field == 0 && digits)
+    {
+      field = 1;
+      digits = false;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  if (field != 1 || !digits || value[0] >= HEIGHT || value[1] >= WIDTH)
+    return false;
+  *position = value[0] * WIDTH + value[1];
+  return true;
+}
+
+uint32_t HOT_PATH sessionDispatch(session_t *session, const message_t *message, flow_notify_t notify)
+{
+  Minesweeper &game = session->game;
+  if (session->realtime)
+  {
+    // The sender acts with its own cursor and flags, at most MAX_PLAYERS seats to look at
+    int seat = findConnection(&session->players, message->conn_id);
+    if (seat < 0)
+      return EFFECT_IGNORED;
+    session->player_turn = seat;
+    game.set_player_turn(seat);
+  }
+  else
+  {
+    device_connected_t *current = currentPlayer(session);
+    if (current == NULL || current->conn_id != message->conn_id)
+    {
+      // If the message is not from the current player, ignore it
+      return EFFECT_IGNORED;
+    }
+  }
+
+  switch (message->data[0])
+  {
+  case 'L':
+    game.move_player(CMD_LEFT);
+    return EFFECT_MOVED;
+  case 'R':
+    game.move_player(CMD_RIGHT);
+    return EFFECT_MOVED;
+  case 'U':
+    game.move_player(CMD_UP);
+    return EFFECT_MOVED;
+  case 'D':
+    game.move_player(CMD_DOWN);
+    return EFFECT_MOVED;
+  case 'S':
+    game.move_player(CMD_SHOOT);
+    pass_turn(session);
+    return EFFECT_SHOT;
+  case 'J':
+  {
+    uint8_t position;
+    if (!parse_cell(message, &position))
+      return EFFECT_NONE;
+    game.jump_player(position);
+    return EFFECT_MOVED;
+  }
+  case 'F':
+  {
+    uint8_t position = game.get_player_position();
+    if (message->length > 1 && !parse_cell(message, &position))
+      return EFFECT_NONE;
+    if (!game.set_marked_as_bomb(position))
+      return EFFECT_NONE; // Revealed, nothing to flag
+    return EFFECT_FLAGGED;
+  }
+  case 'C':
+  {
+    uint8_t position = game.get_player_position();
+    if (message->length > 1 && !parse_cell(message, &position))
+      return EFFECT_NONE;
+    if (!game.chord(position))
+      return EFFECT_NONE; // Number not satisfied, nothing changed and the turn stays
+    pass_turn(session);
+    return EFFECT_SHOT;
+  }
+  case 'N':
+    // Change name for MAC address
+    change_player_name(session, message);
+    return EFFECT_RENAMED;
+  case 'H':
+  {
+    // Toggle the probability overlay and send back the hint under the cursor
+    session->show_hints = !session->show_hints;
+    uint8_t hint = game.get_hint(game.get_player_position());
+    char reply[8];
+    if (hint == HINT_UNKNOWN)
+      snprintf(reply, sizeof(reply), "H?");
+    else
+      snprintf(reply, sizeof(reply), "H%d", hint);
+    notify(message->conn_id, (const uint8_t *)reply, strlen(reply));
+    return EFFECT_HINTS;
+  }
+  case 'M':
+    setSessionRealtime(session, !session->realtime);
+    notify_mode(session, notify);
+    return EFFECT_MODE;
+  default:
+    return EFFECT_NONE;
+  }
+}
+
+void reapFinishedSessions(const session_t *on_screen, int64_t now_us)
+{
+  for (int i = 0; i < MAX_SESSIONS; i++)
+  {
+    session_t *session = &sessions[i];
+    if (session == on_screen || !(session->game.is_game_over() || session->game.won()))
+      continue;
+    if (session->finished_at == 0)
+      session->finished_at = now_us;
+    else if (now_us - session->finished_at >= SESSION_FINISHED_HOLD_US)
+      resetSession(session);
+  }
+}
@@ -0,0 +1,178 @@
+#include "stall_monitor.h"
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "clock_service.h"
+
+typedef struct
+{
+  const char *task;
+  const char *section;         // NULL while waiting on purpose
+  int64_t section_started;
+  uint32_t busy_us;            // Busy time of this iteration, up to section_started
+  const char *longest_section; // Longest section so far in this iteration
+  uint32_t longest_section_us;
+  const char *caught_in;       // Section the watchdog found stalled, NULL if none
+  stall_task_stats_t stats;
+} stall_task_t;
+
+static stall_task_t tasks[STALL_MAX_TASKS];
+static int taskCount = 0;
+static stall_record_t records[STALL_RECORDS];
+static_assert(sizeof(records) == STALL_STATIC_BYTES, "memory_report.cpp counts the records by STALL_STATIC_BYTES");
+static int recordCount = 0;
+portMUX_TYPE stallMux = portMUX_INITIALIZER_UNLOCKED; // The watchdog runs in the timer task
+
+// Caller holds stallMux
+static void close_section(stall_task_t *t, int64_t now)
+{
+  if (t->section == NULL)
+    return;
+  uint32_t spent = now - t->section_started;
+  t->busy_us += spent;
+  if (spent > t->longest_section_us)
+  {
+    t->longest_section_us = spent;
+    t->longest_section = t->section;
+  }
+}
+
+// Caller holds stallMux
+static void keep_record(const char *task, const char *section, uint32_t gap, int64_t now)
+{
+  int slot = recordCount;
+  if (recordCount == STALL_RECORDS)
+  {
+    // Replace the shortest gap, if this one is longer
+    slot = 0;
+    for (int i = 1; i < STALL_RECORDS; i++)
+    {
+      if (records[i].gap_us < records[slot].gap_us)
+        slot = i;
+    }
+    if (records[slot].gap_us >= gap)
+      return;
+  }
+  else
+  {
+    recordCount++;
+  }
+  records[slot] = {task, section, gap, now};
+}
+
+int stallRegister(const char *task)
+{
+  int slot = -1;
+  portENTER_CRITICAL(&stallMux);
+  if (taskCount < STALL_MAX_TASKS)
+  {
+    slot = taskCount++;
+    memset(&tasks[slot], 0, sizeof(tasks[slot]));
+    tasks[slot].task = task;
+  }
+  portEXIT_CRITICAL(&stallMux);
+  return slot;
+}
+
+void stallHeartbeat(int slot)
+{
+  if (slot < 0)
+    return;
+  int64_t now = clockNow();
+
+  portENTER_CRITICAL(&stallMux);
+  stall_task_t *t = &tasks[slot];
+  close_section(t, now);
+  uint32_t gap = t->busy_us;
+  t->stats.iterations++;
+  if (gap > t->stats.longest_gap_us)
+    t->stats.longest_gap_us = gap;
+  if (gap > STALL_THRESHOLD_US)
+    t->stats.stalls++;
+  if (t->stats.iterations > 1) // The first one includes start-up
+    keep_record(t->task, t->caught_in != NULL ? t->caught_in : t->longest_section, gap, now);
+
+  t->busy_us = 0;
+  t->longest_section = t->section;
+  t->longest_section_us = 0;
+  t->caught_in = NULL;
+  t->section_started = now;
+  portEXIT_CRITICAL(&stallMux);
+}
+
+void stallSection(int slot, const char *section)
+{
+  if (slot < 0)
+    return;
+  int64_t now = clockNow();
+
+  portENTER_CRITICAL(&stallMux);
+  stall_task_t *t = &tasks[slot];
+  close_section(t, now);
+  t->section = section;
+  t->section_started = now;
+  portEXIT_CRITICAL(&stallMux);
+}
+
+void stallCheck()
+{
+  int64_t now = clockNow();
+
+  portENTER_CRITICAL(&stallMux);
+  for (int i = 0; i < taskCount; i++)
+  {
+    stall_task_t *t = &tasks[i];
+    if (t->section == NULL || t->caught_in != NULL)
+      continue;
+    if (t->busy_us + (now - t->section_started) >= STALL_THRESHOLD_US)
+      t->caught_in = t->section; // Still in there, this is the one blocking
+  }
+  portEXIT_CRITICAL(&stallMux);
+}
+
+int getStallRecords(stall_record_t *out, int max_records)
+{
+  portENTER_CRITICAL(&stallMux);
+  int count = recordCount < max_records ? recordCount : max_records;
+  stall_record_t sorted[STALL_RECORDS];
+  memcpy(sorted, records, sizeof(stall_record_t) * recordCount);
+  int total = recordCount;
+  portEXIT_CRITICAL(&stallMux);
+
+  // Selection of the longest first, the table is tiny
+  for (int i = 0; i < count; i++)
+  {
+    int longest = i;
+    for (int j = i + 1; j < total; j++)
+    {
+      if (sorted[j].gap_us > sorted[longest].gap_us)
+        longest = j;
+    }
+    stall_record_t swap = sorted[i];
+    sorted[i] = sorted[longest];
+    sorted[longest] = swap;
+    out[i] = sorted[i];
+  }
+  return count;
+}
+
+bool getStallTaskStats(int slot, const char **task, stall_task_stats_t *stats)
+{
+  if (slot < 0 || slot >= taskCount)
+    return false;
+  portENTER_CRITICAL(&stallMux);
+  *task = tasks[slot].task;
+  *stats = tasks[slot].stats;
+  portEXIT_CRITICAL(&stallMux);
+  return true;
+}
+
+void resetStallRecords()
+{
+  portENTER_CRITICAL(&stallMux);
+  recordCount = 0;
+  for (int i = 0; i < taskCount; i++)
+    memset(&tasks[i].stats, 0, sizeof(tasks[i].stats));
+  portEXIT_CRITICAL(&stallMux);
+}
@@ -0,0 +1,262 @@
+#include "trace.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "hot_path.h"
+
+#ifndef ESP_PLATFORM
+#include <atomic>
+#endif
+
+static const char *const traceNames[TRACE_NAMES] = {
+    "ble_connect", "ble_disconnect", "ble_write",
+    "queue_add", "queue_peek", "queue_release",
+    "dispatch", "move_player", "shoot", "chord", "reveal", "hints",
+    "render", "draw_map", "draw_changes", "audio",
+};
+
+static trace_record_t records[TRACE_RECORDS];
+static_assert(sizeof(records) == TRACE_STATIC_BYTES, "memory_report.cpp counts the ring by TRACE_STATIC_BYTES");
+static uint32_t recordNext = 0; // Total events recorded, the ring index is this modulo TRACE_RECORDS
+static uint32_t recordOverwritten = 0;
+portMUX_TYPE traceMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Dump in progress: the ring is read from a copy of its bounds, so a reset
+// meanwhile cannot move it, and tracing stays paused until the end
+static struct
+{
+  bool active;
+  bool resume; // traceOn when the dump ends
+  bool begun;  // "trace begin" is out
+  uint32_t first;
+  uint32_t count;
+  uint32_t overwritten;
+  uint32_t next;
+  uint64_t at;
+  uint32_t previous;
+} dump;
+
+#ifdef ESP_PLATFORM
+static volatile bool traceOn = true; // From boot, so the moves before a "trace dump" are in there
+
+static inline uint8_t trace_tid()
+{
+  return xPortGetCoreID();
+}
+#else
+static volatile bool traceOn = false; // The simulator shoots too often to trace by default
+static std::atomic<uint8_t> hostThreads(0);
+
+static inline uint8_t trace_tid()
+{
+  static thread_local uint8_t tid = hostThreads++;
+  return tid;
+}
+#endif
+
+void traceEnable(bool enabled)
+{
+  if (dump.active)
+    dump.resume = enabled;
+  else
+    traceOn = enabled;
+}
+
+bool traceEnabled()
+{
+  return traceOn;
+}
+
+static inline void HOT_PATH record(trace_name_t name, uint8_t phase)
+{
+  if (!traceOn)
+    return;
+  uint32_t now = (uint32_t)esp_timer_get_time();
+  uint8_t tid = trace_tid();
+
+  portENTER_CRITICAL(&traceMux);
+  if (recordNext >= TRACE_RECORDS)
+    recordOverwritten++;
+  records[recordNext % TRACE_RECORDS] = {now, (uint8_t)name, phase, tid, 0};
+  recordNext++;
+  portEXIT_CRITICAL(&traceMux);
+}
+
+void HOT_PATH traceBegin(trace_name_t name)
+{
+  record(name, 'B');
+}
+
+void HOT_PATH traceEnd(trace_name_t name)
+{
+  record(name, 'E');
+}
+
+const char *traceName(trace_name_t name)
+{
+  return name < TRACE_NAMES ? traceNames[name] : "?";
+}
+
+// Oldest first, with the 32-bit timestamps unwrapped to microseconds since the
+// oldest event. Tracing must be paused.
+template <typename Visit>
+static uint32_t for_each_record(Visit visit)
+{
+  uint32_t count = recordNext < TRACE_RECORDS ? recordNext : TRACE_RECORDS;
+  uint32_t first = recordNext - count;
+  uint64_t at = 0;
+  uint32_t previous = count > 0 ? records[first % TRACE_RECORDS].at_us : 0;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    const trace_record_t *r = &records[(first + i) % TRACE_RECORDS];
+    at += (uint32_t)(r->at_us - previous); // Wraps every 71 minutes, the difference does not
+    previous = r->at_us;
+    visit(r, at);
+  }
+  return count;
+}
+
+void traceDumpBegin()
+{
+  if (dump.active)
+    return; // Already running, it goes on from where it is
+  dump.resume = traceOn;
+  traceOn = false;
+  // A writer that saw traceOn before the store may still be inside the ring
+  portENTER_CRITICAL(&traceMux);
+  portEXIT_CRITICAL(&traceMux);
+
+  dump.count = recordNext < TRACE_RECORDS ? recordNext : TRACE_RECORDS;
+  dump.first = recordNext - dump.count;
+  dump.overwritten = recordOverwritten;
+  dump.next = 0;
+  dump.at = 0;
+  dump.previous = dump.count > 0 ? records[dump.first % TRACE_RECORDS].at_us : 0;
+  dump.begun = false;
+  dump.active = true;
+}
+
+bool traceDumpStep(trace_line_t emit, int max_lines)
+{
+  if (!dump.active)
+    return false;
+
+  char line[TRACE_DUMP_LINE_MAX - 1];
+  int lines = 0;
+  if (!dump.begun && lines < max_lines)
+  {
+    snprintf(line, sizeof(line), "trace begin %u %u", (unsigned)dump.count, (unsigned)dump.overwritten);
+    emit(line);
+    dump.begun = true;
+    lines++;
+  }
+  // Same unwrapping as for_each_record(), resumed where the last step stopped
+  while (dump.begun && dump.next < dump.count && lines < max_lines)
+  {
+    const trace_record_t *r = &records[(dump.first + dump.next) % TRACE_RECORDS];
+    dump.at += (uint32_t)(r->at_us - dump.previous);
+    dump.previous = r->at_us;
+    snprintf(line, sizeof(line), "%llu %c %u %s", (unsigned long long)dump.at, r->phase, r->tid,
+             traceName((trace_name_t)r->name));
+    emit(line);
+    dump.next++;
+    lines++;
+  }
+  if (dump.begun && dump.next == dump.count && lines < max_lines)
+  {
+    emit("trace end");
+    dump.active = false;
+    traceOn = dump.resume;
+  }
+  return dump.active;
+}
+
+bool traceDumping()
+{
+  return dump.active;
+}
+
+void getTraceStats(trace_stats_t *stats)
+{
+  portENTER_CRITICAL(&traceMux);
+  stats->recorded = recordNext;
+  stats->overwritten = recordOverwritten;
+  portEXIT_CRITICAL(&traceMux);
+}
+
+void resetTrace()
+{
+  portENTER_CRITICAL(&traceMux);
+  recordNext = 0;
+  recordOverwritten = 0;
+  portEXIT_CRITICAL(&traceMux);
+}
+
+#ifndef ESP_PLATFORM
+#define TRACE_MAX_THREADS 16
+#define TRACE_MAX_DEPTH 16
+
+// Same output as scripts/trace_to_chrome.py: begin/end pairs become complete
+// ("X") events; an end whose begin was overwritten is dropped, and so is a
+// begin that never ended.
+bool traceWriteChrome(const char *path)
+{
+  FILE *out = fopen(path, "w");
+  if (out == NULL)
+    return false;
+
+  bool was_on = traceOn;
+  traceOn = false;
+  portENTER_CRITICAL(&traceMux);
+  portEXIT_CRITICAL(&traceMux);
+
+  struct
+  {
+    uint8_t name;
+    uint64_t at;
+  } open_spans[TRACE_MAX_THREADS][TRACE_MAX_DEPTH];
+  int depth[TRACE_MAX_THREADS] = {};
+  bool seen[TRACE_MAX_THREADS] = {};
+  bool first = true;
+
+  fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+  for_each_record([&](const trace_record_t *r, uint64_t at) {
+    int tid = r->tid % TRACE_MAX_THREADS;
+    seen[tid] = true;
+    if (r->phase == 'B')
+    {
+      if (depth[tid] < TRACE_MAX_DEPTH)
+        open_spans[tid][depth[tid]] = {r->name, at};
+      depth[tid]++;
+      return;
+    }
+    // Unwind to the matching begin, if it is still in the ring
+    int level = depth[tid] < TRACE_MAX_DEPTH ? depth[tid] : TRACE_MAX_DEPTH;
+    while (level > 0 && open_spans[tid][level - 1].name != r->name)
+      level--;
+    if (level == 0)
+      return;
+    depth[tid] = level - 1;
+    uint64_t start = open_spans[tid][level - 1].at;
+    fprintf(out, "%s\n  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %llu, \"dur\": %llu}",
+            first ? "" : ",", traceName((trace_name_t)r->name), r->tid, (unsigned long long)start,
+            (unsigned long long)(at - start));
+    first = false;
+  });
+  for (int tid = 0; tid < TRACE_MAX_THREADS; tid++)
+  {
+    if (!seen[tid])
+      continue;
+    fprintf(out, "%s\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"thread %d\"}}",
+            first ? "" : ",", tid, tid);
+    first = false;
+  }
+  fprintf(out, "\n]}\n");
+
+  traceOn = was_on;
+  return fclose(out) == 0;
+}
+#endif
@@ -0,0 +1,66 @@
+#include "transport.h"
+
+typedef struct
+{
+  const transport_t *transport;
+  uint16_t first_conn_id;
+  uint16_t count;
+} transport_range_t;
+
+// Filled once at start-up, read-only afterwards
+static transport_range_t transports[MAX_TRANSPORTS];
+static int transportCount = 0;
+
+bool transportRegister(const transport_t *transport, uint16_t first_conn_id, uint16_t count)
+{
+  if (transportCount == MAX_TRANSPORTS)
+  {
+    return false;
+  }
+  for (int i = 0; i < transportCount; i++)
+  {
+    // Connection id ranges must not overlap
+    if (first_conn_id < transports[i].first_conn_id + transports[i].count &&
+        transports[i].first_conn_id < first_conn_id + count)
+      return false;
+  }
+  transports[transportCount++] = {transport, first_conn_id, count};
+  return true;
+}
+
+bool transportBeginAll(const char *address, const transport_events_t *events)
+{
+  bool ok = true;
+  for (int i = 0; i < transportCount; i++)
+  {
+    if (transports[i].transport->begin != NULL)
+      ok = transports[i].transport->begin(address, events) && ok;
+  }
+  return ok;
+}
+
+void transportEndAll()
+{
+  for (int i = 0; i < transportCount; i++)
+  {
+    if (transports[i].transport->end != NULL)
+      transports[i].transport->end();
+  }
+}
+
+const transport_t *transportOfConnection(uint16_t conn_id)
+{
+  for (int i = 0; i < transportCount; i++)
+  {
+    if (conn_id >= transports[i].first_conn_id && conn_id - transports[i].first_conn_id < transports[i].count)
+      return transports[i].transport;
+  }
+  return NULL;
+}
+
+void transportNotify(uint16_t conn_id, const uint8_t *data, size_t length)
+{
+  const transport_t *transport = transportOfConnection(conn_id);
+  if (transport != NULL)
+    transport->notify(conn_id, data, length);
+}
@@ -0,0 +1,138 @@
+#include "ui_widgets.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+static ui_screen_t *currentScreen = NULL;
+static bool screenValid = false; // The background of currentScreen is on the display
+static ui_stats_t uiStats;
+
+void uiLabelInit(ui_label_t *label, int16_t x, int16_t y, uint8_t size, uint16_t fg, uint16_t bg)
+{
+  memset(label, 0, sizeof(*label));
+  label->x = x;
+  label->y = y;
+  label->size = size;
+  label->fg = fg;
+  label->bg = bg;
+}
+
+void uiLabelPrintf(ui_label_t *label, const char *format, ...)
+{
+  char text[UI_LABEL_TEXT];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+
+  if (strcmp(text, label->text) == 0)
+    return;
+  memcpy(label->text, text, sizeof(text));
+  label->valid = false;
+}
+
+void uiLabelSetColor(ui_label_t *label, uint16_t fg)
+{
+  if (fg == label->fg)
+    return;
+  label->fg = fg;
+  label->valid = false;
+}
+
+void uiScreenShow(ui_screen_t *screen)
+{
+  if (screen == currentScreen)
+    return;
+  currentScreen = screen;
+  screenValid = false;
+}
+
+void uiScreenInvalidate()
+{
+  screenValid = false;
+}
+
+ui_screen_t *uiCurrentScreen()
+{
+  return currentScreen;
+}
+
+static void draw_label(TFT_eSPI &tft, ui_label_t *label)
+{
+  int16_t height = UI_GLYPH_HEIGHT * label->size;
+  int16_t cell = UI_GLYPH_WIDTH * label->size;
+  int16_t width = strlen(label->text) * cell;
+
+  // Glyphs are drawn with their background, so only a shorter text needs its old tail erased
+  if (width < label->drawn_width)
+  {
+    tft.fillRect(label->x + width, label->y, label->drawn_width - width, height, label->bg);
+    uiStats.pixels += (label->drawn_width - width) * height;
+  }
+
+  // Only the cells from the first difference on change, unless the colour did
+  size_t same = 0;
+  if (label->drawn_fg == label->fg)
+  {
+    while (label->text[same] != '\0' && label->text[same] == label->drawn[same])
+      same++;
+  }
+  if (label->text[same] != '\0')
+  {
+    tft.setTextSize(label->size);
+    tft.setTextColor(label->fg, label->bg);
+    tft.setCursor(label->x + same * cell, label->y);
+    tft.print(label->text + same);
+    uiStats.pixels += (width - same * cell) * height;
+  }
+
+  memcpy(label->drawn, label->text, sizeof(label->drawn));
+  label->drawn_fg = label->fg;
+  label->drawn_width = width;
+  label->valid = true;
+  uiStats.labels_drawn++;
+}
+
+bool uiRender(TFT_eSPI &tft)
+{
+  if (currentScreen == NULL)
+    return false;
+
+  bool cleared = !screenValid;
+  if (cleared)
+  {
+    tft.fillScreen(currentScreen->bg);
+    uiStats.screens++;
+    uiStats.pixels += (uint32_t)tft.width() * tft.height();
+    for (int i = 0; i < currentScreen->count; i++)
+    {
+      // Nothing of the labels is left on screen
+      ui_label_t *label = currentScreen->labels[i];
+      label->drawn[0] = '\0';
+      label->drawn_width = 0;
+      label->valid = false;
+    }
+    screenValid = true;
+  }
+
+  for (int i = 0; i < currentScreen->count; i++)
+  {
+    ui_label_t *label = currentScreen->labels[i];
+    if (label->valid)
+      uiStats.labels_skipped++;
+    else
+      draw_label(tft, label);
+  }
+  return cleared;
+}
+
+void getUiStats(ui_stats_t *stats)
+{
+  *stats = uiStats;
+}
+
+void resetUiStats()
+{
+  memset(&uiStats, 0, sizeof(uiStats));
+}